@@ -1,128 +1,844 @@
-//*********************
-// File : BSTree.cpp
-// Author : Alec Prassinos
-// user name : alecp1
-// Date : Monday Nov 1 04
-//
-// Vote Kerry
-//
-// Wrapper class for a BinarySearchTree<class Comparable>
-// Defined in BinarySearchTree.h
-// Simply Abstracts code from the orignal tree.
-//
-//*********************
-
-#include "BinarySearchTree.h"
-#include "Proj3Aux.h"
-#include "dsexceptions.h"
-#include <iostream>
-#include <string>
-#include <vector>
-
-using namespace std;
-
-// default constructor
-BSTree::BSTree()
-   :m_name(" "), m_tree(BinarySearchTree<int> (-1)){}
-
-// Named Tree constructor
-BSTree::BSTree(int sentinel, string name)
-   : m_name(name), m_tree(BinarySearchTree<int> (sentinel))
-{
-   //no code
-}
-
-// Copies tree into a tree of a different name
-BSTree::BSTree(const BSTree& tree, string name)
-   : m_name(name), m_tree(tree.m_tree)
-{
-   //no code
-}
-
-// Copies tree with same name
-BSTree::BSTree(const BSTree& rhs)
-   : m_name(rhs.m_name), m_tree(rhs.m_tree)
-{
-   // no code
-}
-
-
-// default destructor
-BSTree::~BSTree()
-{
-
-}
-
-// useless accessors
-string BSTree::GetName() const
-{
-   return m_name;
-}
-
-// useless accessors
-BinarySearchTree<int> BSTree::GetTree()
-{
-   return m_tree;
-}
-
-// inserts x into the tree
-void BSTree::insert(int x)
-{
-   m_tree.insert(x);
-}
-
- // removes x from the tree
-void BSTree::remove(int x)
-{
-   m_tree.remove(x);
-}
-
-// Copies elements of tree into m_tree
-void BSTree::Union( const BSTree& tree)
-{
-   m_tree.Union(tree.m_tree);
-}
-
-// Copies matching elements in tree1 and tree2 into m_tree
-void BSTree::Intersection( const BSTree& tree1, const BSTree& tree2)
-{
-   m_tree.Intersection(tree1.m_tree, tree2.m_tree);
-}
-
-// prints tree with inorder traversal
-void BSTree::PrintTree()
-{
-   m_tree.printTree();
-   cout << endl;
-}
-
-// returns true is tree is filled from left to right
-// ** implemented with recursion **
-bool BSTree::IsComplete()
-{
-   return m_tree.IsComplete(); 
-}
-
-// returns true if tree is triangular
-bool BSTree::IsPerfect()
-{
-   return m_tree.IsPerfect();
-}
-
-  // finds sum of the depths of the internal nodes
-int BSTree::IPL()
-{
-   return m_tree.IPL();
-}
-
-// finds sum of the depths of the external nodes 
-int BSTree::EPL()
-{
-   return m_tree.EPL();
-}
-
-// Ignores elements and determines if the shapes match
-bool BSTree::Same_Shape(const BSTree& tree)
-{
-   return m_tree.Same_Shape(tree.m_tree);
-}
+//*********************
+// File : BSTree.cpp
+// Author : Alec Prassinos
+// user name : alecp1
+// Date : Monday Nov 1 04
+//
+// Vote Kerry
+//
+// Wrapper class for a BinarySearchTree<class Comparable>
+// Defined in BinarySearchTree.h
+// Simply Abstracts code from the orignal tree.
+//
+//*********************
+
+#include "BSTree.h"
+#include "BinarySearchTree.h"
+#include "FrozenTree.h"
+#include "IntBTree.h"
+#include "PersistentTree.h"
+#include "TreeStats.h"
+#include "dsexceptions.h"
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+using namespace std;
+
+// default constructor
+BSTree::BSTree()
+   :m_name(" "), m_sentinel(-1), m_store(in_place_index<BINARY_TREE>, -1),
+    m_values(make_pair(-1, -1)){}
+
+// Named Tree constructor
+BSTree::BSTree(int sentinel, string name)
+   : m_name(name), m_sentinel(sentinel), m_store(in_place_index<BINARY_TREE>, sentinel),
+     m_values(make_pair(sentinel, sentinel))
+{
+   //no code
+}
+
+// Named Tree constructor stored in the given engine
+BSTree::BSTree(int sentinel, string name, Engine engine)
+   : m_name(name), m_sentinel(sentinel), m_store(EmptyStore(sentinel, engine)),
+     m_values(make_pair(sentinel, sentinel))
+{
+   //no code
+}
+
+// Named Tree built from a list of keys, in any order
+BSTree::BSTree(int sentinel, string name, const vector<int>& keys)
+   : m_name(name), m_sentinel(sentinel),
+     m_store(in_place_index<BINARY_TREE>, sentinel, keys.begin(), keys.end()),
+     m_values(make_pair(sentinel, sentinel))
+{
+   //no code
+}
+
+// Copies tree into a tree of a different name
+BSTree::BSTree(const BSTree& tree, string name)
+   : m_name(name), m_sentinel(tree.m_sentinel), m_store(tree.m_store),
+     m_values(tree.m_values)
+{
+   //no code
+}
+
+// Copies tree with same name
+BSTree::BSTree(const BSTree& rhs)
+   : m_name(rhs.m_name), m_sentinel(rhs.m_sentinel), m_store(rhs.m_store),
+     m_values(rhs.m_values)
+{
+   // no code
+}
+
+// Takes over the nodes of rhs; rhs is left empty
+BSTree::BSTree(BSTree&& rhs)
+   : m_name(std::move(rhs.m_name)), m_sentinel(rhs.m_sentinel),
+     m_store(std::move(rhs.m_store)), m_values(std::move(rhs.m_values))
+{
+   // no code
+}
+
+
+// default destructor
+BSTree::~BSTree()
+{
+
+}
+
+// Copies rhs, name included
+const BSTree& BSTree::operator=(const BSTree& rhs)
+{
+   if (this != &rhs)
+   {
+      m_name = rhs.m_name;
+      m_sentinel = rhs.m_sentinel;
+      m_store = rhs.m_store;
+      m_values = rhs.m_values;
+   }
+   return *this;
+}
+
+// Takes over the nodes of rhs, name included; rhs is left empty
+const BSTree& BSTree::operator=(BSTree&& rhs)
+{
+   if (this != &rhs)
+   {
+      m_name = std::move(rhs.m_name);
+      m_sentinel = rhs.m_sentinel;
+      m_store = std::move(rhs.m_store);
+      m_values = std::move(rhs.m_values);
+   }
+   return *this;
+}
+
+// Exchanges names, engines and nodes with rhs, in constant time
+void BSTree::swap(BSTree& rhs)
+{
+   m_name.swap(rhs.m_name);
+   std::swap(m_sentinel, rhs.m_sentinel);
+   m_store.swap(rhs.m_store);
+   m_values.swap(rhs.m_values);
+}
+
+// an empty tree of the given engine
+BSTree::Store BSTree::EmptyStore(int sentinel, Engine engine)
+{
+   switch (engine)
+   {
+      case B_TREE:
+         return Store(in_place_index<B_TREE>, sentinel);
+      case PERSISTENT:
+         return Store(in_place_index<PERSISTENT>, sentinel);
+      default:
+         return Store(in_place_index<BINARY_TREE>, sentinel);
+   }
+}
+
+// useless accessors
+string BSTree::GetName() const
+{
+   return m_name;
+}
+
+// useless accessors
+// only the BINARY_TREE engine keeps a BinarySearchTree to hand out
+const BSTree::IntTree& BSTree::GetTree() const &
+{
+   if (GetEngine() != BINARY_TREE)
+      throw WrongEngine();
+   return get<BINARY_TREE>(m_store);
+}
+
+// a temporary gives up its keys rather than copy them
+BSTree::IntTree BSTree::GetTree() &&
+{
+   return Release();
+}
+
+// moves the keys out as a binary tree and leaves this tree empty;
+// a B-tree or persistent tree is rebuilt as a balanced binary tree
+BSTree::IntTree BSTree::Release()
+{
+   if (GetEngine() == BINARY_TREE)
+      return std::move(get<BINARY_TREE>(m_store));
+
+   IntTree released(m_sentinel);
+   AsBinaryTree(released);
+   m_store = EmptyStore(m_sentinel, GetEngine());
+   return released;
+}
+
+// the current contents as a persistent tree, which later
+// changes do not affect (O(1) on the PERSISTENT engine)
+PersistentTree<int> BSTree::GetVersion() const
+{
+   PersistentTree<int> scratch(m_sentinel);
+
+   return AsPersistent(scratch);
+}
+
+// useless accessors
+BSTree::Engine BSTree::GetEngine() const
+{
+   return Engine(m_store.index());
+}
+
+// returns x if it is in the tree, else the sentinel
+int BSTree::find(int x) const
+{
+   return std::visit([x](const auto& tree) { return tree.find(x); }, m_store);
+}
+
+// number of items, in constant time
+int BSTree::size() const
+{
+   return std::visit([](const auto& tree) { return tree.size(); }, m_store);
+}
+
+// number of items less than x
+int BSTree::rank(int x) const
+{
+   return std::visit([x](const auto& tree) { return tree.rank(x); }, m_store);
+}
+
+// item with exactly k smaller items, or the sentinel
+int BSTree::select(int k) const
+{
+   return std::visit([k](const auto& tree) { return tree.select(k); }, m_store);
+}
+
+// iterator to the smallest item
+BSTree::const_iterator BSTree::begin() const
+{
+   return std::visit([](const auto& tree) { return const_iterator(tree.begin()); },
+                     m_store);
+}
+
+// iterator past the largest item
+BSTree::const_iterator BSTree::end() const
+{
+   return std::visit([](const auto& tree) { return const_iterator(tree.end()); },
+                     m_store);
+}
+
+// first item not less than x
+BSTree::const_iterator BSTree::lower_bound(int x) const
+{
+   return std::visit([x](const auto& tree) { return const_iterator(tree.lower_bound(x)); },
+                     m_store);
+}
+
+// first item greater than x
+BSTree::const_iterator BSTree::upper_bound(int x) const
+{
+   return std::visit([x](const auto& tree) { return const_iterator(tree.upper_bound(x)); },
+                     m_store);
+}
+
+// the items equal to x
+pair<BSTree::const_iterator, BSTree::const_iterator> BSTree::equal_range(int x) const
+{
+   return make_pair(lower_bound(x), upper_bound(x));
+}
+
+// inserts x into the tree
+void BSTree::insert(int x)
+{
+   std::visit([x](auto& tree) { tree.insert(x); }, m_store);
+}
+
+// replaces the tree with a balanced tree of keys, in any order
+void BSTree::assign(const vector<int>& keys)
+{
+   vector<int> sorted;
+
+   switch (GetEngine())
+   {
+      case B_TREE:
+         get<B_TREE>(m_store).assign(keys);
+         break;
+      case PERSISTENT:
+         sorted = keys;
+         sort(sorted.begin(), sorted.end());
+         sorted.erase(unique(sorted.begin(), sorted.end()), sorted.end());
+         get<PERSISTENT>(m_store).assign(sorted);
+         break;
+      default:
+         get<BINARY_TREE>(m_store).assign(keys.begin(), keys.end());
+   }
+}
+
+ // removes x from the tree
+void BSTree::remove(int x)
+{
+   std::visit([x](auto& tree) { tree.remove(x); }, m_store);
+}
+
+// inserts keys[0..n-1], in any order
+void BSTree::insertBatch(const int* keys, size_t n)
+{
+   vector<int> sorted;
+   vector<int> mine;
+   vector<int> result;
+
+   if (GetEngine() == BINARY_TREE)
+   {
+      get<BINARY_TREE>(m_store).insertBatch(keys, n);
+      return;
+   }
+
+   if (!SortBatch(keys, n, sorted))
+   {
+      if (GetEngine() == B_TREE)
+      {
+         // a findBatch pass pulls the paths into cache with its
+         // prefetches, and the keys it finds need no insert; a key
+         // equal to the sentinel is inserted either way
+         vector<int> found(sorted.size());
+
+         get<B_TREE>(m_store).findBatch(sorted.data(), sorted.size(), found.data());
+         for (size_t i = 0; i < sorted.size(); i++)
+            if (found[i] != sorted[i] || sorted[i] == m_sentinel)
+               insert(sorted[i]);
+      }
+      else
+      {
+         for (size_t i = 0; i < sorted.size(); i++)
+            insert(sorted[i]);
+      }
+      return;
+   }
+   Keys(mine);
+   result.reserve(mine.size() + sorted.size());
+   set_union(mine.begin(), mine.end(), sorted.begin(), sorted.end(),
+             back_inserter(result));
+   assign(result);
+}
+
+// removes keys[0..n-1], in any order
+void BSTree::removeBatch(const int* keys, size_t n)
+{
+   vector<int> sorted;
+   vector<int> mine;
+   vector<int> result;
+
+   if (GetEngine() == BINARY_TREE)
+   {
+      get<BINARY_TREE>(m_store).removeBatch(keys, n);
+      return;
+   }
+
+   if (!SortBatch(keys, n, sorted))
+   {
+      for (size_t i = 0; i < sorted.size(); i++)
+         remove(sorted[i]);
+      return;
+   }
+   Keys(mine);
+   set_difference(mine.begin(), mine.end(), sorted.begin(), sorted.end(),
+                  back_inserter(result));
+   assign(result);
+}
+
+// sets results[i] to find(keys[i]) for each i < n
+void BSTree::findBatch(const int* keys, size_t n, int* results) const
+{
+   switch (GetEngine())
+   {
+      case B_TREE:
+         get<B_TREE>(m_store).findBatch(keys, n, results);
+         break;
+      case PERSISTENT:
+         for (size_t i = 0; i < n; i++)
+            results[i] = get<PERSISTENT>(m_store).find(keys[i]);
+         break;
+      default:
+         get<BINARY_TREE>(m_store).findBatch(keys, n, results);
+   }
+}
+
+// sets the value of k to v; true if k had none
+bool BSTree::insert_or_assign(int k, int v)
+{
+   return m_values.insert_or_assign(k, v);
+}
+
+// gives k the value v unless it has one; true if it did not
+bool BSTree::try_emplace(int k, int v)
+{
+   return m_values.try_emplace(k, v);
+}
+
+// the value of k, set to 0 first if k has none
+int& BSTree::operator[](int k)
+{
+   return m_values[k];
+}
+
+// the value of k, or NULL if it has none
+int* BSTree::findValue(int k)
+{
+   return m_values.findValue(k);
+}
+
+const int* BSTree::findValue(int k) const
+{
+   return m_values.findValue(k);
+}
+
+// drops the value of k, if any
+void BSTree::removeValue(int k)
+{
+   m_values.remove(k);
+}
+
+// the keys and their values
+const BSTree::IntMap& BSTree::GetValues() const
+{
+   return m_values;
+}
+
+// Copies elements of tree into this tree
+void BSTree::Union( const BSTree& tree)
+{
+   switch (GetEngine())
+   {
+      case B_TREE:
+      {
+         IntBTree scratch(-1);
+         get<B_TREE>(m_store).Union(tree.AsBTree(scratch));
+         break;
+      }
+      case PERSISTENT:
+      {
+         PersistentTree<int> scratch(-1);
+         get<PERSISTENT>(m_store).Union(tree.AsPersistent(scratch));
+         break;
+      }
+      default:
+      {
+         IntTree scratch(-1);
+         get<BINARY_TREE>(m_store).Union(tree.AsBinaryTree(scratch));
+      }
+   }
+}
+
+// Copies matching elements in tree1 and tree2 into this tree
+void BSTree::Intersection( const BSTree& tree1, const BSTree& tree2)
+{
+   switch (GetEngine())
+   {
+      case B_TREE:
+      {
+         IntBTree scratch1(-1), scratch2(-1);
+         get<B_TREE>(m_store).Intersection(tree1.AsBTree(scratch1),
+                                           tree2.AsBTree(scratch2));
+         break;
+      }
+      case PERSISTENT:
+      {
+         PersistentTree<int> scratch1(-1), scratch2(-1);
+         get<PERSISTENT>(m_store).Intersection(tree1.AsPersistent(scratch1),
+                                               tree2.AsPersistent(scratch2));
+         break;
+      }
+      default:
+      {
+         IntTree scratch1(-1), scratch2(-1);
+         get<BINARY_TREE>(m_store).Intersection(tree1.AsBinaryTree(scratch1),
+                                                tree2.AsBinaryTree(scratch2));
+      }
+   }
+}
+
+// Copies elements of tree1 missing from tree2 into this tree
+void BSTree::Difference( const BSTree& tree1, const BSTree& tree2)
+{
+   switch (GetEngine())
+   {
+      case B_TREE:
+      {
+         IntBTree scratch1(-1), scratch2(-1);
+         get<B_TREE>(m_store).Difference(tree1.AsBTree(scratch1),
+                                         tree2.AsBTree(scratch2));
+         break;
+      }
+      case PERSISTENT:
+      {
+         PersistentTree<int> scratch1(-1), scratch2(-1);
+         get<PERSISTENT>(m_store).Difference(tree1.AsPersistent(scratch1),
+                                             tree2.AsPersistent(scratch2));
+         break;
+      }
+      default:
+      {
+         IntTree scratch1(-1), scratch2(-1);
+         get<BINARY_TREE>(m_store).Difference(tree1.AsBinaryTree(scratch1),
+                                              tree2.AsBinaryTree(scratch2));
+      }
+   }
+}
+
+// Copies elements found in only one of tree1 and tree2 into this tree
+void BSTree::SymmetricDifference( const BSTree& tree1, const BSTree& tree2)
+{
+   switch (GetEngine())
+   {
+      case B_TREE:
+      {
+         IntBTree scratch1(-1), scratch2(-1);
+         get<B_TREE>(m_store).SymmetricDifference(tree1.AsBTree(scratch1),
+                                                  tree2.AsBTree(scratch2));
+         break;
+      }
+      case PERSISTENT:
+      {
+         PersistentTree<int> scratch1(-1), scratch2(-1);
+         get<PERSISTENT>(m_store).SymmetricDifference(tree1.AsPersistent(scratch1),
+                                                      tree2.AsPersistent(scratch2));
+         break;
+      }
+      default:
+      {
+         IntTree scratch1(-1), scratch2(-1);
+         get<BINARY_TREE>(m_store).SymmetricDifference(tree1.AsBinaryTree(scratch1),
+                                                       tree2.AsBinaryTree(scratch2));
+      }
+   }
+}
+
+// prints tree with inorder traversal
+void BSTree::PrintTree()
+{
+   std::visit([](const auto& tree) { tree.printTree(); }, m_store);
+   cout << endl;
+}
+
+// writes the keys to a file; see FrozenTree.h for the format
+bool BSTree::save(const string& path) const
+{
+   vector<int> keys;
+
+   Keys(keys);
+   return FrozenTree<int>(-1, keys).save(path);
+}
+
+// replaces the keys with those saved in a file
+bool BSTree::load(const string& path)
+{
+   FrozenTree<int> file(-1);
+
+   if (!file.load(path))
+      return false;
+   assign(vector<int>(file.begin(), file.end()));
+   return true;
+}
+
+// counters of the BinarySearchTree; other engines report their size
+TreeStats BSTree::stats() const
+{
+   if (GetEngine() == BINARY_TREE)
+      return get<BINARY_TREE>(m_store).stats();
+
+   TreeStats s = TreeStats();
+   s.size = size();
+   return s;
+}
+
+// zeroes the operation counters
+void BSTree::resetStats()
+{
+   if (GetEngine() == BINARY_TREE)
+      get<BINARY_TREE>(m_store).resetStats();
+}
+
+// writes one histogram of operation latencies, in seconds
+static void PrintLatency(ostream& out, const string& labels, const char* op,
+                         const LatencyHistogram& h)
+{
+   const char* metric = "bstree_operation_duration_seconds";
+   uint64_t below = 0;
+
+   for (int k = 0; k < LatencyHistogram::BUCKETS - 1; k++)
+   {
+      below += h.buckets[k];
+      out << metric << "_bucket{" << labels << ",op=\"" << op << "\",le=\""
+          << (double) (1ULL << k) * 1e-9 << "\"} " << below << "\n";
+   }
+   out << metric << "_bucket{" << labels << ",op=\"" << op << "\",le=\"+Inf\"} "
+       << h.count << "\n";
+   out << metric << "_sum{" << labels << ",op=\"" << op << "\"} "
+       << h.totalNanos * 1e-9 << "\n";
+   out << metric << "_count{" << labels << ",op=\"" << op << "\"} "
+       << h.count << "\n";
+}
+
+// writes the counters in the Prometheus text format
+void BSTree::PrintMetrics(ostream& out) const
+{
+   TreeStats s = stats();
+   string labels = "tree=\"";
+   streamsize precision = out.precision(9);
+
+   for (size_t i = 0; i < m_name.size(); i++)
+   {
+      if (m_name[i] == '\n')
+         labels += "\\n";
+      else
+      {
+         if (m_name[i] == '\\' || m_name[i] == '"')
+            labels += '\\';
+         labels += m_name[i];
+      }
+   }
+   labels += "\"";
+
+   out << "# HELP bstree_stats_enabled 1 if the tree keeps counters.\n"
+       << "# TYPE bstree_stats_enabled gauge\n"
+       << "bstree_stats_enabled{" << labels << "} " << (s.enabled ? 1 : 0) << "\n"
+       << "# HELP bstree_items Items in the tree.\n"
+       << "# TYPE bstree_items gauge\n"
+       << "bstree_items{" << labels << "} " << s.size << "\n";
+   if (s.shaped)
+      out << "# HELP bstree_height Longest path from the root, in links.\n"
+          << "# TYPE bstree_height gauge\n"
+          << "bstree_height{" << labels << "} " << s.height << "\n";
+   if (!s.enabled)
+   {
+      out.precision(precision);
+      return;
+   }
+
+   out << "# HELP bstree_depth_sum Sum of the depths of the nodes.\n"
+       << "# TYPE bstree_depth_sum gauge\n"
+       << "bstree_depth_sum{" << labels << "} " << s.depthSum << "\n"
+       << "# HELP bstree_average_depth Mean depth of the nodes.\n"
+       << "# TYPE bstree_average_depth gauge\n"
+       << "bstree_average_depth{" << labels << "} " << s.averageDepth() << "\n"
+       << "# HELP bstree_max_depth Deepest node reached by an operation.\n"
+       << "# TYPE bstree_max_depth gauge\n"
+       << "bstree_max_depth{" << labels << "} " << s.maxDepth << "\n"
+       << "# HELP bstree_finds_total Lookups.\n"
+       << "# TYPE bstree_finds_total counter\n"
+       << "bstree_finds_total{" << labels << "} " << s.finds << "\n"
+       << "# HELP bstree_find_comparisons_total Comparisons made by lookups.\n"
+       << "# TYPE bstree_find_comparisons_total counter\n"
+       << "bstree_find_comparisons_total{" << labels << "} " << s.findComparisons << "\n"
+       << "# HELP bstree_inserts_total Items inserted one at a time.\n"
+       << "# TYPE bstree_inserts_total counter\n"
+       << "bstree_inserts_total{" << labels << "} " << s.inserts << "\n"
+       << "# HELP bstree_removes_total Items removed one at a time.\n"
+       << "# TYPE bstree_removes_total counter\n"
+       << "bstree_removes_total{" << labels << "} " << s.removes << "\n"
+       << "# HELP bstree_node_allocations_total Nodes constructed.\n"
+       << "# TYPE bstree_node_allocations_total counter\n"
+       << "bstree_node_allocations_total{" << labels << "} " << s.allocations << "\n"
+       << "# HELP bstree_rotations_total Single rotations.\n"
+       << "# TYPE bstree_rotations_total counter\n"
+       << "bstree_rotations_total{" << labels << "} " << s.rotations << "\n"
+       << "# HELP bstree_operation_duration_seconds Time taken by find, insert and remove.\n"
+       << "# TYPE bstree_operation_duration_seconds histogram\n";
+   PrintLatency(out, labels, "find", s.findLatency);
+   PrintLatency(out, labels, "insert", s.insertLatency);
+   PrintLatency(out, labels, "remove", s.removeLatency);
+   out.precision(precision);
+}
+
+// returns true is tree is filled from left to right
+bool BSTree::IsComplete()
+{
+   return HasShape("IsComplete") && get<BINARY_TREE>(m_store).IsComplete(); 
+}
+
+// returns true if tree is triangular
+bool BSTree::IsPerfect()
+{
+   return HasShape("IsPerfect") && get<BINARY_TREE>(m_store).IsPerfect();
+}
+
+  // finds sum of the depths of the internal nodes
+int BSTree::IPL()
+{
+   return HasShape("IPL") ? get<BINARY_TREE>(m_store).IPL() : 0;
+}
+
+// finds sum of the depths of the external nodes 
+int BSTree::EPL()
+{
+   return HasShape("EPL") ? get<BINARY_TREE>(m_store).EPL() : 0;
+}
+
+// Ignores elements and determines if the shapes match
+bool BSTree::Same_Shape(const BSTree& tree)
+{
+   return HasShape("Same_Shape") && tree.HasShape("Same_Shape") &&
+          get<BINARY_TREE>(m_store).Same_Shape(get<BINARY_TREE>(tree.m_store));
+}
+
+// true if both trees hold the same keys
+bool BSTree::operator==(const BSTree& rhs) const
+{
+   if (GetEngine() == BINARY_TREE && rhs.GetEngine() == BINARY_TREE)
+      return get<BINARY_TREE>(m_store) == get<BINARY_TREE>(rhs.m_store);
+   return size() == rhs.size() && equal(begin(), end(), rhs.begin());
+}
+
+// true unless both trees hold the same keys
+bool BSTree::operator!=(const BSTree& rhs) const
+{
+   return !(*this == rhs);
+}
+
+// appends the tree's keys to keys in sorted order
+void BSTree::Keys(vector<int>& keys) const
+{
+   const IntTree* tree;
+
+   switch (GetEngine())
+   {
+      case B_TREE:
+         get<B_TREE>(m_store).flatten(keys);
+         break;
+      case PERSISTENT:
+         get<PERSISTENT>(m_store).flatten(keys);
+         break;
+      default:
+         tree = &get<BINARY_TREE>(m_store);
+         keys.reserve(keys.size() + tree->size());
+         keys.insert(keys.end(), tree->begin(), tree->end());
+   }
+}
+
+// returns the tree's keys as a binary tree, filling scratch only
+// when the tree uses another engine
+const BSTree::IntTree& BSTree::AsBinaryTree(IntTree& scratch) const
+{
+   if (GetEngine() == BINARY_TREE)
+      return get<BINARY_TREE>(m_store);
+
+   vector<int> keys;
+   Keys(keys);
+   scratch.assign(keys.begin(), keys.end());
+   return scratch;
+}
+
+// returns the tree's keys as a B-tree, filling scratch only when
+// the tree uses another engine
+const IntBTree& BSTree::AsBTree(IntBTree& scratch) const
+{
+   if (GetEngine() == B_TREE)
+      return get<B_TREE>(m_store);
+
+   vector<int> keys;
+   Keys(keys);
+   scratch.assign(keys);
+   return scratch;
+}
+
+// returns the tree's keys as a persistent tree, filling scratch
+// only when the tree uses another engine
+const PersistentTree<int>& BSTree::AsPersistent(PersistentTree<int>& scratch) const
+{
+   if (GetEngine() == PERSISTENT)
+      return get<PERSISTENT>(m_store);
+
+   vector<int> keys;
+   Keys(keys);
+   scratch.assign(keys);
+   return scratch;
+}
+
+// sorts a batch and drops duplicates; true if it should be merged
+bool BSTree::SortBatch(const int* keys, size_t n, vector<int>& sorted) const
+{
+   sorted.assign(keys, keys + n);
+   sort(sorted.begin(), sorted.end());
+   sorted.erase(unique(sorted.begin(), sorted.end()), sorted.end());
+   return sorted.size() * IntTree::BATCH_REBUILD_RATIO >= (size_t) size();
+}
+
+// returns false after reporting a shape query on another engine
+bool BSTree::HasShape(const char* query) const
+{
+   if (GetEngine() == BINARY_TREE)
+      return true;
+
+   cerr << query << ": " << m_name << " is not stored as a BinarySearchTree" << endl;
+   return false;
+}
+
+// iterator over an engine's items; the default one is singular
+BSTree::const_iterator::const_iterator()
+{
+   // no code
+}
+
+BSTree::const_iterator::const_iterator(IntTree::const_iterator node)
+   : m_at(in_place_index<BINARY_TREE>, node)
+{
+   // no code
+}
+
+BSTree::const_iterator::const_iterator(IntBTree::const_iterator slot)
+   : m_at(in_place_index<B_TREE>, slot)
+{
+   // no code
+}
+
+BSTree::const_iterator::const_iterator(PersistentTree<int>::const_iterator path)
+   : m_at(in_place_index<PERSISTENT>, path)
+{
+   // no code
+}
+
+const int& BSTree::const_iterator::operator*() const
+{
+   return std::visit([](const auto& at) -> const int& { return *at; }, m_at);
+}
+
+const int* BSTree::const_iterator::operator->() const
+{
+   return &**this;
+}
+
+BSTree::const_iterator& BSTree::const_iterator::operator++()
+{
+   std::visit([](auto& at) { ++at; }, m_at);
+   return *this;
+}
+
+BSTree::const_iterator BSTree::const_iterator::operator++(int)
+{
+   const_iterator old = *this;
+   ++*this;
+   return old;
+}
+
+BSTree::const_iterator& BSTree::const_iterator::operator--()
+{
+   std::visit([](auto& at) { --at; }, m_at);
+   return *this;
+}
+
+BSTree::const_iterator BSTree::const_iterator::operator--(int)
+{
+   const_iterator old = *this;
+   --*this;
+   return old;
+}
+
+bool BSTree::const_iterator::operator==(const const_iterator& rhs) const
+{
+   return m_at == rhs.m_at;
+}
+
+bool BSTree::const_iterator::operator!=(const const_iterator& rhs) const
+{
+   return !(*this == rhs);
+}
@@ -1,86 +1,292 @@
-//*********************
-// File : BSTree.h
-// Author : Alec Prassinos
-// user name : alecp1
-// Date : Monday Nov 1 04
-//
-// Vote Kerry
-//
-// Wrapper class for a BinarySearchTree<class Comparable>
-// Defined in BinarySearchTree.h
-// Simply Abstracts code from the orignal tree.
-//
-//*********************
-#ifndef BSTREE_H_
-#define BSTREE_H_
-
-#include "BSTree.h"
-#include "BinarySearchTree.h"
-#include "Proj3Aux.h"
-#include "dsexceptions.h"
-#include <iostream>
-#include <string>
-#include <vector>
-
-using namespace std;
-
-class BSTree
-{
-
-   public:
-
-      // default constructor
-      BSTree();
-      // Named Tree constructor
-      BSTree(int sentinel, string name);
-      // Copies tree into a tree of a different name
-      BSTree(const BSTree& tree, string name);
-      // Copies tree with same name
-      BSTree(const BSTree& rhs);
-      
-      // default destructor
-      ~BSTree();
-
-      // useless accessors
-      string GetName() const;
-      BinarySearchTree < int > GetTree();
-
-      // inserts x into the tree
-      void insert(int x);
-      // removes x from the tree
-      void remove(int x);
-
-      // Copies elements of tree into m_tree
-      void Union( const BSTree& tree);
-      // Copies matching elements in tree1 and tree2 into m_tree
-      void Intersection( const BSTree& tree1, const BSTree& tree2);
-
-      // returns true if tree is triangular
-      bool IsPerfect();
-      // returns true is tree is filled from left to right
-      // ** implemented with recursion **
-      bool IsComplete();
-
-      // finds sum of the depths of the internal nodes
-      int IPL();
-      // finds sum of the depths of the external nodes 
-      int EPL();
-
-      // Ignores elements and determines if the shapes match
-      bool Same_Shape(const BSTree& tree);
-
-      // prints tree with inorder traversal
-      void PrintTree();
-
-		
-   private:
-      string m_name;
-      BinarySearchTree<int> m_tree;
-                
-};
-
-
-
-
-
-#endif
+//*********************
+// File : BSTree.h
+// Author : Alec Prassinos
+// user name : alecp1
+// Date : Monday Nov 1 04
+//
+// Vote Kerry
+//
+// Wrapper class for a BinarySearchTree<class Comparable>
+// Defined in BinarySearchTree.h
+// Simply Abstracts code from the orignal tree.
+//
+//*********************
+#ifndef BSTREE_H_
+#define BSTREE_H_
+
+#include "BSTree.h"
+#include "BinarySearchTree.h"
+#include "IntBTree.h"
+#include "PersistentTree.h"
+#include "TreeStats.h"
+#include "dsexceptions.h"
+#include <cstddef>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+using namespace std;
+
+class BSTree
+{
+
+   public:
+
+      // node layouts the tree can be stored in
+      enum Engine
+      {
+         BINARY_TREE,   // IntTree, one key per node
+         B_TREE,        // IntBTree, 16 keys per node; faster lookups
+         PERSISTENT     // PersistentTree<int>; copies share nodes, O(1)
+      };
+
+      // the tree of the BINARY_TREE engine; red-black, so its height
+      // stays O(log n) whatever order the keys come in
+      typedef BinarySearchTree<int, RedBlackPolicy> IntTree;
+
+      // int keys with an int payload each, looked up and updated in
+      // one descent; the map of values below. See BinarySearchMap in
+      // BinarySearchTree.h
+      typedef BinarySearchMap<int, int, RedBlackPolicy> IntMap;
+
+      // iterates over the items of any engine in sorted order
+      class const_iterator
+      {
+         public:
+            typedef bidirectional_iterator_tag iterator_category;
+            typedef int value_type;
+            typedef ptrdiff_t difference_type;
+            typedef const int* pointer;
+            typedef const int& reference;
+
+            const_iterator();
+
+            const int& operator*() const;
+            const int* operator->() const;
+            const_iterator& operator++();
+            const_iterator operator++(int);
+            const_iterator& operator--();
+            const_iterator operator--(int);
+            bool operator==(const const_iterator& rhs) const;
+            bool operator!=(const const_iterator& rhs) const;
+
+         private:
+            // the active engine's iterator, indexed like Engine
+            variant<IntTree::const_iterator, IntBTree::const_iterator,
+                    PersistentTree<int>::const_iterator> m_at;
+
+            explicit const_iterator(IntTree::const_iterator node);
+            explicit const_iterator(IntBTree::const_iterator slot);
+            explicit const_iterator(PersistentTree<int>::const_iterator path);
+            friend class BSTree;
+      };
+
+      // default constructor
+      BSTree();
+      // Named Tree constructor
+      BSTree(int sentinel, string name);
+      // Named Tree constructor stored in the given engine
+      BSTree(int sentinel, string name, Engine engine);
+      // Named Tree built from a list of keys, in any order
+      BSTree(int sentinel, string name, const vector<int>& keys);
+      // Copies tree into a tree of a different name
+      // (O(1) on the PERSISTENT engine)
+      BSTree(const BSTree& tree, string name);
+      // Copies tree with same name (O(1) on the PERSISTENT engine)
+      BSTree(const BSTree& rhs);
+      // Takes over the nodes of rhs without copying them; rhs is
+      // left empty
+      BSTree(BSTree&& rhs);
+
+      // default destructor
+      ~BSTree();
+
+      // Copies rhs, name included
+      const BSTree& operator=(const BSTree& rhs);
+      // Takes over the nodes of rhs, name included; rhs is left empty
+      const BSTree& operator=(BSTree&& rhs);
+      // Exchanges names, engines and nodes with rhs, in constant time
+      void swap(BSTree& rhs);
+
+      // useless accessors
+      string GetName() const;
+      // the tree itself, without a copy; only the BINARY_TREE
+      // engine keeps one, so the others throw WrongEngine
+      const IntTree& GetTree() const &;
+      // a temporary's keys as a binary tree; see Release
+      IntTree GetTree() &&;
+      // moves the keys out as a binary tree, built in linear time on
+      // the other engines, and leaves this tree empty
+      IntTree Release();
+      // the current contents as a persistent tree, which later
+      // changes do not affect (O(1) on the PERSISTENT engine)
+      PersistentTree<int> GetVersion() const;
+      Engine GetEngine() const;
+
+      // returns x if it is in the tree, else the sentinel
+      int find(int x) const;
+      // number of items, in constant time
+      int size() const;
+      // number of items less than x
+      int rank(int x) const;
+      // item with exactly k smaller items, or the sentinel
+      int select(int k) const;
+
+      // iterators over the items in sorted order; see
+      // BinarySearchTree.h, IntBTree.h and PersistentTree.h for
+      // when they stay valid
+      const_iterator begin() const;
+      const_iterator end() const;
+      // first item not less than x
+      const_iterator lower_bound(int x) const;
+      // first item greater than x
+      const_iterator upper_bound(int x) const;
+      // the items equal to x
+      pair<const_iterator, const_iterator> equal_range(int x) const;
+      // calls visit(item) for each item in [lo, hi), in sorted order
+      template <class Visitor>
+      void range(int lo, int hi, Visitor visit) const;
+
+      // inserts x into the tree
+      void insert(int x);
+      // replaces the tree with a balanced tree of keys, in any order
+      void assign(const vector<int>& keys);
+      // removes x from the tree
+      void remove(int x);
+
+      // inserts keys[0..n-1], in any order; sorted first, and merged
+      // in one pass when the batch is large next to the tree
+      void insertBatch(const int* keys, size_t n);
+      // removes keys[0..n-1], in any order, the same way
+      void removeBatch(const int* keys, size_t n);
+      // sets results[i] to find(keys[i]) for each i < n, overlapping
+      // the cache misses of different keys
+      void findBatch(const int* keys, size_t n, int* results) const;
+
+      // Each tree also keeps an int value under any int key, in an
+      // IntMap beside the keys above and apart from them: a key may
+      // have a value without being in the tree, and the other
+      // operations leave the values alone. Each call below finds
+      // its key in one descent.
+
+      // sets the value of k to v; returns true if k had none
+      bool insert_or_assign(int k, int v);
+      // gives k the value v unless it has one; returns true if it
+      // did not
+      bool try_emplace(int k, int v);
+      // the value of k, set to 0 first if k has none
+      int& operator[](int k);
+      // the value of k, or NULL if it has none
+      int* findValue(int k);
+      const int* findValue(int k) const;
+      // calls f(value) on the value of k, in place; returns false,
+      // without calling f, if k has none
+      template <class Function>
+      bool update(int k, Function f);
+      // drops the value of k, if any
+      void removeValue(int k);
+      // the keys and their values
+      const IntMap& GetValues() const;
+
+      // Copies elements of tree into this tree
+      void Union( const BSTree& tree);
+      // Copies matching elements in tree1 and tree2 into this tree
+      void Intersection( const BSTree& tree1, const BSTree& tree2);
+      // Copies elements of tree1 missing from tree2 into this tree
+      void Difference( const BSTree& tree1, const BSTree& tree2);
+      // Copies elements found in only one of tree1 and tree2 into this tree
+      void SymmetricDifference( const BSTree& tree1, const BSTree& tree2);
+
+      // The shape queries below describe the BinarySearchTree; on
+      // other engines they print a message and return false or 0.
+
+      // returns true if tree is triangular
+      bool IsPerfect();
+      // returns true is tree is filled from left to right
+      bool IsComplete();
+
+      // finds sum of the depths of the internal nodes
+      int IPL();
+      // finds sum of the depths of the external nodes 
+      int EPL();
+
+      // Ignores elements and determines if the shapes match
+      bool Same_Shape(const BSTree& tree);
+      // true if both trees hold the same keys, whatever their names,
+      // engines and shapes
+      bool operator==(const BSTree& rhs) const;
+      bool operator!=(const BSTree& rhs) const;
+
+      // prints tree with inorder traversal
+      void PrintTree();
+
+      // writes the keys to a file; see FrozenTree.h for the format.
+      // Returns false if the file could not be written
+      bool save(const string& path) const;
+      // replaces the keys with those saved in a file; returns false,
+      // leaving the tree unchanged, if it is missing or damaged.
+      // To query a saved file in place, load it into a FrozenTree<int>
+      bool load(const string& path);
+
+      // counters kept by the BinarySearchTree when built with
+      // BINARY_SEARCH_TREE_STATS (see TreeStats.h); other engines,
+      // and builds without it, report the size only
+      TreeStats stats() const;
+      // zeroes the operation counters
+      void resetStats();
+      // writes the counters to out in the Prometheus text format,
+      // labelled with the tree's name
+      void PrintMetrics(ostream& out) const;
+
+		
+   private:
+      // the tree of the active engine; the index of the alternative
+      // held is the Engine, so only that engine takes any space
+      typedef variant<IntTree, IntBTree, PersistentTree<int> > Store;
+
+      string m_name;
+      int m_sentinel;
+      Store m_store;
+      IntMap m_values;
+
+      // an empty tree of the given engine
+      static Store EmptyStore(int sentinel, Engine engine);
+
+      // appends the tree's keys to keys in sorted order
+      void Keys(vector<int>& keys) const;
+      // returns the tree's keys as a tree of each engine, filling
+      // scratch only when the tree uses another engine
+      const IntTree& AsBinaryTree(IntTree& scratch) const;
+      const IntBTree& AsBTree(IntBTree& scratch) const;
+      const PersistentTree<int>& AsPersistent(PersistentTree<int>& scratch) const;
+      // returns false after reporting a shape query on another engine
+      bool HasShape(const char* query) const;
+      // sorts keys[0..n-1] into sorted and drops duplicates; returns
+      // true if the batch is large enough to merge rather than apply
+      // key by key
+      bool SortBatch(const int* keys, size_t n, vector<int>& sorted) const;
+                
+};
+
+// calls visit(item) for each item in [lo, hi), in sorted order
+template <class Visitor>
+void BSTree::range(int lo, int hi, Visitor visit) const
+{
+   std::visit([&](const auto& tree) { tree.range(lo, hi, visit); }, m_store);
+}
+
+// calls f(value) on the value of k, in place
+template <class Function>
+bool BSTree::update(int k, Function f)
+{
+   return m_values.update(k, f);
+}
+
+
+
+
+
+#endif
@@ -1,585 +1,3527 @@
-#include "BinarySearchTree.h"
-#include <iostream>
-#include <vector>
-
-using namespace std;
-
-/**
- * Implements an unbalanced binary search tree.
- * Note that all "matching" is based on the < method.
- */
-
-/**
- * Construct the tree.
- */
-template <class Comparable>
-BinarySearchTree<Comparable>::BinarySearchTree( const Comparable & notFound ) :
-   root(NULL), ITEM_NOT_FOUND( notFound )
-{
-}
-
-
-/**
- * Copy constructor.
- */
-template <class Comparable>
-BinarySearchTree<Comparable>::
-BinarySearchTree( const BinarySearchTree<Comparable> & rhs ) :
-  root( NULL ), ITEM_NOT_FOUND( rhs.ITEM_NOT_FOUND )
-{ 
-  *this = rhs;
-}
-
-/**
- * Destructor for the tree.
- */
-template <class Comparable>
-BinarySearchTree<Comparable>::~BinarySearchTree( )
-{
-  makeEmpty( );
-}
-
-/**
- * Insert x into the tree; duplicates are ignored.
- */
-template <class Comparable>
-void BinarySearchTree<Comparable>::insert( const Comparable & x )
-{
-  insert( x, root );
-}
-
-/**
- * Remove x from the tree. Nothing is done if x is not found.
- */
-template <class Comparable>
-void BinarySearchTree<Comparable>::remove( const Comparable & x )
-{
-  remove( x, root );
-}
-
-
-/**
- * Find the smallest item in the tree.
- * Return smallest item or ITEM_NOT_FOUND if empty.
- */
-template <class Comparable>
-const Comparable & BinarySearchTree<Comparable>::findMin( ) const
-{
-  return elementAt( findMin( root ) );
-}
-
-/**
- * Find the largest item in the tree.
- * Return the largest item of ITEM_NOT_FOUND if empty.
- */
-template <class Comparable>
-const Comparable & BinarySearchTree<Comparable>::findMax( ) const
-{
-  return elementAt( findMax( root ) );
-}
-
-/**
- * Find item x in the tree.
- * Return the matching item or ITEM_NOT_FOUND if not found.
- */
-template <class Comparable>
-const Comparable & BinarySearchTree<Comparable>::
-find( const Comparable & x ) const
-{
-  return elementAt( find( x, root ) );
-}
-
-/**
- * Make the tree logically empty.
- */
-template <class Comparable>
-void BinarySearchTree<Comparable>::makeEmpty( )
-{
-  makeEmpty( root );
-}
-
-/**
- * Test if the tree is logically empty.
- * Return true if empty, false otherwise.
- */
-template <class Comparable>
-bool BinarySearchTree<Comparable>::isEmpty( ) const
-{
-  return root == NULL;
-}
-
-/**
- * Print the tree contents in sorted order.
- */
-template <class Comparable>
-void BinarySearchTree<Comparable>::printTree( ) const
-{
-  if( isEmpty( ) )
-    cout << "Empty tree" << endl;
-  else
-    printTree( root );
-}
-
-/**
- * Deep copy.
- */
-template <class Comparable>
-const BinarySearchTree<Comparable> &
-BinarySearchTree<Comparable>::
-operator=( const BinarySearchTree<Comparable> & rhs )
-{
-  if( this != &rhs )
-    {
-      makeEmpty( );
-      root = clone( rhs.root );
-    }
-  return *this;
-}
-
-/**
- * Internal method to get element field in node t.
- * Return the element field or ITEM_NOT_FOUND if t is NULL.
- */
-template <class Comparable>
-const Comparable & BinarySearchTree<Comparable>::
-elementAt( BinaryNode<Comparable> *t ) const
-{
-  if( t == NULL )
-    return ITEM_NOT_FOUND;
-  else
-    return t->element;
-}
-
-/**
- * Internal method to insert into a subtree.
- * x is the item to insert.
- * t is the node that roots the tree.
- * Set the new root.
- */
-template <class Comparable>
-void BinarySearchTree<Comparable>::
-insert( const Comparable & x, BinaryNode<Comparable> * & t ) const
-{
-  if( t == NULL )
-    t = new BinaryNode<Comparable>( x, NULL, NULL );
-  else if( x < t->element )
-    insert( x, t->left );
-  else if( t->element < x )
-    insert( x, t->right );
-  else
-    ;  // Duplicate; do nothing
-}
-
-/**
- * Internal method to remove from a subtree.
- * x is the item to remove.
- * t is the node that roots the tree.
- * Set the new root.
- */
-template <class Comparable>
-void BinarySearchTree<Comparable>::
-remove( const Comparable & x, BinaryNode<Comparable> * & t ) const
-{
-  if( t == NULL )
-    return;   // Item not found; do nothing
-  if( x < t->element )
-    remove( x, t->left );
-  else if( t->element < x )
-    remove( x, t->right );
-  else if( t->left != NULL && t->right != NULL ) // Two children
-    {
-      t->element = findMin( t->right )->element;
-      remove( t->element, t->right );
-    }
-  else
-    {
-      BinaryNode<Comparable> *oldNode = t;
-      t = ( t->left != NULL ) ? t->left : t->right;
-      delete oldNode;
-    }
-}
-
-/**
- * Internal method to find the smallest item in a subtree t.
- * Return node containing the smallest item.
- */
-template <class Comparable>
-BinaryNode<Comparable> *
-BinarySearchTree<Comparable>::findMin( BinaryNode<Comparable> *t ) const
-{
-  if( t == NULL )
-    return NULL;
-  if( t->left == NULL )
-    return t;
-  return findMin( t->left );
-}
-
-/**
- * Internal method to find the largest item in a subtree t.
- * Return node containing the largest item.
- */
-template <class Comparable>
-BinaryNode<Comparable> *
-BinarySearchTree<Comparable>::findMax( BinaryNode<Comparable> *t ) const
-{
-  if( t != NULL )
-    while( t->right != NULL )
-      t = t->right;
-  return t;
-}
-
-/**
- * Internal method to find an item in a subtree.
- * x is item to search for.
- * t is the node that roots the tree.
- * Return node containing the matched item.
- */
-template <class Comparable>
-BinaryNode<Comparable> *
-BinarySearchTree<Comparable>::
-find( const Comparable & x, BinaryNode<Comparable> *t ) const
-{
-  if( t == NULL )
-    return NULL;
-  else if( x < t->element )
-    return find( x, t->left );
-  else if( t->element < x )
-    return find( x, t->right );
-  else
-    return t;    // Match
-  
-}
-
-
-/**
- * Internal method to make subtree empty.
- */
-template <class Comparable>
-void BinarySearchTree<Comparable>::
-makeEmpty( BinaryNode<Comparable> * & t ) const
-{
-  if( t != NULL )
-    {
-      makeEmpty( t->left );
-      makeEmpty( t->right );
-      delete t;
-    }
-  t = NULL;
-}
-
-/**
- * Internal method to print a subtree rooted at t in sorted order.
- */
-template <class Comparable>
-void BinarySearchTree<Comparable>::printTree( BinaryNode<Comparable> *t ) const
-{
-  if( t != NULL )
-    {
-      printTree( t->left );
-      cout << t->element << " ";
-      printTree( t->right );
-    }
-}
-
-/**
- * Internal method to clone subtree.
- */
-template <class Comparable>
-BinaryNode<Comparable> *
-BinarySearchTree<Comparable>::clone( BinaryNode<Comparable> * t ) const
-{
-  if( t == NULL )
-    return NULL;
-  else
-    return new BinaryNode<Comparable>( t->element, clone( t->left ), clone( t->right ) );
-}
-
-
-template <class Comparable> 
-int BinarySearchTree<Comparable>::size() const {
-  return size(root);
-}
-
-
-template <class Comparable>
-int BinarySearchTree<Comparable>::size(BinaryNode<Comparable> *t) const
-{
-  if( t == NULL )
-    return 0;
-  else
-    return 1 + size(t->left) + size(t->right);
-}
-
-/*
- *  Union : Finds the Union of two trees
- */
-template <class Comparable>
-void BinarySearchTree<Comparable>::Union(const BinarySearchTree& rhs)
-{
-    if( isEmpty( ) )
-    cout << "Empty tree" << endl;
-  else
-     Union(rhs.root);
-}
-
-/*
- * Union : Finds the Union of two trees
- */
-template <class Comparable>
-void BinarySearchTree<Comparable>::Union(BinaryNode<Comparable> *t)
-{
-    if( t != NULL )
-    {
-      Union( t->left );
-      insert(t->element);
-      Union( t->right );
-    }
-}
-
-/*
- * Intersection: finds the intersection of two trees
- */
-template <class Comparable>
-void BinarySearchTree<Comparable>::Intersection(const BinarySearchTree& tree1,
-						const BinarySearchTree& tree2)
-{
-   if ((tree1.isEmpty()) && (!(tree2.isEmpty()))){
-      root = clone(tree2.root);
-   }
-   else if ((tree2.isEmpty()) && (!(tree1.isEmpty()))){
-      root = clone(tree1.root);
-   }
-   else if ((tree2.isEmpty()) && (tree1.isEmpty())){
-    cout << "Empty trees" << endl;
-   }
-  else
-     Intersection(tree1.root, tree2.root);
-}
-
-/*
- * Intersection: finds the intersection of two trees
- */
-template <class Comparable>
-void BinarySearchTree<Comparable>::Intersection(BinaryNode<Comparable> *t1,
-						BinaryNode<Comparable> *t2)
-{
-    if( (t1 != NULL)  && (t2 != NULL) )
-    {
-       Intersection( t1->left, t2 );
-       
-       if((find(t1->element, t2)) != NULL ){
-	  insert(t1->element);
-       }
-       
-       Intersection( t1->right, t2 );
-    }
-}
-
-/*
- * IsPerfect : determines is tree is triangular
- */
-template <class Comparable>
-bool BinarySearchTree<Comparable>::IsPerfect()
-{
-   if ( isEmpty() ){ 
-      cout << "Empty Tree" << endl;
-      return true;
-   }
-   else if ( (root->right == NULL) && (root->left ==NULL))
-      return true;
-   else
-      return (IsPerfect(root, true));
-}
-
-/*
- * IsPerfect : determines is tree is triangular
- */
-template <class Comparable>
-bool BinarySearchTree<Comparable>::IsPerfect(BinaryNode<Comparable> *t, 
-					     bool truth)
-{
-   if (t != NULL)
-   {
-      if ((t->right != NULL) && (t->left != NULL))
-      {
-	 truth = IsPerfect(t->left, truth);
-	 truth = IsPerfect(t->right, truth);
-      }
-      else if (((t->right != NULL) && (t->left == NULL)) ||
-	       ((t->right == NULL) && (t->left != NULL)))
-      {
-	 truth = false;
-      }
-   }
-   return truth;
-}
-
-/*
- *  IsComplete : determines if the tree is file left to right
- */
-template <class Comparable>
-bool BinarySearchTree<Comparable>::IsComplete()
-{
- if ( isEmpty() ){ 
-      cout << "Empty Tree" << endl;
-      return true;
-   }
-   else if ( (root->right == NULL) && (root->left ==NULL))
-      return true;
-   else
-      return (IsComplete(root, true, true, -1, -1));
-}
-// Calculates if the tree is perfect
-// * USES RECURSION ** EXTRA CREDIT ** :)
-//
-template <class Comparable>
-bool BinarySearchTree<Comparable>::IsComplete(BinaryNode<Comparable> *t, 
-					      bool truth, bool isLeft,
-					      int currDepth, int leftDepth)
-{
-   if ( t!= NULL)
-   {
-      if (t->left == NULL && t->right != NULL)
-      	 return false;
-      else
-      {
-	 currDepth++;
-	 if (isLeft)
-	    truth = IsComplete(t->left, truth, true, currDepth, leftDepth);
-	 else if (t->left != NULL)
-	    truth = IsComplete(t->left, truth, false, currDepth, leftDepth);
-	 
-	 if ( (t->left == NULL) && (t->right == NULL) && (isLeft))
-	    leftDepth = currDepth;
-	 
-	 
-	 if ((!(isLeft)) && (leftDepth <= currDepth) && 
-	     ((t->left != NULL) || (t->right != NULL)))
-	    return false;
-	 	 
-	 truth = IsComplete(t->right, truth, false, currDepth, leftDepth);
-      }
-   }  
-   return truth;
-}
-
-
-/*
- * IPL : Calculates internal path length
- */
-template <class Comparable>
-int BinarySearchTree<Comparable>::IPL()
-{
-   if( isEmpty( ) )
-      cout << "Empty tree" << endl;
-   else
-      return (IPL(root, 0, 0));
-   return 0;
-}
-
-/*
- * IPL : Calculates internal path length
- */
-template <class Comparable>
-int BinarySearchTree<Comparable>::IPL(BinaryNode<Comparable> *t, 
-				      int counter, int depth)
-{
-   if (t != NULL)
-   {
-      counter = IPL(t->left, counter, depth + 1);
-      if ((t->right != NULL) || (t->left != NULL))
-     	 counter += depth;
-      counter = IPL(t->right, counter, depth + 1);
-   }
-   return counter;
-}
-
-/*
- * EPL : calculates external path length
- */
-template <class Comparable>
-int BinarySearchTree<Comparable>::EPL()
-{
-   if( isEmpty( ) )
-      cout << "Empty tree" << endl;
-   else{
-      return (EPL(root, 0, -1));
-   }   
-   return 0;
-
-}
-
-/*
- * EPL : calculates external path length
- */
-template <class Comparable>
-int BinarySearchTree<Comparable>::EPL(BinaryNode<Comparable> *t, 
-				      int counter, int depth)
-{
-   if (t != NULL)
-   {
-      int cDepth = depth + 1;
-      
-      counter = EPL(t->left, counter, cDepth);
-     
-      if ((t->right == NULL) && (t->left == NULL))
-	 counter += cDepth;
-     
-      counter = EPL(t->right, counter, cDepth);      
-   }
-   return counter;
-}
-
-/*
- * Same_Shape : checks to see if to shape vectors are the same
- */
-
-template <class Comparable>
-bool BinarySearchTree<Comparable>::Same_Shape(const BinarySearchTree& rhs)
-{
-   vector <int> shape1;
-   vector <int> shape2;
-
-   if (isEmpty() && rhs.isEmpty())
-      return true;
-   else if (isEmpty() || rhs.isEmpty())
-      return false;
-   else
-   {
-
-      FindShape(rhs.root, shape1, -1);
-      FindShape(root, shape2, -1);
-
-      if (shape1.size() != shape2.size())
-      	 return false;
-      else
-      {
-	 for (unsigned int x = 0; x < shape1.size(); x++)
-	 {
-	    if (shape1.at(x) != shape2.at(x))
-	       return false;
-	 } 
-      }
-   }
-   return true;
-}
-
-/*****
- * FindShape : records the depths of each node from left to right
- *             in a vector, root and NULL recorded as 0      
- *
- *****/
-template <class Comparable>
-void BinarySearchTree<Comparable>::FindShape(BinaryNode<Comparable> *t, 
-					      vector <int>& shape, int depth)
-{
-    if (t != NULL)
-   {
-      depth++;
-      shape.push_back(depth);
-      FindShape(t->left, shape, depth);
-      FindShape(t->right, shape, depth);
-   }
-    else 
-      shape.push_back(0);
-}
+#include "BinarySearchTree.h"
+#include <algorithm>
+#include <cerrno>
+#include <future>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <stdint.h>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+#include <unistd.h>
+#define BINARY_SEARCH_TREE_FD 1
+#endif
+
+using namespace std;
+
+/**
+ * Implements a binary search tree. The BalancePolicy template
+ * parameter selects a plain (unbalanced) tree, an AVL tree or a
+ * red-black tree; all share the same public operations.
+ * Note that all "matching" is based on Compare, applied to the keys
+ * that KeyOf finds in the items; by default the < method on the
+ * items themselves.
+ */
+
+/**
+ * Construct the tree.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+BinarySearchTree( const Comparable & notFound, const Compare & order ) :
+   root(NULL), ITEM_NOT_FOUND( notFound ),
+   threads( max( 1, (int) thread::hardware_concurrency( ) ) ), comp( order ),
+   splayDepth( 0 ), splayHits( 0 )
+{
+}
+
+
+/**
+ * Construct the tree from the items in [first, last).
+ * See assign.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class Iterator>
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+BinarySearchTree( const Comparable & notFound, Iterator first, Iterator last,
+                  const Compare & order ) :
+   root(NULL), ITEM_NOT_FOUND( notFound ),
+   threads( max( 1, (int) thread::hardware_concurrency( ) ) ), comp( order ),
+   splayDepth( 0 ), splayHits( 0 )
+{
+  assign( first, last );
+}
+
+/**
+ * Copy constructor.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+BinarySearchTree( const BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf> & rhs ) :
+  root( NULL ), ITEM_NOT_FOUND( rhs.ITEM_NOT_FOUND ), threads( rhs.threads ),
+  comp( rhs.comp ), splayDepth( rhs.splayDepth ), splayHits( rhs.splayHits )
+{ 
+  *this = rhs;
+}
+
+/**
+ * Move constructor; takes over the nodes of rhs and leaves it empty.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+BinarySearchTree( BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf> && rhs ) :
+  root( rhs.root ), ITEM_NOT_FOUND( rhs.ITEM_NOT_FOUND ), threads( rhs.threads ),
+  comp( rhs.comp ), splayDepth( rhs.splayDepth ), splayHits( rhs.splayHits )
+{
+  rhs.root = NULL;
+  pool.swap( rhs.pool );
+  TREE_STAT( std::swap( counters.depthSum, rhs.counters.depthSum ); )
+}
+
+/**
+ * Destructor for the tree.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::~BinarySearchTree( )
+{
+  makeEmpty( );
+}
+
+/**
+ * Insert x into the tree; duplicates are ignored.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::insert( const Comparable & x )
+{
+  TREE_STAT( LatencyTimer timer( counters.insertLatency ); )
+  BinaryNode<Comparable> **link = insertionPoint( keyOf( x ) );
+
+  if( link != NULL )
+    attach( link, newNode( x, NULL, NULL ) );
+}
+
+/**
+ * Insert x into the tree, moving it into the new node;
+ * duplicates are ignored and left unchanged.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::insert( Comparable && x )
+{
+  TREE_STAT( LatencyTimer timer( counters.insertLatency ); )
+  BinaryNode<Comparable> **link = insertionPoint( keyOf( x ) );
+
+  if( link != NULL )
+    attach( link, emplaceNode( std::move( x ) ) );
+}
+
+/**
+ * Insert the item constructed from args, building it directly in
+ * its node; if the tree already holds an equal item the new one is
+ * destroyed again.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class... Args>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::emplace( Args &&... args )
+{
+  TREE_STAT( LatencyTimer timer( counters.insertLatency ); )
+  BinaryNode<Comparable> *t = emplaceNode( std::forward<Args>( args )... );
+  BinaryNode<Comparable> **link;
+
+  try
+    {
+      link = insertionPoint( keyOf( t->element ) );
+    }
+  catch( ... )
+    {
+      deleteNode( t );
+      throw;
+    }
+  if( link != NULL )
+    attach( link, t );
+  else
+    deleteNode( t );
+}
+
+/**
+ * Replace the contents of the tree with the items in [first, last).
+ * The items are sorted if they are not already, duplicates are
+ * dropped, and the tree is built with minimum height in linear time.
+ * Large inputs are sorted and built on several threads.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class Iterator>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::assign( Iterator first, Iterator last )
+{
+  vector<Comparable> items( first, last );
+  ItemLess less = itemLess( );
+
+  if( is_sorted( items.begin( ), items.end( ), less ) )
+    items.erase( unique( items.begin( ), items.end( ),
+                         [less]( const Comparable & a, const Comparable & b )
+                         { return !less( a, b ); } ),
+                 items.end( ) );
+  else
+    sortUnique( items );
+  buildTree( items );
+}
+
+/**
+ * Remove x from the tree. Nothing is done if x is not found.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::remove( const KeyType & x )
+{
+  TREE_STAT( LatencyTimer timer( counters.removeLatency ); )
+  remove( x, root );
+}
+
+/**
+ * Insert items[ 0.. n - 1 ], in any order; duplicates are ignored.
+ * The items are sorted and inserted by insertSorted, or merged with
+ * the tree in one pass over its items if there are many of them
+ * (see BATCH_REBUILD_RATIO).
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+insertBatch( const Comparable *items, size_t n )
+{
+  vector<Comparable> batch( items, items + n );
+
+  sortUnique( batch );
+  if( batch.size( ) * BATCH_REBUILD_RATIO >= (size_t) size( ) )
+    absorb( batch );
+  else
+    insertSorted( batch, BalancePolicy( ) );
+}
+
+/**
+ * Internal method for insertBatch on a tree whose inserts rotate:
+ * the sorted batch is looked up as findBatch does, which pulls its
+ * paths into cache with overlapped misses, and the items not found
+ * are then inserted one by one.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class Policy>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+insertSorted( const vector<Comparable> & batch, Policy )
+{
+  vector<bool> present( batch.size( ), false );
+
+  lookupBatch( [&batch]( size_t i ) -> const KeyType & { return keyOf( batch[ i ] ); },
+               batch.size( ),
+               [&present]( size_t i, BinaryNode<Comparable> * ) { present[ i ] = true; } );
+  for( size_t i = 0; i < batch.size( ); i++ )
+    if( !present[ i ] )
+      insert( batch[ i ] );
+}
+
+/**
+ * Internal method for insertBatch on an unbalanced tree: insert the
+ * sorted, duplicate-free batch in a single descent. The items are
+ * split between the children of each node they reach, a level at a
+ * time, as in lookupBatch; those that meet at an empty link are hung
+ * there by graft. Nothing rotates, so no node moves under a pending
+ * part of the batch. The nodes passed are recounted afterwards, from
+ * the bottom up.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+insertSorted( const vector<Comparable> & batch, UnbalancedPolicy )
+{
+  const Compare & less = comp;
+  vector<Probe> level;
+  vector<Probe> next;
+  vector<BinaryNode<Comparable> *> passed;
+
+  if( batch.empty( ) )
+    return;
+  if( root == NULL )
+    {
+      graft( batch, 0, batch.size( ), NULL, root, 0 );
+      return;
+    }
+
+  Probe all = { root, 0, batch.size( ), 0 };
+  level.push_back( all );
+  try
+    {
+      while( !level.empty( ) )
+        {
+          next.clear( );
+          for( size_t p = 0; p < level.size( ); p++ )
+            {
+              BinaryNode<Comparable> *t = level[ p ].t;
+              size_t low = level[ p ].low;
+              size_t high = level[ p ].high;
+              int depth = level[ p ].depth;
+              const KeyType & key = keyOf( t->element );
+
+              // [low, mid) go left, [up, high) go right; an item at
+              // mid with the key of t is already in the tree
+              size_t mid = std::lower_bound( batch.begin( ) + low, batch.begin( ) + high, key,
+                                             [&]( const Comparable & item, const KeyType & x )
+                                             { return less( keyOf( item ), x ); } ) -
+                           batch.begin( );
+              size_t up = mid < high && !less( key, keyOf( batch[ mid ] ) ) ? mid + 1 : mid;
+
+              passed.push_back( t );
+              if( low < mid && t->left == NULL )
+                graft( batch, low, mid, t, t->left, depth + 1 );
+              else if( low < mid )
+                {
+#if defined( __GNUC__ )
+                  __builtin_prefetch( t->left );
+#endif
+                  Probe left = { t->left, low, mid, depth + 1 };
+                  next.push_back( left );
+                }
+              if( up < high && t->right == NULL )
+                graft( batch, up, high, t, t->right, depth + 1 );
+              else if( up < high )
+                {
+#if defined( __GNUC__ )
+                  __builtin_prefetch( t->right );
+#endif
+                  Probe right = { t->right, up, high, depth + 1 };
+                  next.push_back( right );
+                }
+            }
+          level.swap( next );
+        }
+    }
+  catch( ... )
+    {
+      // Keep the counts right for the subtrees grafted so far
+      for( size_t i = passed.size( ); i-- > 0; )
+        refresh( passed[ i ] );
+      throw;
+    }
+
+  // Every node was passed after its parent
+  for( size_t i = passed.size( ); i-- > 0; )
+    refresh( passed[ i ] );
+}
+
+/**
+ * Internal method for insertSorted: hang batch[ low.. high - 1 ] from
+ * link, an empty link of parent ( NULL for the root ), as a subtree
+ * of minimum height whose root is at the given depth.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+graft( const vector<Comparable> & batch, size_t low, size_t high,
+       BinaryNode<Comparable> *parent, BinaryNode<Comparable> * & link, int depth )
+{
+  link = buildTree( batch, (int) low, (int) high - 1, 0, -1, pool );
+  link->parent = parent;
+  TREE_STAT( size_t added = high - low;
+             int levels = 0;
+             for( size_t k = added; k > 1; k /= 2 )
+               levels++;
+             counters.count( counters.allocations, added );
+             counters.reachDepth( depth + levels );
+             counters.depthSum += (long long) added * depth + balancedDepthSum( added ); )
+#if !defined( BINARY_SEARCH_TREE_STATS )
+  (void) depth;
+#endif
+}
+
+/**
+ * Remove the items with keys[ 0.. n - 1 ], in any order; keys not
+ * in the tree are ignored. The keys are sorted and removed in order,
+ * or the tree is rebuilt without them if there are many of them.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+removeBatch( const KeyType *keys, size_t n )
+{
+  removeBatch( keys, n, is_same<KeyType, Comparable>( ) );
+}
+
+/**
+ * Internal method for removeBatch when the keys are whole items:
+ * they are sorted, and merged away, on several threads like the
+ * items of the set operations.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+removeBatch( const KeyType *keys, size_t n, true_type )
+{
+  vector<Comparable> batch( keys, keys + n );
+
+  sortUnique( batch );
+  if( batch.size( ) * BATCH_REBUILD_RATIO >= (size_t) size( ) )
+    {
+      vector<Comparable> mine;
+      vector<Comparable> result;
+
+      flatten( root, mine );
+      merge( DIFFERENCE, mine, batch, result );
+      buildTree( result );
+    }
+  else
+    for( size_t i = 0; i < batch.size( ); i++ )
+      remove( batch[ i ] );
+}
+
+/**
+ * Internal method for removeBatch when the keys are parts of the
+ * items: they are sorted on the calling thread, and a large batch
+ * is dropped from the items in one pass over both.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+removeBatch( const KeyType *keys, size_t n, false_type )
+{
+  vector<KeyType> batch( keys, keys + n );
+  const Compare & less = comp;
+
+  sort( batch.begin( ), batch.end( ), less );
+  batch.erase( unique( batch.begin( ), batch.end( ),
+                       [&less]( const KeyType & a, const KeyType & b )
+                       { return !less( a, b ); } ),
+               batch.end( ) );
+  if( batch.size( ) * BATCH_REBUILD_RATIO >= (size_t) size( ) )
+    {
+      vector<Comparable> mine;
+      vector<Comparable> result;
+      size_t k = 0;
+
+      flatten( root, mine );
+      for( size_t i = 0; i < mine.size( ); i++ )
+        {
+          while( k < batch.size( ) && less( batch[ k ], keyOf( mine[ i ] ) ) )
+            k++;
+          if( k == batch.size( ) || less( keyOf( mine[ i ] ), batch[ k ] ) )
+            result.push_back( mine[ i ] );
+        }
+      buildTree( result );
+    }
+  else
+    for( size_t i = 0; i < batch.size( ); i++ )
+      remove( batch[ i ] );
+}
+
+/**
+ * Look up keys[ 0.. n - 1 ]: set results[ i ] to the item matching
+ * keys[ i ], or to ITEM_NOT_FOUND.
+ * The keys are sorted and carried down the tree together: a node
+ * splits its keys between its children, so each node is read once
+ * per batch. The walk goes a level at a time and prefetches each
+ * child as it is queued, overlapping the cache misses of a level.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+findBatch( const KeyType *keys, size_t n, Comparable *results ) const
+{
+  for( size_t i = 0; i < n; i++ )
+    results[ i ] = ITEM_NOT_FOUND;
+  lookupBatch( [keys]( size_t i ) -> const KeyType & { return keys[ i ]; }, n,
+               [results]( size_t i, BinaryNode<Comparable> *t ) { results[ i ] = t->element; } );
+}
+
+/**
+ * Look up keys[ 0.. n - 1 ] in the order given: set results[ i ] to
+ * the item matching keys[ i ], or to ITEM_NOT_FOUND.
+ * Up to width lookups, at most MAX_INTERLEAVE, are in flight. Each
+ * is just the index of its key and the node it is at; in turn, each
+ * compares its key with its node and moves to a child, prefetching
+ * it, or is finished and makes way for the next key.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+findMany( const KeyType *keys, size_t n, Comparable *results, int width ) const
+{
+  struct Lookup
+  {
+    size_t i;
+    BinaryNode<Comparable> *t;
+  };
+  Lookup lookups[ MAX_INTERLEAVE ];
+  int active = 0;
+  size_t next = 0;
+
+  width = max( 1, min( width, (int) MAX_INTERLEAVE ) );
+  for( ; active < width && next < n; active++, next++ )
+    {
+      lookups[ active ].i = next;
+      lookups[ active ].t = root;
+    }
+
+  while( active > 0 )
+    for( int s = 0; s < active; )
+      {
+        Lookup & lookup = lookups[ s ];
+        BinaryNode<Comparable> *t = lookup.t;
+        int c = t == NULL ? 0 : order( keys[ lookup.i ], t->element );
+
+        if( c == 0 )
+          {
+            // Done: start the next key here, or close the gap
+            results[ lookup.i ] = elementAt( t );
+            if( next < n )
+              {
+                lookup.i = next++;
+                lookup.t = root;
+                s++;
+              }
+            else
+              lookup = lookups[ --active ];
+            continue;
+          }
+        t = c < 0 ? t->left : t->right;
+#if defined( __GNUC__ )
+        if( t != NULL )
+          __builtin_prefetch( t );
+#endif
+        lookup.t = t;
+        s++;
+      }
+}
+
+/**
+ * Internal method for findBatch and insertBatch: looks up the n keys
+ * keyAt( 0 ).. keyAt( n - 1 ) as findBatch does, and calls
+ * found( i, t ) for each key i that node t holds.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class KeyAt, class Found>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+lookupBatch( KeyAt keyAt, size_t n, Found found ) const
+{
+  const Compare & less = comp;
+  vector<size_t> order( n );
+  vector<Probe> level;
+  vector<Probe> next;
+
+  for( size_t i = 0; i < n; i++ )
+    order[ i ] = i;
+  sort( order.begin( ), order.end( ),
+        [&]( size_t a, size_t b ) { return less( keyAt( a ), keyAt( b ) ); } );
+
+  if( root != NULL && n > 0 )
+    {
+      Probe all = { root, 0, n, 0 };
+      level.push_back( all );
+    }
+  while( !level.empty( ) )
+    {
+      next.clear( );
+      for( size_t p = 0; p < level.size( ); p++ )
+        {
+          BinaryNode<Comparable> *t = level[ p ].t;
+          size_t low = level[ p ].low;
+          size_t high = level[ p ].high;
+
+          // [low, mid) go left, [mid, up) match t, [up, high) go right
+          size_t mid = std::lower_bound( order.begin( ) + low, order.begin( ) + high,
+                                         keyOf( t->element ),
+                                         [&]( size_t i, const KeyType & x )
+                                         { return less( keyAt( i ), x ); } ) - order.begin( );
+          size_t up = mid;
+          for( ; up < high && !less( keyOf( t->element ), keyAt( order[ up ] ) ); up++ )
+            found( order[ up ], t );
+
+          if( low < mid && t->left != NULL )
+            {
+#if defined( __GNUC__ )
+              __builtin_prefetch( t->left );
+#endif
+              Probe left = { t->left, low, mid, level[ p ].depth + 1 };
+              next.push_back( left );
+            }
+          if( up < high && t->right != NULL )
+            {
+#if defined( __GNUC__ )
+              __builtin_prefetch( t->right );
+#endif
+              Probe right = { t->right, up, high, level[ p ].depth + 1 };
+              next.push_back( right );
+            }
+        }
+      level.swap( next );
+    }
+}
+
+
+/**
+ * Map mode: give key k the value value, adding k if it is missing.
+ * Return true if k was added.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class V>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+insert_or_assign( const KeyType & k, V && value )
+{
+  requireMap( );
+  TREE_STAT( LatencyTimer timer( counters.insertLatency ); )
+  bool added;
+  BinaryNode<Comparable> *t = findOrEmplace( k, added, std::forward<V>( value ) );
+
+  if( !added )
+    {
+      t->element.second = std::forward<V>( value );
+      valueChanged( t );
+    }
+  return added;
+}
+
+/**
+ * Map mode: add key k with the value constructed from args, unless
+ * k is already in the tree; args are then left untouched.
+ * Return true if k was added.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class... Args>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+try_emplace( const KeyType & k, Args &&... args )
+{
+  requireMap( );
+  TREE_STAT( LatencyTimer timer( counters.insertLatency ); )
+  bool added;
+
+  findOrEmplace( k, added, std::forward<Args>( args )... );
+  return added;
+}
+
+/**
+ * Map mode: return the value of key k, adding k with a default
+ * constructed value if it is missing.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+typename add_lvalue_reference<typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::MappedType>::type
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+operator[]( const KeyType & k )
+{
+  requireMap( );
+  bool added;
+
+  return findOrEmplace( k, added )->element.second;
+}
+
+/**
+ * Map mode: return a pointer to the value of key k, or NULL if k
+ * is not in the tree.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::MappedType *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+findValue( const KeyType & k )
+{
+  requireMap( );
+  TREE_STAT( LatencyTimer timer( counters.findLatency ); )
+  BinaryNode<Comparable> *t = find( k, root );
+
+  return t == NULL ? NULL : &t->element.second;
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+const typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::MappedType *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+findValue( const KeyType & k ) const
+{
+  requireMap( );
+  TREE_STAT( LatencyTimer timer( counters.findLatency ); )
+  BinaryNode<Comparable> *t = find( k, root );
+
+  return t == NULL ? NULL : &t->element.second;
+}
+
+/**
+ * Map mode: call f( value ) on the value of key k, in its node.
+ * Return false, without calling f, if k is not in the tree.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class Function>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+update( const KeyType & k, Function f )
+{
+  requireMap( );
+  TREE_STAT( LatencyTimer timer( counters.findLatency ); )
+  BinaryNode<Comparable> *t = find( k, root );
+
+  if( t == NULL )
+    return false;
+  f( t->element.second );
+  valueChanged( t );
+  return true;
+}
+
+/**
+ * Find the smallest item in the tree.
+ * Return smallest item or ITEM_NOT_FOUND if empty.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+const Comparable & BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::findMin( ) const
+{
+  return elementAt( findMin( root ) );
+}
+
+/**
+ * Find the largest item in the tree.
+ * Return the largest item of ITEM_NOT_FOUND if empty.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+const Comparable & BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::findMax( ) const
+{
+  return elementAt( findMax( root ) );
+}
+
+/**
+ * Find the item with key x in the tree.
+ * Return the matching item or ITEM_NOT_FOUND if not found.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+const Comparable & BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+find( const KeyType & x ) const
+{
+  TREE_STAT( LatencyTimer timer( counters.findLatency ); )
+  BinaryNode<Comparable> *t = find( x, root );
+
+  hit( t, BalancePolicy( ) );
+  return elementAt( t );
+}
+
+/**
+ * Find the item whose key is equivalent to x, which may be of any
+ * type a transparent Compare takes alongside the keys.
+ * Return the matching item or ITEM_NOT_FOUND if not found.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class K, class C, class>
+const Comparable & BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+find( const K & x ) const
+{
+  TREE_STAT( LatencyTimer timer( counters.findLatency ); )
+  BinaryNode<Comparable> *t = find( x, root );
+
+  hit( t, BalancePolicy( ) );
+  return elementAt( t );
+}
+
+/**
+ * Find the item with key x in the tree; in a splay tree, splay the
+ * node that holds it, or with setSplayHits count a hit in it.
+ * Return the matching item or ITEM_NOT_FOUND if not found.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+const Comparable & BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+access( const KeyType & x )
+{
+  TREE_STAT( LatencyTimer timer( counters.findLatency ); )
+  BinaryNode<Comparable> *t = find( x, root );
+
+  accessed( t, BalancePolicy( ) );
+  return elementAt( t );
+}
+
+/**
+ * Make the tree logically empty.
+ * Nodes are destroyed one by one only if that has an effect; the
+ * pool then frees its slabs at once.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::makeEmpty( )
+{
+  if( !is_trivially_destructible<Comparable>::value ||
+      !NodeAllocator<BinaryNode<Comparable> >::releasesInBulk )
+    makeEmpty( root );
+  root = NULL;
+  pool.release( );
+  TREE_STAT( counters.depthSum = 0; )
+}
+
+/**
+ * Test if the tree is logically empty.
+ * Return true if empty, false otherwise.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::isEmpty( ) const
+{
+  return root == NULL;
+}
+
+/**
+ * Print the tree contents in sorted order.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::printTree( ) const
+{
+  if( isEmpty( ) )
+    cout << "Empty tree" << endl;
+  else
+    printTree( root );
+}
+
+/**
+ * Deep copy.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+const BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf> &
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+operator=( const BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf> & rhs )
+{
+  if( this != &rhs )
+    {
+      makeEmpty( );
+      root = clone( rhs.root );
+      TREE_STAT( counters.depthSum = rhs.counters.depthSum; )
+    }
+  return *this;
+}
+
+/**
+ * Move assignment; takes over the nodes of rhs and leaves it empty.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+const BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf> &
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+operator=( BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf> && rhs )
+{
+  if( this != &rhs )
+    {
+      makeEmpty( );
+      swap( rhs );
+    }
+  return *this;
+}
+
+/**
+ * Exchange the items of this tree and rhs by swapping their roots
+ * and pools; no node is copied.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+swap( BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf> & rhs )
+{
+  std::swap( root, rhs.root );
+  pool.swap( rhs.pool );
+  std::swap( comp, rhs.comp );
+  TREE_STAT( std::swap( counters.depthSum, rhs.counters.depthSum ); )
+}
+
+/**
+ * Internal method to get element field in node t.
+ * Return the element field or ITEM_NOT_FOUND if t is NULL.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+const Comparable & BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+elementAt( BinaryNode<Comparable> *t ) const
+{
+  if( t == NULL )
+    return ITEM_NOT_FOUND;
+  else
+    return t->element;
+}
+
+/**
+ * Internal method to return the key of item x.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+const typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::KeyType &
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+keyOf( const Comparable & x )
+{
+  return KeyOf( )( x );
+}
+
+/**
+ * Internal method to return a comparator of items by their keys,
+ * which refers to the Compare of this tree.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::ItemLess
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::itemLess( ) const
+{
+  ItemLess less = { &comp };
+  return less;
+}
+
+/**
+ * Internal method to stop the map operations from compiling on
+ * trees that are not maps.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::requireMap( )
+{
+  static_assert( is_same<KeyOf, FirstKey>::value && !is_void<MappedType>::value,
+                 "map operations need pair items ordered by FirstKey; "
+                 "see BinarySearchMap" );
+}
+
+/**
+ * Internal method to stop the splay settings from compiling on
+ * trees that do not splay.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::requireSplay( )
+{
+  static_assert( is_same<BalancePolicy, SplayPolicy>::value,
+                 "splay settings need a tree with SplayPolicy" );
+}
+
+/**
+ * Internal method for the map operations: find the node of key k,
+ * or add one with the value constructed from args. added tells
+ * which; args are only used if it is set.
+ * Return the node.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class... Args>
+BinaryNode<Comparable> *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+findOrEmplace( const KeyType & k, bool & added, Args &&... args )
+{
+  BinaryNode<Comparable> **link = insertionPoint( k );
+
+  added = link != NULL;
+  if( !added )
+    return *path.back( );   // insertionPoint stopped at the match
+
+  BinaryNode<Comparable> *t =
+    emplaceNode( piecewise_construct, forward_as_tuple( k ),
+                 forward_as_tuple( std::forward<Args>( args )... ) );
+  attach( link, t );
+  return t;
+}
+
+/**
+ * Internal method to refresh the content hashes above node t after
+ * its value was changed in place; only hashable items keep them.
+ * Values written through operator[] or findValue are not seen here.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+valueChanged( BinaryNode<Comparable> *t ) const
+{
+  if( ItemHashable<Comparable>::value )
+    refreshUp( t );
+}
+
+/**
+ * Internal method to compare x with the key of item.
+ * Return negative, zero or positive as x goes before, with or
+ * after it: by one call of comp.compare( ) if Compare has it, else
+ * by one or two calls of comp.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class K>
+int BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+order( const K & x, const Comparable & item ) const
+{
+  return order( x, keyOf( item ), HasThreeWay<Compare, K, KeyType>( ) );
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class K>
+int BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+order( const K & x, const KeyType & key, true_type ) const
+{
+  return comp.compare( x, key );
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class K>
+int BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+order( const K & x, const KeyType & key, false_type ) const
+{
+  return comp( x, key ) ? -1 : comp( key, x ) ? 1 : 0;
+}
+
+/**
+ * Internal method to find where an item with key x belongs.
+ * Return the NULL link that it would be attached to, or NULL if
+ * the key is already in the tree. The links walked on the way down
+ * are left in path.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+BinaryNode<Comparable> **
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+insertionPoint( const KeyType & x )
+{
+  BinaryNode<Comparable> **link = &root;
+
+  path.clear( );
+  while( *link != NULL )
+    {
+      path.push_back( link );
+      int c = order( x, ( *link )->element );
+      if( c < 0 )
+        link = &( *link )->left;
+      else if( c > 0 )
+        link = &( *link )->right;
+      else
+        return NULL;  // Duplicate
+    }
+  return link;
+}
+
+/**
+ * Internal method to hang the new leaf t from link, as found by
+ * insertionPoint. The nodes on path count t, and link is added to
+ * path for rebalancing.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+attach( BinaryNode<Comparable> **link, BinaryNode<Comparable> *t )
+{
+  *link = t;
+  t->parent = path.empty( ) ? NULL : *path.back( );
+  for( size_t i = 0; i < path.size( ); i++ )
+    ( *path[ i ] )->count++;
+  TREE_STAT( counters.count( counters.inserts );
+             counters.reachDepth( (int) path.size( ) );
+             counters.depthSum += path.size( ); )
+  path.push_back( link );
+  rebalanceInsert( BalancePolicy( ) );
+  refreshUp( t );
+}
+
+/**
+ * Internal method to remove from a subtree.
+ * x is the key of the item to remove.
+ * t is the node that roots the tree.
+ * Set the new root.
+ * A node with two children takes over its successor's element and
+ * the successor is unlinked instead. On return path ends with the
+ * link that held the unlinked node, and the nodes above it no
+ * longer count it.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+remove( const KeyType & x, BinaryNode<Comparable> * & t )
+{
+  BinaryNode<Comparable> **link = &t;
+
+  path.clear( );
+  while( *link != NULL )
+    {
+      int c = order( x, ( *link )->element );
+      if( c < 0 )
+        {
+          path.push_back( link );
+          link = &( *link )->left;
+        }
+      else if( c > 0 )
+        {
+          path.push_back( link );
+          link = &( *link )->right;
+        }
+      else
+        break;
+    }
+  if( *link == NULL )
+    return;   // Item not found; do nothing
+
+  if( ( *link )->left != NULL && ( *link )->right != NULL ) // Two children
+    {
+      BinaryNode<Comparable> *target = *link;
+      path.push_back( link );
+      link = &target->right;
+      while( ( *link )->left != NULL )
+        {
+          path.push_back( link );
+          link = &( *link )->left;
+        }
+      target->element = ( *link )->element;
+    }
+
+  BinaryNode<Comparable> *oldNode = *link;
+  *link = ( oldNode->left != NULL ) ? oldNode->left : oldNode->right;
+  if( *link != NULL )
+    ( *link )->parent = oldNode->parent;
+  for( size_t i = 0; i < path.size( ); i++ )
+    ( *path[ i ] )->count--;
+  // The unlinked node was at depth path.size( ); its subtree moved up
+  TREE_STAT( counters.count( counters.removes );
+             counters.reachDepth( (int) path.size( ) );
+             counters.depthSum -= path.size( ) + size( *link ); )
+  path.push_back( link );
+  rebalanceRemove( oldNode, BalancePolicy( ) );
+  refreshUp( oldNode->parent );
+  deleteNode( oldNode );
+}
+
+/**
+ * Internal method to find the smallest item in a subtree t.
+ * Return node containing the smallest item.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+BinaryNode<Comparable> *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::findMin( BinaryNode<Comparable> *t ) const
+{
+  if( t != NULL )
+    while( t->left != NULL )
+      t = t->left;
+  return t;
+}
+
+/**
+ * Internal method to find the largest item in a subtree t.
+ * Return node containing the largest item.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+BinaryNode<Comparable> *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::findMax( BinaryNode<Comparable> *t ) const
+{
+  if( t != NULL )
+    while( t->right != NULL )
+      t = t->right;
+  return t;
+}
+
+/**
+ * Internal method to find an item in a subtree.
+ * x is the key to search for.
+ * t is the node that roots the tree.
+ * Return node containing the matched item.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class K>
+BinaryNode<Comparable> *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+find( const K & x, BinaryNode<Comparable> *t ) const
+{
+  // A node costs one three-way comparison, or else one comparison
+  // on the way left and two otherwise
+  TREE_STAT( int visited = 0; int lefts = 0; )
+
+  while( t != NULL )
+    {
+      TREE_STAT( visited++; )
+      int c = order( x, t->element );
+      if( c < 0 )
+        {
+          TREE_STAT( lefts++; )
+          t = t->left;
+        }
+      else if( c > 0 )
+        t = t->right;
+      else
+        break;    // Match
+    }
+  TREE_STAT( counters.count( counters.finds );
+             counters.count( counters.findComparisons,
+                             HasThreeWay<Compare, K, KeyType>::value ?
+                               visited : 2 * visited - lefts );
+             counters.reachDepth( visited - 1 ); )
+  return t;   // NULL if no match
+}
+
+/**
+ * Internal method to return the number of items with keys before x.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class K>
+int BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+countBefore( const K & x ) const
+{
+  BinaryNode<Comparable> *t = root;
+  int less = 0;
+
+  while( t != NULL )
+    {
+      if( comp( keyOf( t->element ), x ) )
+        {
+          less += size( t->left ) + 1;
+          t = t->right;
+        }
+      else
+        t = t->left;
+    }
+  return less;
+}
+
+/**
+ * Internal method to find the first item whose key is not before x.
+ * Return that node, or NULL if there is none.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class K>
+BinaryNode<Comparable> *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+lowerBound( const K & x ) const
+{
+  BinaryNode<Comparable> *t = root;
+  BinaryNode<Comparable> *bound = NULL;
+
+  while( t != NULL )
+    {
+      if( comp( keyOf( t->element ), x ) )
+        t = t->right;
+      else
+        {
+          bound = t;
+          t = t->left;
+        }
+    }
+  return bound;
+}
+
+/**
+ * Internal method to find the first item whose key is after x.
+ * Return that node, or NULL if there is none.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class K>
+BinaryNode<Comparable> *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+upperBound( const K & x ) const
+{
+  BinaryNode<Comparable> *t = root;
+  BinaryNode<Comparable> *bound = NULL;
+
+  while( t != NULL )
+    {
+      if( comp( x, keyOf( t->element ) ) )
+        {
+          bound = t;
+          t = t->left;
+        }
+      else
+        t = t->right;
+    }
+  return bound;
+}
+
+/**
+ * Internal method to find the node after t in sorted order.
+ * Return that node, or NULL if t holds the largest item.
+ * Walking the whole tree this way visits each link twice.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+BinaryNode<Comparable> *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+successor( BinaryNode<Comparable> *t ) const
+{
+  if( t->right != NULL )
+    return findMin( t->right );
+  while( t->parent != NULL && t == t->parent->right )
+    t = t->parent;
+  return t->parent;
+}
+
+/**
+ * Internal method to find the node before t in sorted order;
+ * t == NULL stands for the position after the largest item.
+ * Return that node, or NULL if t holds the smallest item.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+BinaryNode<Comparable> *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+predecessor( BinaryNode<Comparable> *t ) const
+{
+  if( t == NULL )
+    return findMax( root );
+  if( t->left != NULL )
+    return findMax( t->left );
+  while( t->parent != NULL && t == t->parent->left )
+    t = t->parent;
+  return t->parent;
+}
+
+
+/**
+ * Internal method to make subtree empty.
+ * Left children are rotated up until the top node has none, so
+ * the subtree is freed in one pass without recursion.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+makeEmpty( BinaryNode<Comparable> * & t )
+{
+  while( t != NULL )
+    {
+      if( t->left != NULL )
+        {
+          BinaryNode<Comparable> *leftChild = t->left;
+          t->left = leftChild->right;
+          leftChild->right = t;
+          t = leftChild;
+        }
+      else
+        {
+          BinaryNode<Comparable> *oldNode = t;
+          t = t->right;
+          deleteNode( oldNode );
+        }
+    }
+}
+
+/**
+ * Internal method to print a subtree rooted at t in sorted order.
+ * Uses an explicit stack, so the depth of the tree is not limited
+ * by the call stack.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::printTree( BinaryNode<Comparable> *t ) const
+{
+  vector<BinaryNode<Comparable> *> stack;
+
+  while( t != NULL || !stack.empty( ) )
+    {
+      if( t != NULL )
+        {
+          stack.push_back( t );
+          t = t->left;
+        }
+      else
+        {
+          t = stack.back( );
+          stack.pop_back( );
+          cout << t->element << " ";
+          t = t->right;
+        }
+    }
+}
+
+/**
+ * Internal method to clone subtree.
+ * Nodes are copied in preorder from an explicit stack of
+ * (original, copy) pairs.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+BinaryNode<Comparable> *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::clone( BinaryNode<Comparable> * t )
+{
+  if( t == NULL )
+    return NULL;
+
+  BinaryNode<Comparable> *copy = newNode( t->element, NULL, NULL, t->balance );
+  copyCached( copy, t );
+  vector<pair<BinaryNode<Comparable> *, BinaryNode<Comparable> *> > stack;
+
+  stack.push_back( make_pair( t, copy ) );
+  while( !stack.empty( ) )
+    {
+      BinaryNode<Comparable> *from = stack.back( ).first;
+      BinaryNode<Comparable> *to = stack.back( ).second;
+      stack.pop_back( );
+      if( from->right != NULL )
+        {
+          to->right = newNode( from->right->element, NULL, NULL,
+                               from->right->balance );
+          to->right->parent = to;
+          copyCached( to->right, from->right );
+          stack.push_back( make_pair( from->right, to->right ) );
+        }
+      if( from->left != NULL )
+        {
+          to->left = newNode( from->left->element, NULL, NULL,
+                              from->left->balance );
+          to->left->parent = to;
+          copyCached( to->left, from->left );
+          stack.push_back( make_pair( from->left, to->left ) );
+        }
+    }
+  return copy;
+}
+
+/**
+ * Internal method to construct a node in storage from the pool.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+BinaryNode<Comparable> *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+newNode( const Comparable & x, BinaryNode<Comparable> *lt,
+         BinaryNode<Comparable> *rt, int bal )
+{
+  TREE_STAT( counters.count( counters.allocations ); )
+  return newNode( pool, x, lt, rt, bal );
+}
+
+/**
+ * Internal method to construct a node in storage from allocator from.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+BinaryNode<Comparable> *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+newNode( NodeAllocator<BinaryNode<Comparable> > & from, const Comparable & x,
+         BinaryNode<Comparable> *lt, BinaryNode<Comparable> *rt, int bal )
+{
+  BinaryNode<Comparable> *t = from.allocate( );
+  try
+    {
+      return new ( t ) BinaryNode<Comparable>( x, lt, rt, bal );
+    }
+  catch( ... )
+    {
+      from.deallocate( t );
+      throw;
+    }
+}
+
+/**
+ * Internal method to construct a leaf in storage from the pool,
+ * with its element built from args.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class... Args>
+BinaryNode<Comparable> *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+emplaceNode( Args &&... args )
+{
+  TREE_STAT( counters.count( counters.allocations ); )
+  BinaryNode<Comparable> *t = pool.allocate( );
+  try
+    {
+      return new ( t ) BinaryNode<Comparable>( piecewise_construct,
+                                               std::forward<Args>( args )... );
+    }
+  catch( ... )
+    {
+      pool.deallocate( t );
+      throw;
+    }
+}
+
+/**
+ * Internal method to destroy node t and give its storage back
+ * to the pool.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+deleteNode( BinaryNode<Comparable> *t )
+{
+  t->~BinaryNode<Comparable>( );
+  pool.deallocate( t );
+}
+
+/**
+ * Internal method to point the children of t back at t.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+adopt( BinaryNode<Comparable> *t )
+{
+  if( t->left != NULL )
+    t->left->parent = t;
+  if( t->right != NULL )
+    t->right->parent = t;
+}
+
+/**
+ * Internal method to copy the cached fields of node from, which
+ * describe its subtree, to node to.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+copyCached( BinaryNode<Comparable> *to, BinaryNode<Comparable> *from )
+{
+  to->count = from->count;
+#if defined( BINARY_SEARCH_TREE_SHAPE )
+  to->height = from->height;
+  to->leaves = from->leaves;
+  to->depthSum = from->depthSum;
+  to->leafDepthSum = from->leafDepthSum;
+  to->full = from->full;
+  to->complete = from->complete;
+  to->shapeHash = from->shapeHash;
+  to->contentHash = from->contentHash;
+#endif
+}
+
+/**
+ * Internal method to refresh the shape fields of t and each of its
+ * ancestors, after an update at or below t and the rebalancing that
+ * followed it. The rotations have already refreshed the nodes they
+ * moved off this path. Without BINARY_SEARCH_TREE_SHAPE the counts
+ * are kept on the way down and there is nothing to do.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+refreshUp( BinaryNode<Comparable> *t ) const
+{
+#if defined( BINARY_SEARCH_TREE_SHAPE )
+  for( ; t != NULL; t = t->parent )
+    refresh( t );
+#else
+  (void) t;
+#endif
+}
+
+
+/**
+ * Return the number of items, in constant time.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+int BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::size() const {
+  return size(root);
+}
+
+/**
+ * Return the number of items with keys less than x, in time
+ * proportional to the height of the tree.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+int BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+rank( const KeyType & x ) const
+{
+  return countBefore( x );
+}
+
+/**
+ * The same for x of any type a transparent Compare takes.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class K, class C, class>
+int BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+rank( const K & x ) const
+{
+  return countBefore( x );
+}
+
+/**
+ * Find the item with exactly k smaller items, so select( 0 ) is
+ * the smallest, in time proportional to the height of the tree.
+ * Return that item or ITEM_NOT_FOUND if k is out of range.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+const Comparable & BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+select( int k ) const
+{
+  BinaryNode<Comparable> *t = root;
+
+  if( k < 0 || k >= size( root ) )
+    return ITEM_NOT_FOUND;
+  for( ; ; )
+    {
+      int leftSize = size( t->left );
+      if( k < leftSize )
+        t = t->left;
+      else if( k > leftSize )
+        {
+          k -= leftSize + 1;
+          t = t->right;
+        }
+      else
+        return t->element;
+    }
+}
+
+/**
+ * Let set operations split large inputs over up to n threads.
+ * The default is the number of hardware threads.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::setThreads( int n )
+{
+  threads = max( 1, n );
+}
+
+/**
+ * Splay nodes only as far up as depth; nodes already that high stay
+ * put. 0, the default, splays them to the root.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::setSplayDepth( int depth )
+{
+  requireSplay( );
+  splayDepth = max( 0, depth );
+}
+
+/**
+ * Let finds and accesses count hits rather than splay; adapt( ) then
+ * splays the nodes with at least hits of them. 0, the default, splays
+ * the node found by every access.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::setSplayHits( int hits )
+{
+  requireSplay( );
+  splayHits = max( 0, hits );
+}
+
+/**
+ * Splay the nodes with at least splayHits hits, in increasing order
+ * of hits, so that the most found item ends up at the root; then
+ * halve every count. Like an update, this must not run alongside
+ * other calls on the tree.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::adapt( )
+{
+  requireSplay( );
+  vector<pair<int, BinaryNode<Comparable> *> > hot;
+  vector<BinaryNode<Comparable> *> stack;
+  int least = max( 1, splayHits );
+
+  if( root != NULL )
+    stack.push_back( root );
+  while( !stack.empty( ) )
+    {
+      BinaryNode<Comparable> *t = stack.back( );
+      stack.pop_back( );
+      if( t->balance >= least )
+        hot.push_back( make_pair( t->balance, t ) );
+      t->balance /= 2;
+      if( t->left != NULL )
+        stack.push_back( t->left );
+      if( t->right != NULL )
+        stack.push_back( t->right );
+    }
+
+  sort( hot.begin( ), hot.end( ),
+        [ ]( const pair<int, BinaryNode<Comparable> *> & a,
+             const pair<int, BinaryNode<Comparable> *> & b )
+        { return a.first < b.first; } );
+  for( size_t i = 0; i < hot.size( ); i++ )
+    {
+      splay( hot[ i ].second );
+      refreshUp( hot[ i ].second );
+    }
+}
+
+/**
+ * Return a snapshot of the statistics of the tree; see TreeStats.h.
+ * Without BINARY_SEARCH_TREE_STATS only the size, and the height if
+ * the nodes keep it, are filled in.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+TreeStats BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::stats( ) const
+{
+  TreeStats s = TreeStats( );
+
+  TREE_STAT( counters.snapshot( s ); )
+  s.size = size( );
+#if defined( BINARY_SEARCH_TREE_SHAPE )
+  s.shaped = true;
+  s.height = root == NULL ? -1 : root->height;
+#endif
+  return s;
+}
+
+/**
+ * Zero the operation counters and latencies. The depth sum
+ * describes the nodes, so it is kept.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::resetStats( )
+{
+  TREE_STAT( counters.reset( ); )
+}
+
+
+/**
+ * Return the number of nodes in subtree t or 0 if NULL.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+int BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::size(BinaryNode<Comparable> *t) const
+{
+  return t == NULL ? 0 : t->count;
+}
+
+/**
+ * Return an immutable snapshot of the tree laid out in one array
+ * for fast lookups; see FrozenTree.h. FrozenTree searches with the
+ * < method on whole items, so only trees ordered that way freeze.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+FrozenTree<Comparable> BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::freeze( ) const
+{
+  static_assert( NaturalOrder::value,
+                 "only trees ordered by operator< on their items can be frozen" );
+
+  vector<Comparable> items;
+
+  flatten( root, items );
+  return FrozenTree<Comparable>( ITEM_NOT_FOUND, items );
+}
+
+/**
+ * Write the items to file path in the format of FrozenTree::save.
+ * Return true on success.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+save( const string & path ) const
+{
+  return freeze( ).save( path );
+}
+
+/**
+ * Replace the contents of the tree with the items saved in file
+ * path, building the tree in linear time. To search a saved file
+ * without building anything, load it into a FrozenTree instead.
+ * Return true on success; on failure the tree is unchanged.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+load( const string & path )
+{
+  FrozenTree<Comparable> file( ITEM_NOT_FOUND );
+
+  if( !file.load( path ) )
+    return false;
+  assign( file.begin( ), file.end( ) );
+  return true;
+}
+
+/**
+ * Return a cursor positioned at the smallest item.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::Cursor
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::cursor( ) const
+{
+  return Cursor( this, findMin( root ) );
+}
+
+/**
+ * Call sink( items, n ) with the items in sorted order, n at a time;
+ * n is STREAM_BATCH except in the last call. sink returns false to
+ * stop early.
+ * Return true if every item was passed to sink.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class Sink>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+exportItems( Sink sink ) const
+{
+  vector<Comparable> batch;
+  Cursor items = cursor( );
+
+  batch.reserve( STREAM_BATCH );
+  while( items.read( batch, STREAM_BATCH ) > 0 )
+    if( !sink( (const Comparable *) batch.data( ), batch.size( ) ) )
+      return false;
+  return true;
+}
+
+/**
+ * Write the number of items and then the items in sorted order to
+ * out as text, one per line.
+ * Return true if out took all of it.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+exportText( ostream & out ) const
+{
+  out << size( ) << '\n';
+  exportItems( [&]( const Comparable *items, size_t n )
+    {
+      for( size_t i = 0; i < n; i++ )
+        out << items[ i ] << '\n';
+      return !out.fail( );
+    } );
+  out.flush( );
+  return !out.fail( );
+}
+
+/**
+ * Write the number of items, as a 64-bit integer, and then the items
+ * in sorted order to file descriptor fd as raw bytes.
+ * Return true if fd took all of it.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+exportBinary( int fd ) const
+{
+  static_assert( is_trivially_copyable<Comparable>::value,
+                 "only trivially copyable items can be written raw" );
+
+  uint64_t n = size( );
+
+  return writeFully( fd, &n, sizeof( n ) ) &&
+         exportItems( [fd]( const Comparable *items, size_t count )
+           { return writeFully( fd, items, count * sizeof( Comparable ) ); } );
+}
+
+/**
+ * Replace the contents of the tree with n items pulled from source:
+ * each call source( item ) assigns the next item and returns false
+ * if there is none. The items must be sorted and distinct. The tree
+ * is built with minimum height as the items arrive.
+ * Return true on success; if source runs dry or the items are out
+ * of order, the tree is unchanged.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class Source>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+importItems( size_t n, Source source )
+{
+  BinarySearchTree incoming( ITEM_NOT_FOUND, comp );
+  BinaryNode<Comparable> *previous = NULL;
+  bool ok = true;
+
+  incoming.importTree( source, n, 0, redLevel( n ), &incoming.root, previous, ok );
+  if( !ok )
+    return false;
+  TREE_STAT( counters.count( counters.allocations, n );
+             incoming.counters.depthSum = balancedDepthSum( n ); )
+  *this = std::move( incoming );
+  return true;
+}
+
+/**
+ * Replace the contents of the tree with a stream written by
+ * exportText, reading the items with operator>>.
+ * Return true on success; on failure the tree is unchanged.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+importText( istream & in )
+{
+  size_t n;
+
+  if( !( in >> n ) )
+    return false;
+  return importItems( n, [&]( Comparable & item )
+    { return !( in >> item ).fail( ); } );
+}
+
+/**
+ * Replace the contents of the tree with a stream written by
+ * exportBinary, reading STREAM_BATCH items at a time.
+ * Return true on success; on failure the tree is unchanged.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+importBinary( int fd )
+{
+  static_assert( is_trivially_copyable<Comparable>::value,
+                 "only trivially copyable items can be read raw" );
+
+  uint64_t n;
+  uint64_t left;
+  vector<Comparable> batch( STREAM_BATCH, ITEM_NOT_FOUND );
+  size_t next = 0;
+  size_t filled = 0;
+
+  if( !readFully( fd, &n, sizeof( n ) ) )
+    return false;
+  left = n;
+  return importItems( n, [&]( Comparable & item )
+    {
+      if( next == filled )
+        {
+          filled = (size_t) min( left, (uint64_t) STREAM_BATCH );
+          next = 0;
+          if( filled == 0 ||
+              !readFully( fd, batch.data( ), filled * sizeof( Comparable ) ) )
+            return false;
+          left -= filled;
+        }
+      item = batch[ next++ ];
+      return true;
+    } );
+}
+
+/**
+ * Internal method for importItems to build a subtree of n items
+ * pulled from source into *link, shaped and colored as buildTree
+ * would. Each node is linked in before its children are built, so
+ * the partial tree is always reachable from the root. previous is
+ * the last node filled so far; ok is cleared, and the pulling
+ * stopped, when source runs dry or returns an item out of order.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class Source>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+importTree( Source & source, size_t n, int depth, int redDepth,
+            BinaryNode<Comparable> **link,
+            BinaryNode<Comparable> * & previous, bool & ok )
+{
+  *link = NULL;
+  if( n == 0 || !ok )
+    return;
+
+  size_t leftSize = ( n - 1 ) / 2;
+  BinaryNode<Comparable> *t =
+    newNode( ITEM_NOT_FOUND, NULL, NULL, depth == redDepth ? RED : BLACK );
+
+  *link = t;
+  importTree( source, leftSize, depth + 1, redDepth, &t->left, previous, ok );
+  if( ok && ( !source( t->element ) ||
+              ( previous != NULL &&
+                !comp( keyOf( previous->element ), keyOf( t->element ) ) ) ) )
+    ok = false;
+  previous = t;
+  importTree( source, n - 1 - leftSize, depth + 1, redDepth, &t->right, previous, ok );
+  adopt( t );
+  refresh( t );
+}
+
+/**
+ * Internal method to read exactly bytes bytes from fd into buffer.
+ * Return false on end of file or error.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+readFully( int fd, void *buffer, size_t bytes )
+{
+#ifdef BINARY_SEARCH_TREE_FD
+  char *p = (char *) buffer;
+
+  while( bytes > 0 )
+    {
+      ssize_t got = ::read( fd, p, bytes );
+      if( got < 0 && errno == EINTR )
+        continue;
+      if( got <= 0 )
+        return false;
+      p += got;
+      bytes -= got;
+    }
+  return true;
+#else
+  (void) fd; (void) buffer; (void) bytes;
+  return false;
+#endif
+}
+
+/**
+ * Internal method to write exactly bytes bytes from buffer to fd.
+ * Return false on error.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+writeFully( int fd, const void *buffer, size_t bytes )
+{
+#ifdef BINARY_SEARCH_TREE_FD
+  const char *p = (const char *) buffer;
+
+  while( bytes > 0 )
+    {
+      ssize_t put = ::write( fd, p, bytes );
+      if( put < 0 && errno == EINTR )
+        continue;
+      if( put < 0 )
+        return false;
+      p += put;
+      bytes -= put;
+    }
+  return true;
+#else
+  (void) fd; (void) buffer; (void) bytes;
+  return false;
+#endif
+}
+
+/**
+ * Return an iterator to the smallest item.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::const_iterator
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::begin( ) const
+{
+  return const_iterator( this, findMin( root ) );
+}
+
+/**
+ * Return the iterator past the largest item.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::const_iterator
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::end( ) const
+{
+  return const_iterator( this, NULL );
+}
+
+/**
+ * Return an iterator to the first item with key not less than x,
+ * or end( ) if there is none.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::const_iterator
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+lower_bound( const KeyType & x ) const
+{
+  return const_iterator( this, lowerBound( x ) );
+}
+
+/**
+ * The same for x of any type a transparent Compare takes.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class K, class C, class>
+typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::const_iterator
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+lower_bound( const K & x ) const
+{
+  return const_iterator( this, lowerBound( x ) );
+}
+
+/**
+ * Return an iterator to the first item with key greater than x,
+ * or end( ) if there is none.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::const_iterator
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+upper_bound( const KeyType & x ) const
+{
+  return const_iterator( this, upperBound( x ) );
+}
+
+/**
+ * The same for x of any type a transparent Compare takes.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class K, class C, class>
+typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::const_iterator
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+upper_bound( const K & x ) const
+{
+  return const_iterator( this, upperBound( x ) );
+}
+
+/**
+ * Return the items with key equal to x as a range of iterators;
+ * it holds at most one item.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+pair<typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::const_iterator,
+     typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::const_iterator>
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+equal_range( const KeyType & x ) const
+{
+  BinaryNode<Comparable> *first = lowerBound( x );
+  BinaryNode<Comparable> *last = first;
+
+  if( last != NULL && !comp( x, keyOf( last->element ) ) )
+    last = successor( last );
+  return make_pair( const_iterator( this, first ), const_iterator( this, last ) );
+}
+
+/**
+ * The same for x of any type a transparent Compare takes.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class K, class C, class>
+pair<typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::const_iterator,
+     typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::const_iterator>
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+equal_range( const K & x ) const
+{
+  BinaryNode<Comparable> *first = lowerBound( x );
+  BinaryNode<Comparable> *last = first;
+
+  if( last != NULL && !comp( x, keyOf( last->element ) ) )
+    last = successor( last );
+  return make_pair( const_iterator( this, first ), const_iterator( this, last ) );
+}
+
+/**
+ * Call visit( item ) for each item with key in [lo, hi), in sorted
+ * order. Costs one descent plus time proportional to the items
+ * visited.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class Visitor>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+range( const KeyType & lo, const KeyType & hi, Visitor visit ) const
+{
+  for( BinaryNode<Comparable> *t = lowerBound( lo );
+       t != NULL && comp( keyOf( t->element ), hi ); t = successor( t ) )
+    visit( t->element );
+}
+
+/*
+ *  Union : Finds the Union of two trees
+ *          merges the sorted contents of both trees and rebuilds
+ *          a balanced tree in O(n + m); large inputs are merged
+ *          and rebuilt on several threads (see setThreads)
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::Union(const BinarySearchTree& rhs)
+{
+   vector<Comparable> mine;
+   vector<Comparable> theirs;
+   vector<Comparable> result;
+
+   flatten(root, mine);
+   flatten(rhs.root, theirs);
+   merge(UNION, mine, theirs, result);
+   buildTree(result);
+}
+
+/*
+ * Intersection: finds the intersection of two trees
+ *               and adds it to this tree, in O(n + m)
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::Intersection(const BinarySearchTree& tree1,
+						const BinarySearchTree& tree2)
+{
+   vector<Comparable> items1;
+   vector<Comparable> items2;
+   vector<Comparable> result;
+
+   flatten(tree1.root, items1);
+   flatten(tree2.root, items2);
+   merge(INTERSECTION, items1, items2, result);
+   absorb(result);
+}
+
+/*
+ * Difference: finds the elements of tree1 that are not in tree2
+ *             and adds them to this tree, in O(n + m)
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::Difference(const BinarySearchTree& tree1,
+					      const BinarySearchTree& tree2)
+{
+   vector<Comparable> items1;
+   vector<Comparable> items2;
+   vector<Comparable> result;
+
+   flatten(tree1.root, items1);
+   flatten(tree2.root, items2);
+   merge(DIFFERENCE, items1, items2, result);
+   absorb(result);
+}
+
+/*
+ * SymmetricDifference: finds the elements in exactly one of the two
+ *                      trees and adds them to this tree, in O(n + m)
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::SymmetricDifference(const BinarySearchTree& tree1,
+						       const BinarySearchTree& tree2)
+{
+   vector<Comparable> items1;
+   vector<Comparable> items2;
+   vector<Comparable> result;
+
+   flatten(tree1.root, items1);
+   flatten(tree2.root, items2);
+   merge(SYMMETRIC_DIFFERENCE, items1, items2, result);
+   absorb(result);
+}
+
+/**
+ * Internal method to append the elements of subtree t to items
+ * in sorted order.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+flatten( BinaryNode<Comparable> *t, vector<Comparable> & items ) const
+{
+  vector<BinaryNode<Comparable> *> stack;
+
+  while( t != NULL || !stack.empty( ) )
+    {
+      if( t != NULL )
+        {
+          stack.push_back( t );
+          t = t->left;
+        }
+      else
+        {
+          t = stack.back( );
+          stack.pop_back( );
+          items.push_back( t->element );
+          t = t->right;
+        }
+    }
+}
+
+/**
+ * Internal method to add the sorted, duplicate-free items to the
+ * tree; the result is rebuilt balanced.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+absorb( const vector<Comparable> & items )
+{
+  if( items.empty( ) )
+    return;
+  if( isEmpty( ) )
+    {
+      buildTree( items );
+      return;
+    }
+
+  vector<Comparable> mine;
+  vector<Comparable> result;
+
+  flatten( root, mine );
+  merge( UNION, mine, items, result );
+  buildTree( result );
+}
+
+/**
+ * Internal method to sort items and drop duplicates.
+ * Large inputs are cut into one run per task; the runs are sorted
+ * concurrently and then merged pairwise with merge( UNION ).
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+sortUnique( vector<Comparable> & items ) const
+{
+  int tasks = taskCount( items.size( ) );
+  vector<vector<Comparable> > runs( tasks );
+  ItemLess less = itemLess( );
+
+  parallelFor( tasks, [&]( int k )
+    {
+      runs[ k ].assign( items.begin( ) + items.size( ) * k / tasks,
+                        items.begin( ) + items.size( ) * ( k + 1 ) / tasks );
+      sort( runs[ k ].begin( ), runs[ k ].end( ), less );
+      runs[ k ].erase( unique( runs[ k ].begin( ), runs[ k ].end( ),
+                               [less]( const Comparable & a, const Comparable & b )
+                               { return !less( a, b ); } ),
+                       runs[ k ].end( ) );
+    } );
+  vector<Comparable>( ).swap( items );
+
+  while( runs.size( ) > 1 )
+    {
+      vector<vector<Comparable> > merged( ( runs.size( ) + 1 ) / 2 );
+      for( size_t i = 0; i + 1 < runs.size( ); i += 2 )
+        {
+          merge( UNION, runs[ i ], runs[ i + 1 ], merged[ i / 2 ] );
+          vector<Comparable>( ).swap( runs[ i ] );
+          vector<Comparable>( ).swap( runs[ i + 1 ] );
+        }
+      if( runs.size( ) % 2 == 1 )
+        merged.back( ).swap( runs.back( ) );
+      runs.swap( merged );
+    }
+  items.swap( runs[ 0 ] );
+}
+
+/**
+ * Internal method to replace the contents of the tree with the
+ * sorted, duplicate-free items, as a tree of minimum height.
+ * Every level is full except possibly the last, so for a
+ * red-black tree the nodes on a partial last level are red and
+ * all others black.
+ * Large inputs are built in parallel: the top levels are built
+ * here and each subtree below them by a worker thread with its
+ * own allocator, which is then spliced into the tree's pool.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+buildTree( const vector<Comparable> & items )
+{
+  int redDepth = redLevel( items.size( ) );
+  int tasks = taskCount( items.size( ) );
+  int high = (int) items.size( ) - 1;
+
+  makeEmpty( );
+  TREE_STAT( counters.count( counters.allocations, items.size( ) );
+             counters.depthSum = balancedDepthSum( items.size( ) ); )
+
+  if( tasks == 1 )
+    {
+      root = buildTree( items, 0, high, 0, redDepth, pool );
+      return;
+    }
+
+  // About four subtrees per thread keeps the load even
+  int spawnDepth = 2;
+  while( ( 1 << spawnDepth ) < 4 * tasks )
+    spawnDepth++;
+
+  vector<BuildJob> jobs;
+  vector<BinaryNode<Comparable> *> top;
+  NodeAllocator<BinaryNode<Comparable> > *local =
+    new NodeAllocator<BinaryNode<Comparable> >[ tasks ];
+
+  buildTop( items, 0, high, 0, redDepth, spawnDepth, &root, jobs, top );
+  try
+    {
+      parallelFor( tasks, [&]( int k )
+        {
+          for( size_t j = k; j < jobs.size( ); j += tasks )
+            *jobs[ j ].link = buildTree( items, jobs[ j ].low, jobs[ j ].high,
+                                         jobs[ j ].depth, redDepth, local[ k ] );
+        } );
+    }
+  catch( ... )
+    {
+      for( int k = 0; k < tasks; k++ )
+        pool.splice( local[ k ] );
+      delete [ ] local;
+      throw;
+    }
+  for( int k = 0; k < tasks; k++ )
+    pool.splice( local[ k ] );
+  delete [ ] local;
+
+  // Children before parents
+  for( int i = (int) top.size( ) - 1; i >= 0; i-- )
+    {
+      adopt( top[ i ] );
+      refresh( top[ i ] );
+    }
+}
+
+/**
+ * Internal method to build a subtree from items[ low..high ]
+ * with nodes from allocator from.
+ * depth is the depth of the subtree root; nodes at redDepth are
+ * colored red. The recursion is only as deep as the result.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+BinaryNode<Comparable> *
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+buildTree( const vector<Comparable> & items, int low, int high,
+           int depth, int redDepth,
+           NodeAllocator<BinaryNode<Comparable> > & from )
+{
+  if( low > high )
+    return NULL;
+
+  int mid = low + ( high - low ) / 2;
+  BinaryNode<Comparable> *t =
+    newNode( from, items[ mid ], NULL, NULL, depth == redDepth ? RED : BLACK );
+
+  t->left = buildTree( items, low, mid - 1, depth + 1, redDepth, from );
+  t->right = buildTree( items, mid + 1, high, depth + 1, redDepth, from );
+  adopt( t );
+  refresh( t );
+  return t;
+}
+
+/**
+ * Internal method to return the depth whose nodes buildTree colors
+ * red in a tree of n items: the deepest level, unless the tree is a
+ * lone root, which stays black (-1). Only red-black trees are
+ * colored; the others start every balance at 0 (also -1).
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+int BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::redLevel( size_t n )
+{
+  int depth = 0;
+
+  if( !is_same<BalancePolicy, RedBlackPolicy>::value )
+    return -1;
+
+  for( ; n > 1; n /= 2 )
+    depth++;
+  return depth == 0 ? -1 : depth;
+}
+
+/**
+ * Internal method to return the sum of the node depths of a tree
+ * of n items whose levels are all full except possibly the last,
+ * as buildTree and importItems build them.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+long long BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::balancedDepthSum( size_t n )
+{
+  long long sum = 0;
+  size_t width = 1;
+
+  for( int depth = 0; n > 0; depth++ )
+    {
+      size_t level = min( n, width );
+      sum += (long long) depth * level;
+      n -= level;
+      width *= 2;
+    }
+  return sum;
+}
+
+/**
+ * Internal method for the parallel buildTree: builds the levels
+ * above spawnDepth into *link, recording each node in top (in
+ * preorder) and each subtree at spawnDepth as a job.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+buildTop( const vector<Comparable> & items, int low, int high,
+          int depth, int redDepth, int spawnDepth,
+          BinaryNode<Comparable> **link, vector<BuildJob> & jobs,
+          vector<BinaryNode<Comparable> *> & top )
+{
+  *link = NULL;
+  if( low > high )
+    return;
+  if( depth == spawnDepth )
+    {
+      BuildJob job = { low, high, depth, link };
+      jobs.push_back( job );
+      return;
+    }
+
+  int mid = low + ( high - low ) / 2;
+  *link = newNode( pool, items[ mid ], NULL, NULL, depth == redDepth ? RED : BLACK );
+  top.push_back( *link );
+  buildTop( items, low, mid - 1, depth + 1, redDepth, spawnDepth,
+            &( *link )->left, jobs, top );
+  buildTop( items, mid + 1, high, depth + 1, redDepth, spawnDepth,
+            &( *link )->right, jobs, top );
+}
+
+/**
+ * Internal method to append op( a, b ) to result, where a and b are
+ * sorted and duplicate-free. Large inputs are cut at common pivots
+ * and the pieces merged on separate threads.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+merge( SetOperation op, const vector<Comparable> & a,
+       const vector<Comparable> & b, vector<Comparable> & result ) const
+{
+  int tasks = taskCount( a.size( ) + b.size( ) );
+
+  if( tasks == 1 )
+    {
+      mergeRange( op, a.begin( ), a.end( ), b.begin( ), b.end( ), result );
+      return;
+    }
+
+  // Pivots are spread evenly over the larger input; everything below
+  // a pivot goes to the pieces before it in both inputs.
+  const vector<Comparable> & larger = a.size( ) >= b.size( ) ? a : b;
+  vector<ItemIterator> aCut( tasks + 1 );
+  vector<ItemIterator> bCut( tasks + 1 );
+  vector<vector<Comparable> > pieces( tasks );
+
+  aCut[ 0 ] = a.begin( );
+  bCut[ 0 ] = b.begin( );
+  aCut[ tasks ] = a.end( );
+  bCut[ tasks ] = b.end( );
+  for( int k = 1; k < tasks; k++ )
+    {
+      const Comparable & pivot = larger[ larger.size( ) * k / tasks ];
+      aCut[ k ] = std::lower_bound( a.begin( ), a.end( ), pivot, itemLess( ) );
+      bCut[ k ] = std::lower_bound( b.begin( ), b.end( ), pivot, itemLess( ) );
+    }
+  parallelFor( tasks, [&]( int k )
+    {
+      mergeRange( op, aCut[ k ], aCut[ k + 1 ], bCut[ k ], bCut[ k + 1 ],
+                  pieces[ k ] );
+    } );
+
+  size_t total = result.size( );
+  for( int k = 0; k < tasks; k++ )
+    total += pieces[ k ].size( );
+  result.reserve( total );
+  for( int k = 0; k < tasks; k++ )
+    result.insert( result.end( ), pieces[ k ].begin( ), pieces[ k ].end( ) );
+}
+
+/**
+ * Internal method to append op applied to two sorted ranges
+ * to result.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+mergeRange( SetOperation op, ItemIterator first1, ItemIterator last1,
+            ItemIterator first2, ItemIterator last2,
+            vector<Comparable> & result ) const
+{
+  ItemLess less = itemLess( );
+
+  switch( op )
+    {
+    case UNION:
+      set_union( first1, last1, first2, last2, back_inserter( result ), less );
+      break;
+    case INTERSECTION:
+      set_intersection( first1, last1, first2, last2, back_inserter( result ), less );
+      break;
+    case DIFFERENCE:
+      set_difference( first1, last1, first2, last2, back_inserter( result ), less );
+      break;
+    case SYMMETRIC_DIFFERENCE:
+      set_symmetric_difference( first1, last1, first2, last2,
+                                back_inserter( result ), less );
+      break;
+    }
+}
+
+/**
+ * Return the number of tasks to split n elements of work into.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+int BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::taskCount( size_t n ) const
+{
+  return (int) max( (size_t) 1, min( (size_t) threads, n / PARALLEL_CUTOFF ) );
+}
+
+/**
+ * Run body( 0 ) .. body( n - 1 ) concurrently, body( 0 ) on the
+ * calling thread, and wait for all of them. An exception thrown
+ * by any of them is rethrown here.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+template <class Body>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::parallelFor( int n, const Body & body )
+{
+  vector<future<void> > pending;
+
+  for( int i = 1; i < n; i++ )
+    pending.push_back( async( launch::async, body, i ) );
+  body( 0 );
+  for( size_t i = 0; i < pending.size( ); i++ )
+    pending[ i ].get( );
+}
+
+/*
+ * IsPerfect : determines is tree is triangular
+ *             fails if any node has a single child
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::IsPerfect()
+{
+   if ( isEmpty() ){ 
+      cout << "Empty Tree" << endl;
+      return true;
+   }
+   return shapeMetrics().perfect;
+}
+
+/*
+ *  IsComplete : determines if the tree is file left to right
+ *               fails if a node has a right child but no left child,
+ *               or a node off the leftmost path has any child
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::IsComplete()
+{
+ if ( isEmpty() ){ 
+      cout << "Empty Tree" << endl;
+      return true;
+   }
+   return shapeMetrics().complete;
+}
+
+/*
+ * IPL : Calculates internal path length, the sum of the depths of
+ *       the nodes with children
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+int BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::IPL()
+{
+   if( isEmpty( ) )
+      cout << "Empty tree" << endl;
+   else
+      return (int) shapeMetrics().ipl;
+   return 0;
+}
+
+/*
+ * EPL : calculates external path length, the sum of the depths of
+ *       the nodes without children
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+int BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::EPL()
+{
+   if( isEmpty( ) )
+      cout << "Empty tree" << endl;
+   else{
+      return (int) shapeMetrics().epl;
+   }   
+   return 0;
+
+}
+
+/**
+ * Return the path lengths, height, perfection and completeness of
+ * the tree: read off the root in O(1) when the nodes keep their
+ * shape (BINARY_SEARCH_TREE_SHAPE), else measured in one walk.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::ShapeMetrics
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::shapeMetrics( ) const
+{
+  ShapeMetrics m;
+
+#if defined( BINARY_SEARCH_TREE_SHAPE )
+  m.height = root == NULL ? -1 : root->height;
+  m.ipl = root == NULL ? 0 : root->depthSum - root->leafDepthSum;
+  m.epl = root == NULL ? 0 : root->leafDepthSum;
+  m.perfect = root == NULL || root->full;
+  m.complete = root == NULL || root->complete;
+#else
+  measure( m );
+#endif
+  return m;
+}
+
+/**
+ * Internal method to measure the shape of the tree in one pass
+ * over an explicit stack. Each node carries whether it is on the
+ * leftmost path, which IsComplete needs.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+measure( ShapeMetrics & m ) const
+{
+  struct Visit
+  {
+    BinaryNode<Comparable> *t;
+    int depth;
+    bool isLeft;
+  };
+  vector<Visit> stack;
+
+  m.ipl = m.epl = 0;
+  m.height = -1;
+  m.perfect = m.complete = true;
+  if( root != NULL )
+    {
+      Visit top = { root, 0, true };
+      stack.push_back( top );
+    }
+  while( !stack.empty( ) )
+    {
+      Visit v = stack.back( );
+      stack.pop_back( );
+      m.height = max( m.height, v.depth );
+      if( v.t->left == NULL && v.t->right == NULL )
+        m.epl += v.depth;
+      else
+        {
+          m.ipl += v.depth;
+          if( v.t->left == NULL || v.t->right == NULL )
+            m.perfect = false;
+          if( v.t->left == NULL || !v.isLeft )
+            m.complete = false;
+        }
+
+      if( v.t->right != NULL )
+        {
+          Visit right = { v.t->right, v.depth + 1, false };
+          stack.push_back( right );
+        }
+      if( v.t->left != NULL )
+        {
+          Visit left = { v.t->left, v.depth + 1, v.isLeft };
+          stack.push_back( left );
+        }
+    }
+}
+
+/*
+ * Same_Shape : checks to see if the two trees have the same shape,
+ *              ignoring the elements; trees of different sizes or
+ *              shape hashes differ, others are walked in step
+ */
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::Same_Shape(const BinarySearchTree& rhs)
+{
+   if (size() != rhs.size())
+      return false;
+#if defined( BINARY_SEARCH_TREE_SHAPE )
+   if (root != NULL && root->shapeHash != rhs.root->shapeHash)
+      return false;
+#endif
+   return sameShape(root, rhs.root);
+}
+
+/**
+ * Return true if this tree and rhs hold equivalent items, whatever
+ * their shapes (see sameItem). Trees of different sizes, or of
+ * different content hashes, differ; others are compared item by
+ * item in sorted order.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+operator==( const BinarySearchTree & rhs ) const
+{
+  if( this == &rhs )
+    return true;
+  if( size( ) != rhs.size( ) )
+    return false;
+#if defined( BINARY_SEARCH_TREE_SHAPE )
+  // Items equivalent under another Compare may hash differently
+  if( ItemHashable<Comparable>::value && NaturalOrder::value && root != NULL &&
+      root->contentHash != rhs.root->contentHash )
+    return false;
+#endif
+
+  for( BinaryNode<Comparable> *a = findMin( root ), *b = findMin( rhs.root );
+       a != NULL; a = successor( a ), b = successor( b ) )
+    if( !sameItem( a->element, b->element ) )
+      return false;
+  return true;
+}
+
+/**
+ * Return true unless this tree and rhs hold equivalent items.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+operator!=( const BinarySearchTree & rhs ) const
+{
+  return !( *this == rhs );
+}
+
+/**
+ * Internal method to compare two items for operator==. Items that
+ * are their own keys match if neither goes before the other; items
+ * that carry more than their key must also be equal by operator==.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+sameItem( const Comparable & a, const Comparable & b ) const
+{
+  return sameItem( a, b, is_same<KeyOf, IdentityKey>( ) );
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+sameItem( const Comparable & a, const Comparable & b, true_type ) const
+{
+  return !comp( a, b ) && !comp( b, a );
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+sameItem( const Comparable & a, const Comparable & b, false_type ) const
+{
+  return !comp( keyOf( a ), keyOf( b ) ) && !comp( keyOf( b ), keyOf( a ) ) && a == b;
+}
+
+/**
+ * Internal method to compare the shapes of the trees rooted at a
+ * and b, walking both in preorder at once. Each step goes down to
+ * a child, or back up the parent links to the next right child, so
+ * no stack is needed; while the shapes agree, b makes the same
+ * moves as a.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+sameShape( BinaryNode<Comparable> *a, BinaryNode<Comparable> *b )
+{
+  BinaryNode<Comparable> *top = a;
+
+  while( a != NULL )
+    {
+      if( ( a->left == NULL ) != ( b->left == NULL ) ||
+          ( a->right == NULL ) != ( b->right == NULL ) )
+        return false;
+
+      if( a->left != NULL )
+        {
+          a = a->left;
+          b = b->left;
+          continue;
+        }
+      if( a->right != NULL )
+        {
+          a = a->right;
+          b = b->right;
+          continue;
+        }
+
+      // Climb until a is a left child with a right sibling
+      for( ; ; )
+        {
+          if( a == top )
+            return true;
+          if( a == a->parent->left && a->parent->right != NULL )
+            {
+              a = a->parent->right;
+              b = b->parent->right;
+              break;
+            }
+          a = a->parent;
+          b = b->parent;
+        }
+    }
+  return b == NULL;
+}
+
+/**
+ * Internal method to scramble the bits of h, so that hashes which
+ * differ in a few bits differ in about half (the splitmix64
+ * finalizer).
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+uint64_t BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::mixHash( uint64_t h )
+{
+  h ^= h >> 30;
+  h *= 0xBF58476D1CE4E5B9ULL;
+  h ^= h >> 27;
+  h *= 0x94D049BB133111EBULL;
+  h ^= h >> 31;
+  return h;
+}
+
+/**
+ * Internal method to return the contribution of item x to the
+ * content hash: its mixed std::hash, or 0 if it has none.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+uint64_t BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+itemHash( const Comparable & x )
+{
+  return itemHash( x, ItemHashable<Comparable>( ) );
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+uint64_t BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+itemHash( const Comparable & x, true_type )
+{
+  return mixHash( hash<Comparable>( )( x ) );
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+uint64_t BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+itemHash( const Comparable &, false_type )
+{
+  return 0;
+}
+
+
+/**
+ * Internal method to restore the balance invariant after insert.
+ * path ends with the link to the new node.
+ * An unbalanced tree has nothing to restore.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+rebalanceInsert( UnbalancedPolicy )
+{
+}
+
+/**
+ * Internal method to restore the AVL invariant after insert.
+ * Walks back up path, rotating where the heights differ by two.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+rebalanceInsert( AvlPolicy )
+{
+  for( int i = (int) path.size( ) - 2; i >= 0; i-- )
+    balance( *path[ i ] );
+}
+
+/**
+ * Internal method to restore the red-black invariant after insert.
+ * The new node is colored red; a red parent is fixed by recoloring
+ * (red uncle) or by one or two rotations at the grandparent.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+rebalanceInsert( RedBlackPolicy )
+{
+  int i = (int) path.size( ) - 1;
+
+  ( *path[ i ] )->balance = RED;
+  while( i >= 2 && isRed( *path[ i - 1 ] ) )
+    {
+      BinaryNode<Comparable> * & grand = *path[ i - 2 ];
+      BinaryNode<Comparable> *parent = *path[ i - 1 ];
+
+      if( parent == grand->left )
+        {
+          BinaryNode<Comparable> *uncle = grand->right;
+          if( isRed( uncle ) )
+            {
+              parent->balance = uncle->balance = BLACK;
+              grand->balance = RED;
+              i -= 2;
+              continue;
+            }
+          if( path[ i ] == &parent->right )
+            rotateWithRightChild( grand->left );
+          rotateWithLeftChild( grand );
+          grand->balance = BLACK;
+          grand->right->balance = RED;
+        }
+      else
+        {
+          BinaryNode<Comparable> *uncle = grand->left;
+          if( isRed( uncle ) )
+            {
+              parent->balance = uncle->balance = BLACK;
+              grand->balance = RED;
+              i -= 2;
+              continue;
+            }
+          if( path[ i ] == &parent->left )
+            rotateWithLeftChild( grand->right );
+          rotateWithRightChild( grand );
+          grand->balance = BLACK;
+          grand->left->balance = RED;
+        }
+      break;
+    }
+  ( *path[ 0 ] )->balance = BLACK;
+}
+
+/**
+ * Internal method to restore the balance invariant after remove.
+ * removed is the unlinked node, not yet deleted.
+ * An unbalanced tree has nothing to restore.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+rebalanceRemove( BinaryNode<Comparable> *, UnbalancedPolicy )
+{
+}
+
+/**
+ * Internal method to restore the AVL invariant after remove.
+ * Unlike insert, more than one rotation may be needed on the way up.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+rebalanceRemove( BinaryNode<Comparable> *, AvlPolicy )
+{
+  for( int i = (int) path.size( ) - 2; i >= 0; i-- )
+    balance( *path[ i ] );
+}
+
+/**
+ * Internal method to restore the red-black invariant after remove.
+ * Removing a black node leaves an extra black on the link that took
+ * its place; it is pushed up the path until a red node or a rotation
+ * at the sibling absorbs it.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+rebalanceRemove( BinaryNode<Comparable> *removed, RedBlackPolicy )
+{
+  int i = (int) path.size( ) - 1;
+
+  if( removed->balance == RED )
+    return;
+  while( i > 0 && !isRed( *path[ i ] ) )
+    {
+      BinaryNode<Comparable> * & parent = *path[ i - 1 ];
+
+      if( path[ i ] == &parent->left )
+        {
+          BinaryNode<Comparable> *sibling = parent->right;
+          if( isRed( sibling ) )
+            {
+              // Make the sibling black; the old parent moves down a level
+              sibling->balance = BLACK;
+              parent->balance = RED;
+              rotateWithRightChild( parent );
+              path.insert( path.begin( ) + i, &parent->left );
+              i++;
+              continue;
+            }
+          if( !isRed( sibling->left ) && !isRed( sibling->right ) )
+            {
+              sibling->balance = RED;
+              i--;
+              continue;
+            }
+          if( !isRed( sibling->right ) )
+            {
+              sibling->left->balance = BLACK;
+              sibling->balance = RED;
+              rotateWithLeftChild( parent->right );
+              sibling = parent->right;
+            }
+          sibling->balance = parent->balance;
+          parent->balance = BLACK;
+          sibling->right->balance = BLACK;
+          rotateWithRightChild( parent );
+        }
+      else
+        {
+          BinaryNode<Comparable> *sibling = parent->left;
+          if( isRed( sibling ) )
+            {
+              sibling->balance = BLACK;
+              parent->balance = RED;
+              rotateWithLeftChild( parent );
+              path.insert( path.begin( ) + i, &parent->right );
+              i++;
+              continue;
+            }
+          if( !isRed( sibling->left ) && !isRed( sibling->right ) )
+            {
+              sibling->balance = RED;
+              i--;
+              continue;
+            }
+          if( !isRed( sibling->left ) )
+            {
+              sibling->right->balance = BLACK;
+              sibling->balance = RED;
+              rotateWithRightChild( parent->left );
+              sibling = parent->left;
+            }
+          sibling->balance = parent->balance;
+          parent->balance = BLACK;
+          sibling->left->balance = BLACK;
+          rotateWithLeftChild( parent );
+        }
+      return;
+    }
+  if( *path[ i ] != NULL )
+    ( *path[ i ] )->balance = BLACK;
+}
+
+/**
+ * Internal method to splay the new node after insert.
+ * path ends with the link to it.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+rebalanceInsert( SplayPolicy )
+{
+  splay( *path.back( ) );
+}
+
+/**
+ * Internal method to splay the parent of the unlinked node
+ * after remove.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+rebalanceRemove( BinaryNode<Comparable> *removed, SplayPolicy )
+{
+  if( removed->parent != NULL )
+    splay( removed->parent );
+}
+
+/**
+ * Internal method for access in a splay tree that found node t:
+ * splay it, or with setSplayHits count a hit in it.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+accessed( BinaryNode<Comparable> *t, SplayPolicy )
+{
+  if( t == NULL )
+    return;
+  if( splayHits == 0 )
+    {
+      splay( t );
+      refreshUp( t );
+    }
+  else
+    hit( t, SplayPolicy( ) );
+}
+
+/**
+ * Internal method for a find in a splay tree that found node t:
+ * with setSplayHits count a hit in it. Hits are added atomically,
+ * so finds may run concurrently.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+hit( BinaryNode<Comparable> *t, SplayPolicy ) const
+{
+  if( t == NULL || splayHits == 0 )
+    return;
+#if defined( __cpp_lib_atomic_ref )
+  atomic_ref<int> hits( t->balance );
+  if( hits.load( memory_order_relaxed ) < MAX_HITS )
+    hits.fetch_add( 1, memory_order_relaxed );
+#elif defined( __GNUC__ )
+  if( __atomic_load_n( &t->balance, __ATOMIC_RELAXED ) < MAX_HITS )
+    __atomic_fetch_add( &t->balance, 1, __ATOMIC_RELAXED );
+#else
+  if( t->balance < MAX_HITS )
+    t->balance++;     // Concurrent finds may lose a few hits
+#endif
+}
+
+/**
+ * Internal method to splay node t: move it up two levels at a time
+ * until it is the root, or down to splayDepth. A zig-zig step, with
+ * t and its parent on the same side, rotates the parent up and then
+ * t; a zig-zag step rotates t up twice. A single rotation ends the
+ * climb when one level is left.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+splay( BinaryNode<Comparable> *t )
+{
+  int depth = 0;
+
+  if( splayDepth > 0 )
+    for( BinaryNode<Comparable> *p = t->parent; p != NULL; p = p->parent )
+      depth++;
+  while( t->parent != NULL && ( splayDepth == 0 || depth > splayDepth ) )
+    {
+      BinaryNode<Comparable> *parent = t->parent;
+      BinaryNode<Comparable> *grand = parent->parent;
+
+      if( grand == NULL || depth - 1 == splayDepth )
+        {
+          rotateUp( t );
+          depth--;
+        }
+      else
+        {
+          if( ( grand->left == parent ) == ( parent->left == t ) )
+            rotateUp( parent );
+          else
+            rotateUp( t );
+          rotateUp( t );
+          depth -= 2;
+        }
+    }
+}
+
+/**
+ * Internal method to rotate node t above its parent.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+rotateUp( BinaryNode<Comparable> *t )
+{
+  BinaryNode<Comparable> *parent = t->parent;
+  BinaryNode<Comparable> *grand = parent->parent;
+  BinaryNode<Comparable> * & link =
+    grand == NULL ? root : grand->left == parent ? grand->left : grand->right;
+
+  if( parent->left == t )
+    rotateWithLeftChild( link );
+  else
+    rotateWithRightChild( link );
+}
+
+/**
+ * Internal method to recompute the cached fields of node t
+ * (subtree size and balance information) from its children.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+refresh( BinaryNode<Comparable> *t ) const
+{
+  t->count = size( t->left ) + size( t->right ) + 1;
+  refresh( t, BalancePolicy( ) );
+#if defined( BINARY_SEARCH_TREE_SHAPE )
+  BinaryNode<Comparable> *lt = t->left;
+  BinaryNode<Comparable> *rt = t->right;
+  int leftHeight = lt == NULL ? -1 : lt->height;
+  int rightHeight = rt == NULL ? -1 : rt->height;
+
+  t->height = max( leftHeight, rightHeight ) + 1;
+  t->depthSum = size( lt ) + size( rt );
+  if( lt == NULL && rt == NULL )
+    {
+      t->leaves = 1;
+      t->leafDepthSum = 0;
+    }
+  else
+    {
+      t->leaves = 0;
+      t->leafDepthSum = 0;
+      if( lt != NULL )
+        {
+          t->leaves += lt->leaves;
+          t->depthSum += lt->depthSum;
+          t->leafDepthSum += lt->leafDepthSum + lt->leaves;
+        }
+      if( rt != NULL )
+        {
+          t->leaves += rt->leaves;
+          t->depthSum += rt->depthSum;
+          t->leafDepthSum += rt->leafDepthSum + rt->leaves;
+        }
+    }
+  // As IsComplete walks it, t is on the leftmost path of its
+  // subtree, so its right child may only be a leaf
+  t->full = ( lt == NULL ) == ( rt == NULL ) &&
+            ( lt == NULL || lt->full ) && ( rt == NULL || rt->full );
+  t->complete = ( lt != NULL || rt == NULL ) &&
+                ( rt == NULL || rt->count == 1 ) &&
+                ( lt == NULL || lt->complete );
+
+  // Mirror images must differ, so the right hash is rotated first
+  uint64_t leftShape = lt == NULL ? 0 : lt->shapeHash;
+  uint64_t rightShape = rt == NULL ? 0 : rt->shapeHash;
+  t->shapeHash = mixHash( leftShape ^ ( rightShape << 32 | rightShape >> 32 ) ^
+                          0x9E3779B97F4A7C15ULL );
+  t->contentHash = ( lt == NULL ? 0 : lt->contentHash ) +
+                   ( rt == NULL ? 0 : rt->contentHash ) + itemHash( t->element );
+#endif
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+refresh( BinaryNode<Comparable> *, UnbalancedPolicy ) const
+{
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+refresh( BinaryNode<Comparable> *t, AvlPolicy ) const
+{
+  t->balance = max( height( t->left ), height( t->right ) ) + 1;
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+refresh( BinaryNode<Comparable> *, RedBlackPolicy ) const
+{
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+refresh( BinaryNode<Comparable> *, SplayPolicy ) const
+{
+}
+
+/**
+ * Return the height of node t or -1 if NULL.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+int BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+height( BinaryNode<Comparable> *t ) const
+{
+  return t == NULL ? -1 : t->balance;
+}
+
+/**
+ * Return true if node t is red; NULL links count as black.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+isRed( BinaryNode<Comparable> *t ) const
+{
+  return t != NULL && t->balance == RED;
+}
+
+/**
+ * Internal method to restore the AVL condition at node t,
+ * assuming both subtrees are already balanced.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+balance( BinaryNode<Comparable> * & t )
+{
+  if( height( t->left ) - height( t->right ) > 1 )
+    {
+      if( height( t->left->left ) >= height( t->left->right ) )
+        rotateWithLeftChild( t );
+      else
+        doubleWithLeftChild( t );
+    }
+  else if( height( t->right ) - height( t->left ) > 1 )
+    {
+      if( height( t->right->right ) >= height( t->right->left ) )
+        rotateWithRightChild( t );
+      else
+        doubleWithRightChild( t );
+    }
+  else
+    refresh( t );
+}
+
+/**
+ * Rotate binary tree node with left child.
+ * Update parent links and cached fields, then set new root.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+rotateWithLeftChild( BinaryNode<Comparable> * & k2 ) const
+{
+  BinaryNode<Comparable> *k1 = k2->left;
+  TREE_STAT( counters.count( counters.rotations );
+             counters.depthSum += size( k2->right ) - size( k1->left ); )
+  k2->left = k1->right;
+  k1->right = k2;
+  k1->parent = k2->parent;
+  adopt( k2 );
+  adopt( k1 );
+  refresh( k2 );
+  refresh( k1 );
+  k2 = k1;
+}
+
+/**
+ * Rotate binary tree node with right child.
+ * Update parent links and cached fields, then set new root.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+rotateWithRightChild( BinaryNode<Comparable> * & k1 ) const
+{
+  BinaryNode<Comparable> *k2 = k1->right;
+  TREE_STAT( counters.count( counters.rotations );
+             counters.depthSum += size( k1->left ) - size( k2->right ); )
+  k1->right = k2->left;
+  k2->left = k1;
+  k2->parent = k1->parent;
+  adopt( k1 );
+  adopt( k2 );
+  refresh( k1 );
+  refresh( k2 );
+  k1 = k2;
+}
+
+/**
+ * Double rotate binary tree node: first left child
+ * with its right child; then node k3 with new left child.
+ * Update cached fields, then set new root.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+doubleWithLeftChild( BinaryNode<Comparable> * & k3 ) const
+{
+  rotateWithRightChild( k3->left );
+  rotateWithLeftChild( k3 );
+}
+
+/**
+ * Double rotate binary tree node: first right child
+ * with its left child; then node k1 with new right child.
+ * Update cached fields, then set new root.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+void BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+doubleWithRightChild( BinaryNode<Comparable> * & k1 ) const
+{
+  rotateWithLeftChild( k1->right );
+  rotateWithRightChild( k1 );
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+const Comparable & BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+const_iterator::operator*( ) const
+{
+  return current->element;
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+const Comparable * BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+const_iterator::operator->( ) const
+{
+  return &current->element;
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::const_iterator &
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+const_iterator::operator++( )
+{
+  current = tree->successor( current );
+  return *this;
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::const_iterator
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+const_iterator::operator++( int )
+{
+  const_iterator old = *this;
+  ++*this;
+  return old;
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::const_iterator &
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+const_iterator::operator--( )
+{
+  current = tree->predecessor( current );
+  return *this;
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+typename BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::const_iterator
+BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+const_iterator::operator--( int )
+{
+  const_iterator old = *this;
+  --*this;
+  return old;
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+const_iterator::operator==( const const_iterator & rhs ) const
+{
+  return tree == rhs.tree && current == rhs.current;
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+const_iterator::operator!=( const const_iterator & rhs ) const
+{
+  return !( *this == rhs );
+}
+
+/**
+ * Replace the contents of batch with the next items, at most max.
+ * Return the number of items read; 0 once every item has been read.
+ */
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+size_t BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+Cursor::read( vector<Comparable> & batch, size_t max )
+{
+  batch.clear( );
+  for( ; current != NULL && batch.size( ) < max; current = tree->successor( current ) )
+    batch.push_back( current->element );
+  return batch.size( );
+}
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+bool BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>::
+Cursor::done( ) const
+{
+  return current == NULL;
+}
@@ -1,111 +1,747 @@
-#ifndef BINARY_SEARCH_TREE_H_
-#define BINARY_SEARCH_TREE_H_
-
-#include "dsexceptions.h"
-#include <iostream>       // For NULL
-#include <vector>
-
-using namespace std;
-
-// Binary node and forward declaration because g++ does
-// not understand nested classes.
-template <class Comparable>
-class BinarySearchTree;
-
-template <class Comparable>
-class BinaryNode
-{
-  Comparable element;
-  BinaryNode *left;
-  BinaryNode *right;
-  
-  BinaryNode( const Comparable & theElement, BinaryNode *lt, BinaryNode *rt )
-    : element( theElement ), left( lt ), right( rt ) { }
-  friend class BinarySearchTree<Comparable>;
-};
-
-
-// BinarySearchTree class
-//
-// CONSTRUCTION: with ITEM_NOT_FOUND object used to signal failed finds
-//
-// ******************PUBLIC OPERATIONS*********************
-// void insert( x )       --> Insert x
-// void remove( x )       --> Remove x
-// Comparable find( x )   --> Return item that matches x
-// Comparable findMin( )  --> Return smallest item
-// Comparable findMax( )  --> Return largest item
-// boolean isEmpty( )     --> Return true if empty; else false
-// void makeEmpty( )      --> Remove all items
-// void printTree( )      --> Print tree in sorted order
-
-template <class Comparable>
-class BinarySearchTree
-{
- public:
-  explicit BinarySearchTree( const Comparable & notFound );
-  BinarySearchTree( const BinarySearchTree & rhs );
-  ~BinarySearchTree( );
-  
-  const Comparable & findMin( ) const;
-  const Comparable & findMax( ) const;
-  const Comparable & find( const Comparable & x ) const;
-  bool isEmpty( ) const;
-  void printTree( ) const;
-  
-  void Union(const BinarySearchTree& rhs);
-  void Intersection(const BinarySearchTree& tree1, 
-		    const BinarySearchTree& tree2);
-
-  bool IsPerfect();
-  bool IsComplete();
-
-  int IPL();
-  int EPL();
-
-  bool Same_Shape(const BinarySearchTree& rhs);
-
-  void makeEmpty( );
-  void insert( const Comparable & x );
-  void remove( const Comparable & x );
-  
-  const BinarySearchTree & operator=( const BinarySearchTree & rhs );
-
-  int size( ) const;
-  
- private:
-
-  BinaryNode<Comparable> *root;
-  const Comparable ITEM_NOT_FOUND;
-
-  void Intersection(BinaryNode<Comparable> *t1, BinaryNode<Comparable> *t2);
-  void Union(BinaryNode<Comparable> *t);
-
-  bool IsPerfect(BinaryNode<Comparable> *t, bool truth);
-  bool IsComplete(BinaryNode<Comparable> *t, bool truth, bool isLeft,
-		  int currDepth, int leftDepth);
-
-  int IPL(BinaryNode<Comparable> *t, int counter, int depth);
-  int EPL(BinaryNode<Comparable> *t, int counter, int depth);
-
-  void FindShape(BinaryNode<Comparable> *t, vector <int>& shape, int depth);
-
-  const Comparable & elementAt( BinaryNode<Comparable> *t ) const;
-  
-  void insert( const Comparable & x, BinaryNode<Comparable> * & t ) const;
-  void remove( const Comparable & x, BinaryNode<Comparable> * & t ) const;
-  BinaryNode<Comparable> * findMin( BinaryNode<Comparable> *t ) const;
-  BinaryNode<Comparable> * findMax( BinaryNode<Comparable> *t ) const;
-  BinaryNode<Comparable> * find( const Comparable & x, BinaryNode<Comparable> *t ) const;
-  void makeEmpty( BinaryNode<Comparable> * & t ) const;
-  void printTree( BinaryNode<Comparable> *t ) const;
-
-
-  BinaryNode<Comparable> * clone( BinaryNode<Comparable> *t ) const;
-
-  int size(BinaryNode<Comparable> *t) const;
-
-};
-
-#include "BinarySearchTree.cpp"
-#endif
+#ifndef BINARY_SEARCH_TREE_H_
+#define BINARY_SEARCH_TREE_H_
+
+#include "dsexceptions.h"
+#include "FrozenTree.h"
+#include "NodePool.h"
+#include "TreeStats.h"
+#include <cstddef>
+#include <functional>
+#include <iostream>       // For NULL
+#include <iterator>
+#include <stdint.h>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// Balancing policies, selected by the second template parameter
+// of BinarySearchTree.
+//
+// UnbalancedPolicy : plain search tree; shape follows insertion order
+// AvlPolicy        : AVL tree, height at most 1.44 log n
+// RedBlackPolicy   : red-black tree, height at most 2 log n
+// SplayPolicy      : self-adjusting splay tree; items that are found
+//                    often move toward the root (see setSplayDepth,
+//                    setSplayHits and adapt)
+struct UnbalancedPolicy { };
+struct AvlPolicy { };
+struct RedBlackPolicy { };
+struct SplayPolicy { };
+
+// Key extractors, selected by the fifth template parameter. The tree
+// orders its items by KeyOf( )( item ), which returns a reference to
+// the key held inside the item, so map-like items need not store
+// their key twice.
+//
+// IdentityKey : the item is its own key
+// FirstKey    : the key is item.first, as in pair<Key, Value>
+struct IdentityKey
+{
+  template <class T>
+  const T & operator()( const T & item ) const
+    { return item; }
+};
+struct FirstKey
+{
+  template <class T>
+  const typename T::first_type & operator()( const T & item ) const
+    { return item.first; }
+};
+
+// Orderings, selected by the fourth template parameter. A Compare is
+// called as comp( a, b ) and returns true if key a goes before key b.
+// If it declares is_transparent, find, rank, lower_bound, upper_bound
+// and equal_range also take any type it can compare with the keys,
+// such as a const char * for string keys, without building a key.
+// If it also has int compare( a, b ), negative, zero or positive as a
+// goes before, with or after b, each node of a search costs a single
+// compare( ) instead of up to two calls of comp.
+//
+// less<>          : operator<; the default
+// ThreeWayCompare : operator< for comp, and for compare( ) operator<=>
+//                   where the compiler has it, else a.compare( b ) as
+//                   on strings, else operator< twice
+struct ThreeWayCompare
+{
+  typedef void is_transparent;
+
+  template <class A, class B>
+  bool operator()( const A & a, const B & b ) const
+    { return a < b; }
+
+  template <class A, class B>
+  int compare( const A & a, const B & b ) const
+    { return order( a, b, Spaceship( ) ); }
+
+ private:
+  // Ways to compare, from the least to the most preferred
+  struct Fallback { };
+  struct Swapped : Fallback { };
+  struct Member : Swapped { };
+  struct Spaceship : Member { };
+
+#if defined( __cpp_impl_three_way_comparison )
+  template <class A, class B>
+  static auto order( const A & a, const B & b, Spaceship ) -> decltype( a <=> b, 0 )
+  {
+    auto c = a <=> b;
+    return c < 0 ? -1 : c > 0 ? 1 : 0;
+  }
+#endif
+  template <class A, class B>
+  static auto order( const A & a, const B & b, Member ) -> decltype( a.compare( b ), 0 )
+  {
+    int c = a.compare( b );
+    return c < 0 ? -1 : c > 0 ? 1 : 0;
+  }
+  template <class A, class B>
+  static auto order( const A & a, const B & b, Swapped ) -> decltype( b.compare( a ), 0 )
+  {
+    int c = b.compare( a );
+    return c < 0 ? 1 : c > 0 ? -1 : 0;
+  }
+  template <class A, class B>
+  static int order( const A & a, const B & b, Fallback )
+    { return a < b ? -1 : b < a ? 1 : 0; }
+};
+
+// HasThreeWay<Compare, A, B>::value is true if Compare has a
+// compare( a, b ) for an A and a B
+template <class Compare, class A, class B, class = void>
+struct HasThreeWay : false_type { };
+template <class Compare, class A, class B>
+struct HasThreeWay<Compare, A, B,
+                   decltype( (void) declval<const Compare &>( ).compare(
+                               declval<const A &>( ), declval<const B &>( ) ) )>
+  : true_type { };
+
+// ItemHashable<T>::value is true if std::hash<T> is usable, which
+// lets trees of T keep a hash of their contents
+template <class T, class = void>
+struct ItemHashable : false_type { };
+template <class T>
+struct ItemHashable<T, decltype( (void) hash<T>( )( declval<const T &>( ) ) )>
+  : true_type { };
+
+// ItemMapped<T>::type is the value carried by a key/value item,
+// T::second_type, or void for items without one
+template <class T, class = void>
+struct ItemMapped { typedef void type; };
+template <class T>
+struct ItemMapped<T, decltype( (void) declval<typename T::second_type *>( ) )>
+  { typedef typename T::second_type type; };
+
+// Binary node and forward declaration because g++ does
+// not understand nested classes.
+template <class Comparable, class BalancePolicy = UnbalancedPolicy,
+          template <class> class NodeAllocator = NodePool,
+          class Compare = less<>, class KeyOf = IdentityKey>
+class BinarySearchTree;
+
+// A tree of key/value pairs ordered by key: BinarySearchTree in map
+// mode, with insert_or_assign, try_emplace, operator[], findValue and
+// update on top of the set operations
+template <class Key, class Value, class BalancePolicy = UnbalancedPolicy,
+          template <class> class NodeAllocator = NodePool,
+          class Compare = less<> >
+using BinarySearchMap =
+  BinarySearchTree<pair<Key, Value>, BalancePolicy, NodeAllocator, Compare, FirstKey>;
+
+template <class Comparable>
+class BinaryNode
+{
+  Comparable element;
+  BinaryNode *left;
+  BinaryNode *right;
+  BinaryNode *parent;   // NULL at the root; lets iterators climb back up
+  int balance;      // AVL height, red-black color or splay hits; unused when unbalanced
+  int count;        // Nodes in the subtree rooted here
+#if defined( BINARY_SEARCH_TREE_SHAPE )
+  int height;               // Longest path down to a leaf; 0 for a leaf
+  int leaves;               // Nodes without children in the subtree
+  long long depthSum;       // Depths of the subtree's nodes below this one
+  long long leafDepthSum;   // The same over its nodes without children
+  bool full;                // No node with one child; see IsPerfect
+  bool complete;            // Left spine with leaves on its right; see IsComplete
+  uint64_t shapeHash;       // Hash of the subtree's shape; 0 for NULL
+  uint64_t contentHash;     // Sum of the item hashes; see ItemHashable
+#endif
+  
+  BinaryNode( const Comparable & theElement, BinaryNode *lt, BinaryNode *rt,
+              int bal = 0 )
+    : element( theElement ), left( lt ), right( rt ), parent( NULL ),
+      balance( bal ), count( 1 )
+#if defined( BINARY_SEARCH_TREE_SHAPE )
+      , height( 0 ), leaves( 1 ), depthSum( 0 ), leafDepthSum( 0 ), full( true ), complete( true ),
+      shapeHash( 0 ), contentHash( 0 )
+#endif
+      { }
+  template <class... Args>
+  explicit BinaryNode( piecewise_construct_t, Args &&... args )
+    : element( std::forward<Args>( args )... ), left( NULL ), right( NULL ),
+      parent( NULL ), balance( 0 ), count( 1 )
+#if defined( BINARY_SEARCH_TREE_SHAPE )
+      , height( 0 ), leaves( 1 ), depthSum( 0 ), leafDepthSum( 0 ), full( true ), complete( true ),
+      shapeHash( 0 ), contentHash( 0 )
+#endif
+      { }
+  template <class C, class B, template <class> class A, class O, class K>
+  friend class BinarySearchTree;
+  friend struct BinarySearchTreeTest;   // Builds shapes; see spine_test.cpp
+};
+
+
+// BinarySearchTree class
+//
+// CONSTRUCTION: with ITEM_NOT_FOUND object used to signal failed finds,
+//               optionally followed by a range of initial items
+//               and, for a Compare with state, the Compare to use
+// BalancePolicy picks the shape invariant kept by insert and remove
+// NodeAllocator supplies node storage (see NodePool.h)
+// Compare orders the keys and KeyOf finds the key of an item; the
+// defaults order the items themselves with operator< (see above)
+//
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x )       --> Insert x; an rvalue x is moved into the tree
+// void emplace( args )   --> Insert the item constructed from args
+// void assign( b, e )    --> Replace contents with the items in [b, e)
+// void remove( x )       --> Remove x
+// void insertBatch( a, n )  --> Insert a[ 0.. n - 1 ]
+// void removeBatch( a, n )  --> Remove a[ 0.. n - 1 ]
+// void findBatch( a, n, r ) --> Set r[ i ] to find( a[ i ] ) for i < n
+// void findMany( a, n, r, w ) --> Same, with w lookups interleaved
+// Comparable find( x )   --> Return item whose key matches x
+// Comparable access( x ) --> Same, and splay the item found      (splay)
+// bool insert_or_assign( k, v ) --> Set the value of key k to v     (maps)
+// bool try_emplace( k, args )   --> Add key k, value from args, if
+//                                   k is missing                    (maps)
+// Value & operator[]( k )       --> Value of k, added if missing    (maps)
+// Value * findValue( k )        --> Value of k, or NULL             (maps)
+// bool update( k, f )           --> Call f( value of k ) in place   (maps)
+// Comparable findMin( )  --> Return smallest item
+// Comparable findMax( )  --> Return largest item
+// boolean isEmpty( )     --> Return true if empty; else false
+// void makeEmpty( )      --> Remove all items
+// void swap( rhs )       --> Exchange contents with rhs, in O(1)
+// void printTree( )      --> Print tree in sorted order
+// void Union( rhs )                     --> Add the elements of rhs
+// void Intersection( t1, t2 )           --> Add elements in both t1 and t2
+// void Difference( t1, t2 )             --> Add elements in t1 but not t2
+// void SymmetricDifference( t1, t2 )    --> Add elements in exactly one
+// int size( )            --> Return number of items
+// int rank( x )          --> Return number of keys less than x
+// Comparable select( k ) --> Return item of rank k (0 is smallest)
+// void setThreads( n )   --> Let set operations use up to n threads
+// void setSplayDepth( d ) --> Splay found items up to depth d only  (splay)
+// void setSplayHits( n )  --> Let finds count hits instead; adapt( )
+//                             splays items with n or more          (splay)
+// void adapt( )           --> Splay the items finds hit most       (splay)
+// FrozenTree freeze( )   --> Return a read-only array snapshot
+// bool save( path )      --> Write the items to file path
+// bool load( path )      --> Replace contents with the items in file path
+// Cursor cursor( )       --> Pull the items in sorted order, in batches
+// bool exportItems( f )  --> Push the items in sorted order to f, in batches
+// bool exportText( out ) --> Write the count and items to out, as text
+// bool exportBinary( fd )   --> Write the count and items to fd, raw
+// bool importItems( n, f )  --> Replace contents with n sorted items from f
+// bool importText( in )     --> Replace contents with a stream from exportText
+// bool importBinary( fd )   --> Replace contents with a stream from exportBinary
+// begin( ), end( )       --> Iterate over the items in sorted order
+// lower_bound( x )       --> Iterator to first key not less than x
+// upper_bound( x )       --> Iterator to first key greater than x
+// equal_range( x )       --> Pair of lower_bound( x ) and upper_bound( x )
+// void range( lo, hi, f )   --> Call f( item ) for each key in [lo, hi)
+// ShapeMetrics shapeMetrics( ) --> Return IPL, EPL, height, IsPerfect
+//                                  and IsComplete together
+// bool operator==( rhs )   --> Return true if both hold the same items
+// TreeStats stats( )     --> Return the counters; see TreeStats.h
+// void resetStats( )     --> Zero the operation counters
+//
+// find, remove, rank, the bounds and the batch lookups take keys,
+// and "less than" means before in the order of Compare; with the
+// defaults a key is a whole item, as before. Each search compares x
+// with the node keys through one helper, which makes a single
+// three-way comparison per node when Compare provides one.
+//
+// Trees of pair<Key, Value> ordered with FirstKey, as declared by
+// BinarySearchMap, also work as maps. The map operations find the
+// key in a single descent and reach the value in its node, so an
+// update costs one lookup and the value is never copied out. They
+// change values only, never keys, so the order is not disturbed;
+// references from operator[] and findValue stay valid like iterators.
+//
+// Iterators stay valid across inserts and rebalancing. remove( x )
+// invalidates iterators to x and to its successor, and the set
+// operations and assign invalidate all iterators.
+//
+// Moving or swapping trees hands over the nodes and the pool that
+// holds them without allocating. Iterators to items stay valid and
+// follow the items; end( ) iterators stay with the tree object.
+// The comparators go with the nodes; the ITEM_NOT_FOUND, thread and
+// splay settings are not transferred.
+//
+// Streams carry the item count ahead of the items; knowing it lets
+// the importers build a tree of minimum height as the items arrive,
+// holding one path of the tree rather than the whole input. Exports
+// go through a fixed buffer of STREAM_BATCH items. Cursors are
+// invalidated like iterators. File descriptors are only supported
+// on POSIX systems; elsewhere those calls return false.
+//
+// The batch operations sort their keys first. findBatch walks the
+// tree once for the whole batch, a level at a time, so keys share
+// the nodes they have in common and the nodes of a level are
+// prefetched together. On an unbalanced tree, insertBatch makes the
+// same walk and hangs the keys that meet at each empty link there
+// as a subtree of minimum height. On the other trees it looks the
+// batch up that way first and then inserts the missing keys one by
+// one in sorted order, so consecutive keys find their paths in
+// cache; removeBatch removes key by key the same way. A batch of
+// at least 1 / BATCH_REBUILD_RATIO of the tree is merged with its
+// items and the tree rebuilt in linear time, which invalidates all
+// iterators.
+//
+// findMany leaves the keys in the order given and runs up to w
+// lookups side by side, INTERLEAVE unless told otherwise. Each takes
+// one step down the tree in turn and prefetches the child it moves
+// to, so by the time its turn comes again the node has arrived and
+// the cache misses of the w lookups overlap. The gain grows with
+// the tree, as more of each path misses the cache. findBatch may do
+// better on sorted or clustered keys, which share their paths.
+//
+// With SplayPolicy, insert splays the new node and remove the parent
+// of the unlinked one: each is rotated up two levels at a time, by a
+// zig-zig or zig-zag step, until it is the root. access( x ) finds x
+// and splays the node it found, so a skewed trace keeps its hot
+// items near the top. find, misses, bounds, rank, iteration and the
+// batch lookups leave the shape alone, so they may still run
+// alongside each other; access changes the tree and is called like
+// an update. Every operation takes O(log n) amortized time, but one
+// may take O(n).
+// setSplayDepth( d ) makes splaying semi-splaying: nodes no deeper
+// than d stay where they are and the others stop at depth d, so the
+// top of the tree churns less.
+// setSplayHits( n ) turns on the frequency-aware mode: find and
+// access leave the shape alone and only count a hit in the node they
+// found, with a relaxed atomic add, so either may run concurrently.
+// adapt( ), called like an update, then splays each node with at
+// least n hits since the last adapt( ), from the coldest to the
+// hottest, which leaves the hottest at the root, and halves every
+// count so that old hits fade. It visits every node. On the other
+// policies access is a find, and the splay settings do not compile.
+//
+// Built with BINARY_SEARCH_TREE_STATS, the tree counts finds and
+// their comparisons, inserts, removes, node allocations and
+// rotations, times find, insert and remove, and keeps the sum of
+// the depths of its nodes as it changes: an insert adds the depth
+// of the new leaf, an unlinked node takes off its own depth and one
+// level for each node below it, and a rotation moves one outer
+// subtree up a level and the other down. Bulk builds have minimum
+// height, so their sum follows from the size.
+//
+// Built with BINARY_SEARCH_TREE_SHAPE, every node also keeps the
+// height, leaf count, depth sums and completeness of its subtree,
+// recomputed from its children on the way back up from each update
+// and by each rotation. IPL, EPL, IsPerfect, IsComplete and
+// shapeMetrics then take O(1); without it they walk the tree once.
+// The nodes also keep a hash of the shape of their subtree and, for
+// items with a std::hash, the sum of the hashes of their items,
+// which does not depend on the shape. Same_Shape and operator== then
+// reject most unequal trees by comparing the roots, and otherwise
+// confirm by walking both trees in step along the parent links,
+// without allocating. Trees of different sizes are told apart in
+// O(1) in every build.
+
+template <class Comparable, class BalancePolicy,
+          template <class> class NodeAllocator, class Compare, class KeyOf>
+class BinarySearchTree
+{
+ public:
+  class const_iterator
+  {
+   public:
+    typedef bidirectional_iterator_tag iterator_category;
+    typedef Comparable value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const Comparable * pointer;
+    typedef const Comparable & reference;
+
+    const_iterator( ) : tree( NULL ), current( NULL ) { }
+
+    const Comparable & operator*( ) const;
+    const Comparable * operator->( ) const;
+    const_iterator & operator++( );
+    const_iterator operator++( int );
+    const_iterator & operator--( );
+    const_iterator operator--( int );
+    bool operator==( const const_iterator & rhs ) const;
+    bool operator!=( const const_iterator & rhs ) const;
+
+   private:
+    const BinarySearchTree *tree;
+    BinaryNode<Comparable> *current;    // NULL is end( )
+
+    const_iterator( const BinarySearchTree *t, BinaryNode<Comparable> *n )
+      : tree( t ), current( n ) { }
+    friend class BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>;
+  };
+
+  // Reads the items of a tree in sorted order, a batch at a time
+  class Cursor
+  {
+   public:
+    Cursor( ) : tree( NULL ), current( NULL ) { }
+
+    size_t read( vector<Comparable> & batch, size_t max );
+    bool done( ) const;
+
+   private:
+    const BinarySearchTree *tree;
+    BinaryNode<Comparable> *current;    // Next item to read; NULL when done
+
+    Cursor( const BinarySearchTree *t, BinaryNode<Comparable> *n )
+      : tree( t ), current( n ) { }
+    friend class BinarySearchTree<Comparable, BalancePolicy, NodeAllocator, Compare, KeyOf>;
+  };
+
+  // The shape of a tree; see IPL, EPL, IsPerfect and IsComplete
+  struct ShapeMetrics
+  {
+    long long ipl;      // Depths of the nodes with children; root is 0
+    long long epl;      // Depths of the nodes without children
+    int height;         // -1 if empty
+    bool perfect;       // As IsPerfect: no node with one child
+    bool complete;      // As IsComplete: a left spine with leaves on its right
+  };
+
+  // The key inside each item, by which the items are ordered
+  typedef typename decay<decltype( KeyOf( )( declval<const Comparable &>( ) ) )>::type
+    KeyType;
+  // The value inside each item, in map mode; void otherwise
+  typedef typename ItemMapped<Comparable>::type MappedType;
+
+  enum { STREAM_BATCH = 4096 };    // Items per batch of exportItems
+  enum { BATCH_REBUILD_RATIO = 16 };  // See insertBatch and removeBatch
+  enum { INTERLEAVE = 16 };        // Lookups findMany runs side by side
+  enum { MAX_INTERLEAVE = 64 };    // Most it runs, whatever it is told
+
+  explicit BinarySearchTree( const Comparable & notFound,
+                             const Compare & order = Compare( ) );
+  template <class Iterator>
+  BinarySearchTree( const Comparable & notFound, Iterator first, Iterator last,
+                    const Compare & order = Compare( ) );
+  BinarySearchTree( const BinarySearchTree & rhs );
+  BinarySearchTree( BinarySearchTree && rhs );
+  ~BinarySearchTree( );
+  
+  const Comparable & findMin( ) const;
+  const Comparable & findMax( ) const;
+  const Comparable & find( const KeyType & x ) const;
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  const Comparable & find( const K & x ) const;
+  const Comparable & access( const KeyType & x );
+  bool isEmpty( ) const;
+  void printTree( ) const;
+  
+  void Union(const BinarySearchTree& rhs);
+  void Intersection(const BinarySearchTree& tree1, 
+		    const BinarySearchTree& tree2);
+  void Difference(const BinarySearchTree& tree1,
+		  const BinarySearchTree& tree2);
+  void SymmetricDifference(const BinarySearchTree& tree1,
+			   const BinarySearchTree& tree2);
+
+  bool IsPerfect();
+  bool IsComplete();
+
+  int IPL();
+  int EPL();
+
+  ShapeMetrics shapeMetrics( ) const;
+
+  bool Same_Shape(const BinarySearchTree& rhs);
+  bool operator==( const BinarySearchTree & rhs ) const;
+  bool operator!=( const BinarySearchTree & rhs ) const;
+
+  void makeEmpty( );
+  void insert( const Comparable & x );
+  void insert( Comparable && x );
+  template <class... Args>
+  void emplace( Args &&... args );
+  template <class Iterator>
+  void assign( Iterator first, Iterator last );
+  void remove( const KeyType & x );
+  void insertBatch( const Comparable *items, size_t n );
+  void removeBatch( const KeyType *keys, size_t n );
+  void findBatch( const KeyType *keys, size_t n, Comparable *results ) const;
+  void findMany( const KeyType *keys, size_t n, Comparable *results,
+                 int width = INTERLEAVE ) const;
+
+  template <class V>
+  bool insert_or_assign( const KeyType & k, V && value );
+  template <class... Args>
+  bool try_emplace( const KeyType & k, Args &&... args );
+  typename add_lvalue_reference<MappedType>::type operator[]( const KeyType & k );
+  MappedType * findValue( const KeyType & k );
+  const MappedType * findValue( const KeyType & k ) const;
+  template <class Function>
+  bool update( const KeyType & k, Function f );
+  
+  const BinarySearchTree & operator=( const BinarySearchTree & rhs );
+  const BinarySearchTree & operator=( BinarySearchTree && rhs );
+  void swap( BinarySearchTree & rhs );
+
+  int size( ) const;
+  int rank( const KeyType & x ) const;
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  int rank( const K & x ) const;
+  const Comparable & select( int k ) const;
+
+  void setThreads( int n );
+  void setSplayDepth( int depth );
+  void setSplayHits( int hits );
+  void adapt( );
+
+  FrozenTree<Comparable> freeze( ) const;
+  bool save( const string & path ) const;
+  bool load( const string & path );
+
+  Cursor cursor( ) const;
+  template <class Sink>
+  bool exportItems( Sink sink ) const;
+  bool exportText( ostream & out ) const;
+  bool exportBinary( int fd ) const;
+  template <class Source>
+  bool importItems( size_t n, Source source );
+  bool importText( istream & in );
+  bool importBinary( int fd );
+
+  const_iterator begin( ) const;
+  const_iterator end( ) const;
+  const_iterator lower_bound( const KeyType & x ) const;
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  const_iterator lower_bound( const K & x ) const;
+  const_iterator upper_bound( const KeyType & x ) const;
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  const_iterator upper_bound( const K & x ) const;
+  pair<const_iterator, const_iterator> equal_range( const KeyType & x ) const;
+  template <class K, class C = Compare, class = typename C::is_transparent>
+  pair<const_iterator, const_iterator> equal_range( const K & x ) const;
+  template <class Visitor>
+  void range( const KeyType & lo, const KeyType & hi, Visitor visit ) const;
+
+  TreeStats stats( ) const;
+  void resetStats( );
+  
+ private:
+
+  BinaryNode<Comparable> *root;
+  const Comparable ITEM_NOT_FOUND;
+
+  // Links from the root down to the last node touched by insert or
+  // remove; kept as a member so the storage is reused between calls.
+  vector<BinaryNode<Comparable> **> path;
+
+  NodeAllocator<BinaryNode<Comparable> > pool;
+  int threads;      // Upper bound on threads used by set operations
+  Compare comp;
+  int splayDepth;   // Splay no node above this depth; 0 splays to the root
+  int splayHits;    // Hits adapt( ) splays at; 0 splays on every access
+
+#if defined( BINARY_SEARCH_TREE_STATS )
+  mutable TreeCounters counters;
+#endif
+
+  enum { BLACK = 0, RED = 1 };
+  enum { MAX_HITS = 1 << 30 };     // Splay hits stop counting here
+
+  // Set operations split their work into tasks of at least this many
+  // elements; smaller inputs are handled on the calling thread.
+  enum { PARALLEL_CUTOFF = 1 << 16 };
+
+  enum SetOperation { UNION, INTERSECTION, DIFFERENCE, SYMMETRIC_DIFFERENCE };
+  typedef typename vector<Comparable>::const_iterator ItemIterator;
+
+  // True if the items are ordered by their own operator<, as
+  // FrozenTree and the content hashes of operator== assume
+  typedef integral_constant<bool,
+            is_same<KeyOf, IdentityKey>::value &&
+            ( is_same<Compare, less<> >::value ||
+              is_same<Compare, less<Comparable> >::value ||
+              is_same<Compare, ThreeWayCompare>::value )> NaturalOrder;
+
+  // Orders whole items by their keys, for the standard algorithms
+  struct ItemLess
+  {
+    const Compare *comp;
+
+    bool operator()( const Comparable & a, const Comparable & b ) const
+      { return ( *comp )( keyOf( a ), keyOf( b ) ); }
+  };
+
+  // A subtree left for a worker thread by the parallel buildTree
+  struct BuildJob
+  {
+    int low;
+    int high;
+    int depth;
+    BinaryNode<Comparable> **link;
+  };
+
+  // Keys order[ low.. high - 1 ] of a findBatch, or items
+  // [ low.. high - 1 ] of an insertBatch, to be looked up in the
+  // subtree rooted at t
+  struct Probe
+  {
+    BinaryNode<Comparable> *t;
+    size_t low;
+    size_t high;
+    int depth;      // Of t
+  };
+
+  void removeBatch( const KeyType *keys, size_t n, true_type );
+  void removeBatch( const KeyType *keys, size_t n, false_type );
+  template <class KeyAt, class Found>
+  void lookupBatch( KeyAt keyAt, size_t n, Found found ) const;
+  template <class Policy>
+  void insertSorted( const vector<Comparable> & batch, Policy );
+  void insertSorted( const vector<Comparable> & batch, UnbalancedPolicy );
+  void graft( const vector<Comparable> & batch, size_t low, size_t high,
+              BinaryNode<Comparable> *parent, BinaryNode<Comparable> * & link,
+              int depth );
+
+  void flatten( BinaryNode<Comparable> *t, vector<Comparable> & items ) const;
+  void absorb( const vector<Comparable> & items );
+  void sortUnique( vector<Comparable> & items ) const;
+  void buildTree( const vector<Comparable> & items );
+  BinaryNode<Comparable> * buildTree( const vector<Comparable> & items,
+                                      int low, int high,
+                                      int depth, int redDepth,
+                                      NodeAllocator<BinaryNode<Comparable> > & from );
+  void buildTop( const vector<Comparable> & items, int low, int high,
+                 int depth, int redDepth, int spawnDepth,
+                 BinaryNode<Comparable> **link, vector<BuildJob> & jobs,
+                 vector<BinaryNode<Comparable> *> & top );
+  template <class Source>
+  void importTree( Source & source, size_t n, int depth, int redDepth,
+                   BinaryNode<Comparable> **link,
+                   BinaryNode<Comparable> * & previous, bool & ok );
+  static int redLevel( size_t n );
+  static long long balancedDepthSum( size_t n );
+  static bool readFully( int fd, void *buffer, size_t bytes );
+  static bool writeFully( int fd, const void *buffer, size_t bytes );
+  void merge( SetOperation op, const vector<Comparable> & a,
+              const vector<Comparable> & b, vector<Comparable> & result ) const;
+  void mergeRange( SetOperation op, ItemIterator first1, ItemIterator last1,
+                   ItemIterator first2, ItemIterator last2,
+                   vector<Comparable> & result ) const;
+  int taskCount( size_t n ) const;
+  template <class Body>
+  static void parallelFor( int n, const Body & body );
+
+  void measure( ShapeMetrics & m ) const;
+
+  static bool sameShape( BinaryNode<Comparable> *a, BinaryNode<Comparable> *b );
+  static uint64_t mixHash( uint64_t h );
+  static uint64_t itemHash( const Comparable & x );
+  static uint64_t itemHash( const Comparable & x, true_type );
+  static uint64_t itemHash( const Comparable & x, false_type );
+
+  bool sameItem( const Comparable & a, const Comparable & b ) const;
+  bool sameItem( const Comparable & a, const Comparable & b, true_type ) const;
+  bool sameItem( const Comparable & a, const Comparable & b, false_type ) const;
+
+  const Comparable & elementAt( BinaryNode<Comparable> *t ) const;
+
+  static const KeyType & keyOf( const Comparable & x );
+  ItemLess itemLess( ) const;
+  static void requireMap( );
+  template <class... Args>
+  BinaryNode<Comparable> * findOrEmplace( const KeyType & k, bool & added,
+                                          Args &&... args );
+  void valueChanged( BinaryNode<Comparable> *t ) const;
+  static void requireSplay( );
+  template <class K>
+  int order( const K & x, const Comparable & item ) const;
+  template <class K>
+  int order( const K & x, const KeyType & key, true_type ) const;
+  template <class K>
+  int order( const K & x, const KeyType & key, false_type ) const;
+  
+  BinaryNode<Comparable> ** insertionPoint( const KeyType & x );
+  void attach( BinaryNode<Comparable> **link, BinaryNode<Comparable> *t );
+  void remove( const KeyType & x, BinaryNode<Comparable> * & t );
+  BinaryNode<Comparable> * findMin( BinaryNode<Comparable> *t ) const;
+  BinaryNode<Comparable> * findMax( BinaryNode<Comparable> *t ) const;
+  template <class K>
+  BinaryNode<Comparable> * find( const K & x, BinaryNode<Comparable> *t ) const;
+  template <class K>
+  int countBefore( const K & x ) const;
+  template <class K>
+  BinaryNode<Comparable> * lowerBound( const K & x ) const;
+  template <class K>
+  BinaryNode<Comparable> * upperBound( const K & x ) const;
+  BinaryNode<Comparable> * successor( BinaryNode<Comparable> *t ) const;
+  BinaryNode<Comparable> * predecessor( BinaryNode<Comparable> *t ) const;
+  void makeEmpty( BinaryNode<Comparable> * & t );
+  void printTree( BinaryNode<Comparable> *t ) const;
+
+
+  BinaryNode<Comparable> * clone( BinaryNode<Comparable> *t );
+  BinaryNode<Comparable> * newNode( const Comparable & x,
+                                    BinaryNode<Comparable> *lt,
+                                    BinaryNode<Comparable> *rt, int bal = 0 );
+  static BinaryNode<Comparable> * newNode( NodeAllocator<BinaryNode<Comparable> > & from,
+                                           const Comparable & x,
+                                           BinaryNode<Comparable> *lt,
+                                           BinaryNode<Comparable> *rt, int bal );
+  template <class... Args>
+  BinaryNode<Comparable> * emplaceNode( Args &&... args );
+  void deleteNode( BinaryNode<Comparable> *t );
+  static void adopt( BinaryNode<Comparable> *t );
+  static void copyCached( BinaryNode<Comparable> *to, BinaryNode<Comparable> *from );
+  void refreshUp( BinaryNode<Comparable> *t ) const;
+
+  int size(BinaryNode<Comparable> *t) const;
+
+  // Balancing, dispatched on BalancePolicy
+  void rebalanceInsert( UnbalancedPolicy );
+  void rebalanceInsert( AvlPolicy );
+  void rebalanceInsert( RedBlackPolicy );
+  void rebalanceRemove( BinaryNode<Comparable> *removed, UnbalancedPolicy );
+  void rebalanceRemove( BinaryNode<Comparable> *removed, AvlPolicy );
+  void rebalanceRemove( BinaryNode<Comparable> *removed, RedBlackPolicy );
+  void rebalanceInsert( SplayPolicy );
+  void rebalanceRemove( BinaryNode<Comparable> *removed, SplayPolicy );
+
+  // What find and access do to the node they found, dispatched on
+  // BalancePolicy
+  template <class Policy>
+  void hit( BinaryNode<Comparable> *, Policy ) const { }
+  void hit( BinaryNode<Comparable> *t, SplayPolicy ) const;
+  template <class Policy>
+  void accessed( BinaryNode<Comparable> *, Policy ) { }
+  void accessed( BinaryNode<Comparable> *t, SplayPolicy );
+  void splay( BinaryNode<Comparable> *t );
+  void rotateUp( BinaryNode<Comparable> *t );
+
+  void refresh( BinaryNode<Comparable> *t ) const;
+  void refresh( BinaryNode<Comparable> *t, UnbalancedPolicy ) const;
+  void refresh( BinaryNode<Comparable> *t, AvlPolicy ) const;
+  void refresh( BinaryNode<Comparable> *t, RedBlackPolicy ) const;
+  void refresh( BinaryNode<Comparable> *t, SplayPolicy ) const;
+  int height( BinaryNode<Comparable> *t ) const;
+  bool isRed( BinaryNode<Comparable> *t ) const;
+  void balance( BinaryNode<Comparable> * & t );
+  void rotateWithLeftChild( BinaryNode<Comparable> * & k2 ) const;
+  void rotateWithRightChild( BinaryNode<Comparable> * & k1 ) const;
+  void doubleWithLeftChild( BinaryNode<Comparable> * & k3 ) const;
+  void doubleWithRightChild( BinaryNode<Comparable> * & k1 ) const;
+
+  friend struct BinarySearchTreeTest;
+};
+
+#include "BinarySearchTree.cpp"
+#endif
@@ -0,0 +1,541 @@
+#include "CompactTree.h"
+#include "dsexceptions.h"
+#include <algorithm>
+
+using namespace std;
+
+/**
+ * Construct the tree.
+ */
+template <class Comparable>
+CompactTree<Comparable>::CompactTree( const Comparable & notFound ) :
+  root( NIL ), freeList( NIL ), theSize( 0 ), ITEM_NOT_FOUND( notFound )
+{
+  Node sentinel = { notFound, { NIL, NIL } };
+  nodes.push_back( sentinel );
+}
+
+/**
+ * Find item x in the tree.
+ * Return the matching item or ITEM_NOT_FOUND if not found.
+ */
+template <class Comparable>
+const Comparable & CompactTree<Comparable>::find( const Comparable & x ) const
+{
+  uint32_t t = root;
+  while( t != NIL )
+    {
+      const Comparable & e = nodes[ t ].element;
+      if( x < e )
+        t = child( t, LEFT );
+      else if( e < x )
+        t = child( t, RIGHT );
+      else
+        return e;    // Match
+    }
+  return ITEM_NOT_FOUND;
+}
+
+/**
+ * Find the smallest item in the tree.
+ * Return smallest item or ITEM_NOT_FOUND if empty.
+ */
+template <class Comparable>
+const Comparable & CompactTree<Comparable>::findMin( ) const
+{
+  if( root == NIL )
+    return ITEM_NOT_FOUND;
+  uint32_t t = root;
+  while( child( t, LEFT ) != NIL )
+    t = child( t, LEFT );
+  return nodes[ t ].element;
+}
+
+/**
+ * Find the largest item in the tree.
+ * Return the largest item or ITEM_NOT_FOUND if empty.
+ */
+template <class Comparable>
+const Comparable & CompactTree<Comparable>::findMax( ) const
+{
+  if( root == NIL )
+    return ITEM_NOT_FOUND;
+  uint32_t t = root;
+  while( child( t, RIGHT ) != NIL )
+    t = child( t, RIGHT );
+  return nodes[ t ].element;
+}
+
+/**
+ * Test if the tree is logically empty.
+ * Return true if empty, false otherwise.
+ */
+template <class Comparable>
+bool CompactTree<Comparable>::isEmpty( ) const
+{
+  return root == NIL;
+}
+
+/**
+ * Return the number of items in the tree.
+ */
+template <class Comparable>
+int CompactTree<Comparable>::size( ) const
+{
+  return theSize;
+}
+
+/**
+ * Print the tree contents in sorted order.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::printTree( ostream & out ) const
+{
+  if( isEmpty( ) )
+    out << "Empty tree" << endl;
+  else
+    printTree( root, out );
+}
+
+/**
+ * Make the tree logically empty. The slots stay allocated
+ * for reuse; shrinkToFit( ) releases them.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::makeEmpty( )
+{
+  nodes.erase( nodes.begin( ) + 1, nodes.end( ) );
+  root = NIL;
+  freeList = NIL;
+  theSize = 0;
+}
+
+/**
+ * Insert x into the tree; duplicates are ignored.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::insert( const Comparable & x )
+{
+  path.clear( );
+  int dir = LEFT;
+  for( uint32_t t = root; t != NIL; t = child( t, dir ) )
+    {
+      const Comparable & e = nodes[ t ].element;
+      if( x < e )
+        dir = LEFT;
+      else if( e < x )
+        dir = RIGHT;
+      else
+        return;    // Duplicate; do nothing
+      path.push_back( t );
+    }
+
+  // newNode may move the nodes, and x with them if it is one
+  // of our items, so x is not looked at again
+  uint32_t z = newNode( x );
+  if( path.empty( ) )
+    root = z;
+  else
+    setChild( path.back( ), dir, z );
+  path.push_back( z );
+  theSize++;
+  rebalanceInsert( );
+}
+
+/**
+ * Remove x from the tree. Nothing is done if x is not found.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::remove( const Comparable & x )
+{
+  path.clear( );
+  uint32_t t = root;
+  while( t != NIL )
+    {
+      const Comparable & e = nodes[ t ].element;
+      if( x < e )
+        {
+          path.push_back( t );
+          t = child( t, LEFT );
+        }
+      else if( e < x )
+        {
+          path.push_back( t );
+          t = child( t, RIGHT );
+        }
+      else
+        break;    // Match
+    }
+  if( t == NIL )
+    return;   // Item not found; do nothing
+
+  if( child( t, LEFT ) != NIL && child( t, RIGHT ) != NIL )
+    {
+      // Two children: take the successor's item and unlink it instead
+      path.push_back( t );
+      uint32_t s = child( t, RIGHT );
+      while( child( s, LEFT ) != NIL )
+        {
+          path.push_back( s );
+          s = child( s, LEFT );
+        }
+      nodes[ t ].element = nodes[ s ].element;
+      t = s;
+    }
+
+  uint32_t c = child( t, LEFT ) != NIL ? child( t, LEFT ) : child( t, RIGHT );
+  replace( path.empty( ) ? NIL : path.back( ), t, c );
+  bool wasRed = isRed( t );
+  freeNode( t );
+  theSize--;
+  if( !wasRed )
+    rebalanceRemove( c );
+}
+
+/**
+ * Replace the contents with items, given in any order;
+ * duplicates are dropped. Builds a balanced tree in linear
+ * time after sorting, with no spare slots.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::assign( vector<Comparable> items )
+{
+  sort( items.begin( ), items.end( ) );
+  items.erase( unique( items.begin( ), items.end( ),
+                       []( const Comparable & a, const Comparable & b )
+                         { return !( a < b ) && !( b < a ); } ),
+               items.end( ) );
+  if( items.size( ) > INDEX_MASK )
+    throw Overflow( );
+
+  vector<Node> fresh;
+  fresh.reserve( items.size( ) + 1 );
+  fresh.push_back( nodes[ 0 ] );
+  nodes.swap( fresh );
+  path.clear( );
+  freeList = NIL;
+  theSize = (int) items.size( );
+
+  // Color the deepest level red unless it is full,
+  // so every path has the same number of black nodes
+  int redDepth = 0;
+  for( size_t n = items.size( ); n > 1; n /= 2 )
+    redDepth++;
+  if( items.size( ) <= 1 )
+    redDepth = -1;
+  root = build( items, 0, items.size( ), 0, redDepth );
+  if( root != NIL )
+    setRed( root, false );
+}
+
+/**
+ * Append the items to items in sorted order.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::flatten( vector<Comparable> & items ) const
+{
+  items.reserve( items.size( ) + theSize );
+  flatten( root, items );
+}
+
+/**
+ * Call visit( item ) for each item in [lo, hi), in sorted order.
+ */
+template <class Comparable>
+template <class Visitor>
+void CompactTree<Comparable>::range( const Comparable & lo, const Comparable & hi,
+                                     Visitor visit ) const
+{
+  range( root, lo, hi, visit );
+}
+
+/**
+ * Make room for n items in all, so that inserting up to
+ * that many moves no nodes.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::reserve( size_t n )
+{
+  nodes.reserve( n + 1 );
+}
+
+/**
+ * Release spare capacity. If removals left freed slots behind,
+ * the tree is rebuilt without them.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::shrinkToFit( )
+{
+  if( freeList != NIL )
+    {
+      vector<Comparable> items;
+      flatten( items );
+      assign( items );
+    }
+  else
+    nodes.shrink_to_fit( );
+  path.shrink_to_fit( );
+}
+
+/**
+ * Return the number of bytes the tree holds, including spare
+ * and freed slots but not memory owned by the items themselves.
+ */
+template <class Comparable>
+size_t CompactTree<Comparable>::memoryUsage( ) const
+{
+  return sizeof( *this ) + nodes.capacity( ) * sizeof( Node )
+         + path.capacity( ) * sizeof( uint32_t );
+}
+
+/**
+ * Exchange contents with rhs in O(1). ITEM_NOT_FOUND is not exchanged.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::swap( CompactTree & rhs )
+{
+  nodes.swap( rhs.nodes );
+  path.swap( rhs.path );
+  std::swap( root, rhs.root );
+  std::swap( freeList, rhs.freeList );
+  std::swap( theSize, rhs.theSize );
+}
+
+/**
+ * Set or clear the red bit of node t.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::setRed( uint32_t t, bool red )
+{
+  if( red )
+    nodes[ t ].link[ LEFT ] |= RED_BIT;
+  else
+    nodes[ t ].link[ LEFT ] &= INDEX_MASK;
+}
+
+/**
+ * Return the index of a new red leaf holding x,
+ * reusing a freed slot if there is one.
+ */
+template <class Comparable>
+uint32_t CompactTree<Comparable>::newNode( const Comparable & x )
+{
+  uint32_t t;
+  if( freeList != NIL )
+    {
+      t = freeList;
+      freeList = nodes[ t ].link[ RIGHT ];
+      nodes[ t ].element = x;
+    }
+  else
+    {
+      if( nodes.size( ) > INDEX_MASK )
+        throw Overflow( );
+      Node n = { x, { NIL, NIL } };
+      t = (uint32_t) nodes.size( );
+      nodes.push_back( n );
+    }
+  nodes[ t ].link[ LEFT ] = RED_BIT | NIL;
+  nodes[ t ].link[ RIGHT ] = NIL;
+  return t;
+}
+
+/**
+ * Put slot t on the free list.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::freeNode( uint32_t t )
+{
+  nodes[ t ].element = ITEM_NOT_FOUND;
+  nodes[ t ].link[ LEFT ] = NIL;
+  nodes[ t ].link[ RIGHT ] = freeList;
+  freeList = t;
+}
+
+/**
+ * Rotate the subtree rooted at t towards dir: the child of t on
+ * the other side takes its place. Colors are left alone.
+ * Return the new root of the subtree; the caller relinks it.
+ */
+template <class Comparable>
+uint32_t CompactTree<Comparable>::rotate( uint32_t t, int dir )
+{
+  uint32_t r = child( t, 1 - dir );
+  setChild( t, 1 - dir, child( r, dir ) );
+  setChild( r, dir, t );
+  return r;
+}
+
+/**
+ * Make c the child of parent in place of t;
+ * parent NIL means t is the root.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::replace( uint32_t parent, uint32_t t, uint32_t c )
+{
+  if( parent == NIL )
+    root = c;
+  else
+    setChild( parent, child( parent, LEFT ) == t ? LEFT : RIGHT, c );
+}
+
+/**
+ * Restore the red-black rules after a red leaf was added.
+ * path runs from the root to the new leaf.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::rebalanceInsert( )
+{
+  size_t i = path.size( ) - 1;
+  while( i >= 2 && isRed( path[ i - 1 ] ) )
+    {
+      uint32_t z = path[ i ];
+      uint32_t p = path[ i - 1 ];
+      uint32_t g = path[ i - 2 ];
+      int side = child( g, LEFT ) == p ? LEFT : RIGHT;
+      uint32_t u = child( g, 1 - side );
+      if( isRed( u ) )
+        {
+          // Red uncle: push the red up and carry on from g
+          setRed( p, false );
+          setRed( u, false );
+          setRed( g, true );
+          i -= 2;
+          continue;
+        }
+      if( child( p, 1 - side ) == z )
+        {
+          p = rotate( p, side );
+          setChild( g, side, p );
+        }
+      uint32_t top = rotate( g, 1 - side );
+      replace( i >= 3 ? path[ i - 3 ] : NIL, g, top );
+      setRed( top, false );
+      setRed( g, true );
+      break;
+    }
+  setRed( root, false );
+}
+
+/**
+ * Restore the red-black rules after a black node was unlinked
+ * and x took its place. path holds the ancestors of x.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::rebalanceRemove( uint32_t x )
+{
+  size_t i = path.size( );    // The parent of x is path[ i - 1 ]
+  while( i > 0 && !isRed( x ) )
+    {
+      // x lacks a black node, so its sibling is never NIL;
+      // that tells the sides apart even when x is NIL
+      uint32_t p = path[ i - 1 ];
+      int side = child( p, LEFT ) == x ? LEFT : RIGHT;
+      uint32_t s = child( p, 1 - side );
+      if( isRed( s ) )
+        {
+          setRed( s, false );
+          setRed( p, true );
+          replace( i >= 2 ? path[ i - 2 ] : NIL, p, rotate( p, side ) );
+          path.insert( path.begin( ) + ( i - 1 ), s );
+          i++;
+          s = child( p, 1 - side );
+        }
+      if( !isRed( child( s, LEFT ) ) && !isRed( child( s, RIGHT ) ) )
+        {
+          setRed( s, true );
+          x = p;
+          i--;
+          continue;
+        }
+      if( !isRed( child( s, 1 - side ) ) )
+        {
+          setRed( child( s, side ), false );
+          setRed( s, true );
+          s = rotate( s, 1 - side );
+          setChild( p, 1 - side, s );
+        }
+      setRed( s, isRed( p ) );
+      setRed( p, false );
+      setRed( child( s, 1 - side ), false );
+      replace( i >= 2 ? path[ i - 2 ] : NIL, p, rotate( p, side ) );
+      x = root;
+      break;
+    }
+  if( x != NIL )
+    setRed( x, false );
+}
+
+/**
+ * Internal method to build a balanced subtree from sorted[ low, high ).
+ * Nodes are appended in preorder; those at redDepth are red.
+ * Return the index of the subtree root.
+ */
+template <class Comparable>
+uint32_t CompactTree<Comparable>::build( const vector<Comparable> & sorted,
+                                         size_t low, size_t high,
+                                         int depth, int redDepth )
+{
+  if( low >= high )
+    return NIL;
+  size_t mid = low + ( high - low ) / 2;
+  uint32_t t = (uint32_t) nodes.size( );
+  Node n = { sorted[ mid ], { depth == redDepth ? RED_BIT : 0u, NIL } };
+  nodes.push_back( n );
+  uint32_t left = build( sorted, low, mid, depth + 1, redDepth );
+  uint32_t right = build( sorted, mid + 1, high, depth + 1, redDepth );
+  setChild( t, LEFT, left );
+  setChild( t, RIGHT, right );
+  return t;
+}
+
+/**
+ * Internal method to append the items of subtree t to items in order.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::flatten( uint32_t t, vector<Comparable> & items ) const
+{
+  for( ; t != NIL; t = child( t, RIGHT ) )
+    {
+      flatten( child( t, LEFT ), items );
+      items.push_back( nodes[ t ].element );
+    }
+}
+
+/**
+ * Internal method to print subtree t in sorted order.
+ */
+template <class Comparable>
+void CompactTree<Comparable>::printTree( uint32_t t, ostream & out ) const
+{
+  for( ; t != NIL; t = child( t, RIGHT ) )
+    {
+      printTree( child( t, LEFT ), out );
+      out << nodes[ t ].element << endl;
+    }
+}
+
+/**
+ * Internal method to visit the items of subtree t in [lo, hi).
+ * Subtrees entirely outside the range are skipped.
+ */
+template <class Comparable>
+template <class Visitor>
+void CompactTree<Comparable>::range( uint32_t t, const Comparable & lo,
+                                     const Comparable & hi, Visitor & visit ) const
+{
+  while( t != NIL )
+    {
+      const Comparable & e = nodes[ t ].element;
+      if( e < lo )
+        t = child( t, RIGHT );
+      else if( !( e < hi ) )
+        t = child( t, LEFT );
+      else
+        {
+          range( child( t, LEFT ), lo, hi, visit );
+          visit( e );
+          t = child( t, RIGHT );
+        }
+    }
+}
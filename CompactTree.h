@@ -0,0 +1,117 @@
+#ifndef COMPACT_TREE_H_
+#define COMPACT_TREE_H_
+
+#include <cstddef>
+#include <iostream>
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+// CompactTree class
+//
+// CONSTRUCTION: with ITEM_NOT_FOUND object used to signal failed finds
+//
+// A red-black tree whose nodes live in one vector and name their
+// children by 32-bit index instead of by pointer. A node is just
+// the item and two indices, 12 bytes for an int against 40 for a
+// BinarySearchTree node, and the color is kept in the top bit of
+// the left index. Slot 0 stands for the empty subtree. There are no
+// parent indices or subtree counts: insert and remove remember the
+// path they walked, and rank/select are not offered. Freed slots
+// are chained into a free list and reused by later inserts.
+//
+// assign( ) builds a balanced tree straight from sorted items, laid
+// out in preorder so that a search walks forward through the vector.
+// Together with reserve( ), it leaves no spare capacity behind.
+// At most 2^31 - 1 items can be held; inserting more throws Overflow.
+//
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x )       --> Insert x
+// void remove( x )       --> Remove x
+// Comparable find( x )   --> Return item that matches x
+// Comparable findMin( )  --> Return smallest item
+// Comparable findMax( )  --> Return largest item
+// boolean isEmpty( )     --> Return true if empty; else false
+// void makeEmpty( )      --> Remove all items
+// int size( )            --> Return number of items
+// void assign( items )   --> Replace contents with items, in any order
+// void flatten( items )  --> Append the items to items in sorted order
+// void range( lo, hi, f )   --> Call f( item ) for each item in [lo, hi)
+// void reserve( n )      --> Make room for n items without reallocating
+// void shrinkToFit( )    --> Release spare and freed slots
+// size_t memoryUsage( )  --> Return bytes held by the tree
+// void swap( rhs )       --> Exchange contents with rhs, in O(1)
+// void printTree( )      --> Print tree in sorted order
+
+template <class Comparable>
+class CompactTree
+{
+ public:
+  explicit CompactTree( const Comparable & notFound );
+
+  const Comparable & find( const Comparable & x ) const;
+  const Comparable & findMin( ) const;
+  const Comparable & findMax( ) const;
+  bool isEmpty( ) const;
+  int size( ) const;
+  void printTree( ostream & out = cout ) const;
+
+  void makeEmpty( );
+  void insert( const Comparable & x );
+  void remove( const Comparable & x );
+  void assign( vector<Comparable> items );
+  void flatten( vector<Comparable> & items ) const;
+  template <class Visitor>
+  void range( const Comparable & lo, const Comparable & hi, Visitor visit ) const;
+
+  void reserve( size_t n );
+  void shrinkToFit( );
+  size_t memoryUsage( ) const;
+  void swap( CompactTree & rhs );
+
+ private:
+  struct Node
+  {
+    Comparable element;
+    uint32_t link[ 2 ];     // Left and right child; top bit of link[ 0 ] is red
+  };
+
+  enum { LEFT = 0, RIGHT = 1 };
+  static const uint32_t NIL = 0;
+  static const uint32_t RED_BIT = 0x80000000u;
+  static const uint32_t INDEX_MASK = 0x7fffffffu;
+
+  vector<Node> nodes;       // nodes[ 0 ] is the empty subtree
+  uint32_t root;
+  uint32_t freeList;        // Freed slots, chained through link[ 1 ]
+  int theSize;
+  vector<uint32_t> path;    // Scratch for insert and remove
+  Comparable ITEM_NOT_FOUND;
+
+  uint32_t child( uint32_t t, int dir ) const
+    { return nodes[ t ].link[ dir ] & INDEX_MASK; }
+  void setChild( uint32_t t, int dir, uint32_t c )
+    { nodes[ t ].link[ dir ] = ( nodes[ t ].link[ dir ] & RED_BIT ) | c; }
+  bool isRed( uint32_t t ) const
+    { return ( nodes[ t ].link[ LEFT ] & RED_BIT ) != 0; }
+  void setRed( uint32_t t, bool red );
+
+  uint32_t newNode( const Comparable & x );
+  void freeNode( uint32_t t );
+  uint32_t rotate( uint32_t t, int dir );
+  void replace( uint32_t parent, uint32_t t, uint32_t c );
+  void rebalanceInsert( );
+  void rebalanceRemove( uint32_t x );
+  uint32_t build( const vector<Comparable> & sorted, size_t low, size_t high,
+                  int depth, int redDepth );
+  void flatten( uint32_t t, vector<Comparable> & items ) const;
+  void printTree( uint32_t t, ostream & out ) const;
+
+  template <class Visitor>
+  void range( uint32_t t, const Comparable & lo, const Comparable & hi,
+              Visitor & visit ) const;
+};
+
+#include "CompactTree.cpp"
+#endif
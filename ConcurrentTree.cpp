@@ -0,0 +1,424 @@
+#include "ConcurrentTree.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Construct a node; its height and count follow from lt and rt.
+ */
+template <class Comparable>
+ConcurrentTree<Comparable>::Node::Node( const Comparable & theElement,
+                                        const Node *lt, const Node *rt ) :
+  element( theElement ), left( lt ), right( rt ),
+  height( max( ConcurrentTree::height( lt ), ConcurrentTree::height( rt ) ) + 1 ),
+  count( ConcurrentTree::size( lt ) + ConcurrentTree::size( rt ) + 1 )
+{
+}
+
+/**
+ * Construct the tree.
+ */
+template <class Comparable>
+ConcurrentTree<Comparable>::ConcurrentTree( const Comparable & notFound ) :
+  root( NULL ), ITEM_NOT_FOUND( notFound )
+{
+}
+
+/**
+ * Destructor for the tree. No other thread may be using it.
+ */
+template <class Comparable>
+ConcurrentTree<Comparable>::~ConcurrentTree( )
+{
+  if( root.load( ) != NULL )
+    destroyTree( (void *) root.load( ) );
+}
+
+/**
+ * Find item x in the tree.
+ * Return a copy of the matching item or ITEM_NOT_FOUND if not found.
+ */
+template <class Comparable>
+Comparable ConcurrentTree<Comparable>::find( const Comparable & x ) const
+{
+  EpochReclaimer::Guard guard;
+  const Node *t = root.load( );
+
+  while( t != NULL )
+    {
+      if( x < t->element )
+        t = t->left;
+      else if( t->element < x )
+        t = t->right;
+      else
+        return t->element;    // Match
+    }
+  return ITEM_NOT_FOUND;   // No match
+}
+
+/**
+ * Find the smallest item in the tree.
+ * Return a copy of it or ITEM_NOT_FOUND if empty.
+ */
+template <class Comparable>
+Comparable ConcurrentTree<Comparable>::findMin( ) const
+{
+  EpochReclaimer::Guard guard;
+  const Node *t = root.load( );
+
+  if( t == NULL )
+    return ITEM_NOT_FOUND;
+  while( t->left != NULL )
+    t = t->left;
+  return t->element;
+}
+
+/**
+ * Find the largest item in the tree.
+ * Return a copy of it or ITEM_NOT_FOUND if empty.
+ */
+template <class Comparable>
+Comparable ConcurrentTree<Comparable>::findMax( ) const
+{
+  EpochReclaimer::Guard guard;
+  const Node *t = root.load( );
+
+  if( t == NULL )
+    return ITEM_NOT_FOUND;
+  while( t->right != NULL )
+    t = t->right;
+  return t->element;
+}
+
+/**
+ * Test if the tree is logically empty.
+ * Return true if empty, false otherwise.
+ */
+template <class Comparable>
+bool ConcurrentTree<Comparable>::isEmpty( ) const
+{
+  return root.load( ) == NULL;
+}
+
+/**
+ * Return the number of items, in constant time.
+ */
+template <class Comparable>
+int ConcurrentTree<Comparable>::size( ) const
+{
+  EpochReclaimer::Guard guard;
+
+  return size( root.load( ) );
+}
+
+/**
+ * Print the tree contents in sorted order.
+ */
+template <class Comparable>
+void ConcurrentTree<Comparable>::printTree( ) const
+{
+  if( isEmpty( ) )
+    cout << "Empty tree" << endl;
+  else
+    forEach( []( const Comparable & x ) { cout << x << " "; } );
+}
+
+/**
+ * Call visit( item ) for each item in sorted order.
+ */
+template <class Comparable>
+template <class Visitor>
+void ConcurrentTree<Comparable>::forEach( Visitor visit ) const
+{
+  EpochReclaimer::Guard guard;
+  vector<const Node *> stack;
+  const Node *t = root.load( );
+
+  while( t != NULL || !stack.empty( ) )
+    {
+      if( t != NULL )
+        {
+          stack.push_back( t );
+          t = t->left;
+        }
+      else
+        {
+          t = stack.back( );
+          stack.pop_back( );
+          visit( t->element );
+          t = t->right;
+        }
+    }
+}
+
+/**
+ * Call visit( item ) for each item in [lo, hi), in sorted order.
+ * Subtrees entirely below lo are skipped.
+ */
+template <class Comparable>
+template <class Visitor>
+void ConcurrentTree<Comparable>::range( const Comparable & lo, const Comparable & hi,
+                                        Visitor visit ) const
+{
+  EpochReclaimer::Guard guard;
+  vector<const Node *> stack;
+  const Node *t = root.load( );
+
+  // The stack holds the ancestors of the next item not less than lo
+  while( t != NULL )
+    {
+      if( t->element < lo )
+        t = t->right;
+      else
+        {
+          stack.push_back( t );
+          t = t->left;
+        }
+    }
+  while( !stack.empty( ) )
+    {
+      t = stack.back( );
+      stack.pop_back( );
+      if( !( t->element < hi ) )
+        return;
+      visit( t->element );
+      for( t = t->right; t != NULL; t = t->left )
+        stack.push_back( t );
+    }
+}
+
+/**
+ * Make the tree logically empty. The old nodes are retired
+ * together and freed once no reader can see them.
+ */
+template <class Comparable>
+void ConcurrentTree<Comparable>::makeEmpty( )
+{
+  lock_guard<mutex> lock( writeLock );
+  const Node *oldRoot = root.load( );
+
+  if( oldRoot != NULL )
+    {
+      root.store( NULL );
+      EpochReclaimer::instance( ).retire( (void *) oldRoot, destroyTree );
+    }
+}
+
+/**
+ * Insert x into the tree; duplicates are ignored.
+ */
+template <class Comparable>
+void ConcurrentTree<Comparable>::insert( const Comparable & x )
+{
+  lock_guard<mutex> lock( writeLock );
+  const Node *oldRoot = root.load( );
+
+  replaced.clear( );
+  const Node *newRoot = insert( x, oldRoot );
+  if( newRoot != oldRoot )
+    publish( newRoot );
+}
+
+/**
+ * Remove x from the tree. Nothing is done if x is not found.
+ */
+template <class Comparable>
+void ConcurrentTree<Comparable>::remove( const Comparable & x )
+{
+  lock_guard<mutex> lock( writeLock );
+  const Node *oldRoot = root.load( );
+
+  replaced.clear( );
+  const Node *newRoot = remove( x, oldRoot );
+  if( newRoot != oldRoot )
+    publish( newRoot );
+}
+
+/**
+ * Internal method to insert into a subtree.
+ * x is the item to insert.
+ * t is the node that roots the subtree.
+ * Return the root of the new version of the subtree, which is t
+ * itself if x was already present.
+ */
+template <class Comparable>
+const typename ConcurrentTree<Comparable>::Node *
+ConcurrentTree<Comparable>::insert( const Comparable & x, const Node *t )
+{
+  if( t == NULL )
+    return new Node( x, NULL, NULL );
+  if( x < t->element )
+    {
+      const Node *lt = insert( x, t->left );
+      return lt == t->left ? t : copy( t, lt, t->right );
+    }
+  if( t->element < x )
+    {
+      const Node *rt = insert( x, t->right );
+      return rt == t->right ? t : copy( t, t->left, rt );
+    }
+  return t;  // Duplicate; do nothing
+}
+
+/**
+ * Internal method to remove from a subtree.
+ * x is the item to remove.
+ * t is the node that roots the subtree.
+ * Return the root of the new version of the subtree, which is t
+ * itself if x was not found.
+ */
+template <class Comparable>
+const typename ConcurrentTree<Comparable>::Node *
+ConcurrentTree<Comparable>::remove( const Comparable & x, const Node *t )
+{
+  if( t == NULL )
+    return NULL;   // Item not found; do nothing
+  if( x < t->element )
+    {
+      const Node *lt = remove( x, t->left );
+      return lt == t->left ? t : copy( t, lt, t->right );
+    }
+  if( t->element < x )
+    {
+      const Node *rt = remove( x, t->right );
+      return rt == t->right ? t : copy( t, t->left, rt );
+    }
+
+  replaced.push_back( t );
+  if( t->left == NULL )
+    return t->right;
+  if( t->right == NULL )
+    return t->left;
+
+  // Two children: the successor takes t's place
+  const Node *min;
+  const Node *rt = removeMin( t->right, min );
+  return balance( min->element, t->left, rt );
+}
+
+/**
+ * Internal method to remove the smallest node of subtree t,
+ * which must not be empty, and return it in min.
+ * Return the root of the new version of the subtree.
+ */
+template <class Comparable>
+const typename ConcurrentTree<Comparable>::Node *
+ConcurrentTree<Comparable>::removeMin( const Node *t, const Node * & min )
+{
+  replaced.push_back( t );
+  if( t->left == NULL )
+    {
+      min = t;
+      return t->right;
+    }
+  const Node *lt = removeMin( t->left, min );
+  return balance( t->element, lt, t->right );
+}
+
+/**
+ * Internal method to replace node t by a copy with children lt
+ * and rt, rebalanced.
+ */
+template <class Comparable>
+const typename ConcurrentTree<Comparable>::Node *
+ConcurrentTree<Comparable>::copy( const Node *t, const Node *lt, const Node *rt )
+{
+  replaced.push_back( t );
+  return balance( t->element, lt, rt );
+}
+
+/**
+ * Internal method to build a node holding x over subtrees lt and
+ * rt, whose heights differ by at most two, restoring the AVL
+ * condition. Nodes taken apart by a rotation are replaced.
+ */
+template <class Comparable>
+const typename ConcurrentTree<Comparable>::Node *
+ConcurrentTree<Comparable>::balance( const Comparable & x, const Node *lt, const Node *rt )
+{
+  if( height( lt ) - height( rt ) > 1 )
+    {
+      replaced.push_back( lt );
+      if( height( lt->left ) >= height( lt->right ) )
+        return new Node( lt->element, lt->left, new Node( x, lt->right, rt ) );
+
+      const Node *mid = lt->right;
+      replaced.push_back( mid );
+      return new Node( mid->element, new Node( lt->element, lt->left, mid->left ),
+                       new Node( x, mid->right, rt ) );
+    }
+  if( height( rt ) - height( lt ) > 1 )
+    {
+      replaced.push_back( rt );
+      if( height( rt->right ) >= height( rt->left ) )
+        return new Node( rt->element, new Node( x, lt, rt->left ), rt->right );
+
+      const Node *mid = rt->left;
+      replaced.push_back( mid );
+      return new Node( mid->element, new Node( x, lt, mid->left ),
+                       new Node( rt->element, mid->right, rt->right ) );
+    }
+  return new Node( x, lt, rt );
+}
+
+/**
+ * Internal method to make newRoot the tree seen by readers and
+ * retire the nodes the write replaced.
+ */
+template <class Comparable>
+void ConcurrentTree<Comparable>::publish( const Node *newRoot )
+{
+  root.store( newRoot );
+  for( size_t i = 0; i < replaced.size( ); i++ )
+    EpochReclaimer::instance( ).retire( (void *) replaced[ i ], destroy );
+  replaced.clear( );
+}
+
+/**
+ * Return the height of node t or -1 if NULL.
+ */
+template <class Comparable>
+int ConcurrentTree<Comparable>::height( const Node *t )
+{
+  return t == NULL ? -1 : t->height;
+}
+
+/**
+ * Return the number of nodes in subtree t or 0 if NULL.
+ */
+template <class Comparable>
+int ConcurrentTree<Comparable>::size( const Node *t )
+{
+  return t == NULL ? 0 : t->count;
+}
+
+/**
+ * Internal method to free one retired node.
+ */
+template <class Comparable>
+void ConcurrentTree<Comparable>::destroy( void *p )
+{
+  delete static_cast<const Node *>( p );
+}
+
+/**
+ * Internal method to free the subtree rooted at p.
+ */
+template <class Comparable>
+void ConcurrentTree<Comparable>::destroyTree( void *p )
+{
+  vector<const Node *> stack( 1, static_cast<const Node *>( p ) );
+
+  while( !stack.empty( ) )
+    {
+      const Node *t = stack.back( );
+      stack.pop_back( );
+      if( t->left != NULL )
+        stack.push_back( t->left );
+      if( t->right != NULL )
+        stack.push_back( t->right );
+      delete t;
+    }
+}
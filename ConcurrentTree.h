@@ -0,0 +1,106 @@
+#ifndef CONCURRENT_TREE_H_
+#define CONCURRENT_TREE_H_
+
+#include "EpochReclaimer.h"
+#include <atomic>
+#include <iostream>       // For NULL
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+// ConcurrentTree class
+//
+// CONSTRUCTION: with ITEM_NOT_FOUND object used to signal failed finds
+//
+// A thread-safe AVL tree for read-mostly workloads. Published nodes
+// are never modified: a writer copies the path from the root to the
+// change, links the copies to the untouched subtrees, and swaps the
+// new root in with one atomic store. Readers therefore take no locks
+// and never wait; each sees the whole tree as of some single write.
+// Writers are serialized by a mutex. Replaced nodes are freed by the
+// EpochReclaimer once no reader can still be walking them.
+//
+// Lookups return copies, since the nodes they find may be freed as
+// soon as the call returns.
+//
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x )       --> Insert x
+// void remove( x )       --> Remove x
+// Comparable find( x )   --> Return item that matches x
+// Comparable findMin( )  --> Return smallest item
+// Comparable findMax( )  --> Return largest item
+// boolean isEmpty( )     --> Return true if empty; else false
+// int size( )            --> Return number of items
+// void makeEmpty( )      --> Remove all items
+// void printTree( )      --> Print tree in sorted order
+// void forEach( f )      --> Call f( item ) for each item in sorted order
+// void range( lo, hi, f )   --> Call f( item ) for each item in [lo, hi)
+//
+// forEach and range see one consistent version of the tree; memory
+// retired while they run is kept until they return.
+// ******************ERRORS********************************
+// The lookups and walks pin the EpochReclaimer while they run, so
+// they throw Overflow if EpochReclaimer::MAX_THREADS other threads
+// are pinned at that moment, in any ConcurrentTree; threads that
+// have returned do not count
+
+template <class Comparable>
+class ConcurrentTree
+{
+ public:
+  explicit ConcurrentTree( const Comparable & notFound );
+  ~ConcurrentTree( );
+
+  Comparable find( const Comparable & x ) const;
+  Comparable findMin( ) const;
+  Comparable findMax( ) const;
+  bool isEmpty( ) const;
+  int size( ) const;
+  void printTree( ) const;
+  template <class Visitor>
+  void forEach( Visitor visit ) const;
+  template <class Visitor>
+  void range( const Comparable & lo, const Comparable & hi, Visitor visit ) const;
+
+  void makeEmpty( );
+  void insert( const Comparable & x );
+  void remove( const Comparable & x );
+
+ private:
+  struct Node
+  {
+    const Comparable element;
+    const Node * const left;
+    const Node * const right;
+    const int height;
+    const int count;      // Nodes in the subtree rooted here
+
+    Node( const Comparable & theElement, const Node *lt, const Node *rt );
+  };
+
+  atomic<const Node *> root;
+  const Comparable ITEM_NOT_FOUND;
+  mutex writeLock;
+
+  // Nodes replaced by the current write, retired once it is published
+  vector<const Node *> replaced;
+
+  ConcurrentTree( const ConcurrentTree & rhs );
+  const ConcurrentTree & operator=( const ConcurrentTree & rhs );
+
+  const Node * insert( const Comparable & x, const Node *t );
+  const Node * remove( const Comparable & x, const Node *t );
+  const Node * removeMin( const Node *t, const Node * & min );
+  const Node * balance( const Comparable & x, const Node *lt, const Node *rt );
+  const Node * copy( const Node *t, const Node *lt, const Node *rt );
+  void publish( const Node *newRoot );
+
+  static int height( const Node *t );
+  static int size( const Node *t );
+  static void destroy( void *p );
+  static void destroyTree( void *p );
+};
+
+#include "ConcurrentTree.cpp"
+#endif
@@ -0,0 +1,156 @@
+#include "EpochReclaimer.h"
+#include "dsexceptions.h"
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Per-thread pinning state. The slot is claimed by the outermost
+ * enter( ) and handed back by the matching leave( ); a thread that
+ * is not pinned holds none.
+ */
+struct EpochThreadState
+{
+  int slot;       // Held while depth > 0; else the last one held, or -1
+  int depth;      // Nesting of enter( ) calls
+
+  EpochThreadState( ) : slot( -1 ), depth( 0 ) { }
+};
+
+static thread_local EpochThreadState threadState;
+
+/**
+ * Return the process-wide reclaimer.
+ */
+EpochReclaimer & EpochReclaimer::instance( )
+{
+  static EpochReclaimer theReclaimer;
+
+  return theReclaimer;
+}
+
+/**
+ * Construct the reclaimer with every slot free.
+ */
+EpochReclaimer::EpochReclaimer( ) : global( 1 )
+{
+  for( int i = 0; i < MAX_THREADS; i++ )
+    {
+      slots[ i ].epoch.store( IDLE );
+      slots[ i ].claimed.store( false );
+    }
+}
+
+/**
+ * Free everything still retired; no reader is left at exit.
+ */
+EpochReclaimer::~EpochReclaimer( )
+{
+  for( size_t i = 0; i < retired.size( ); i++ )
+    retired[ i ].destroy( retired[ i ].p );
+}
+
+/**
+ * Pin the current epoch for this thread. Memory retired from now
+ * on stays allocated until the matching leave( ).
+ * The stores are sequentially consistent, so the pin is visible to
+ * collect( ) before this thread reads any shared pointer.
+ * Throws Overflow if MAX_THREADS other threads are pinned.
+ */
+void EpochReclaimer::enter( )
+{
+  if( threadState.depth == 0 )
+    {
+      threadState.slot = claimSlot( threadState.slot );
+      slots[ threadState.slot ].epoch.store( global.load( ) );
+    }
+  threadState.depth++;
+}
+
+/**
+ * Undo one enter( ); the outermost one unpins the thread and gives
+ * its slot back.
+ */
+void EpochReclaimer::leave( )
+{
+  if( --threadState.depth == 0 )
+    {
+      Slot & mine = slots[ threadState.slot ];
+      mine.epoch.store( IDLE, memory_order_release );
+      mine.claimed.store( false, memory_order_release );
+    }
+}
+
+/**
+ * Arrange for destroy( p ) to be called once no reader pinned now
+ * can still reach p. p must already be unreachable for new readers.
+ */
+void EpochReclaimer::retire( void *p, void ( *destroy )( void * ) )
+{
+  bool due;
+  {
+    lock_guard<mutex> lock( retireLock );
+    Retired r = { p, destroy, global.fetch_add( 1 ) };
+    retired.push_back( r );
+    due = retired.size( ) % COLLECT_INTERVAL == 0;
+  }
+  if( due )
+    collect( );
+}
+
+/**
+ * Free the retired memory that every pinned reader has moved past.
+ */
+void EpochReclaimer::collect( )
+{
+  vector<Retired> done;
+  {
+    lock_guard<mutex> lock( retireLock );
+    unsigned long oldest = oldestPinned( );
+    vector<Retired>::iterator keep =
+      partition( retired.begin( ), retired.end( ),
+                 [oldest]( const Retired & r ) { return r.epoch >= oldest; } );
+    done.assign( keep, retired.end( ) );
+    retired.erase( keep, retired.end( ) );
+  }
+  for( size_t i = 0; i < done.size( ); i++ )
+    done[ i ].destroy( done[ i ].p );
+}
+
+/**
+ * Internal method to claim a free slot for the calling thread,
+ * trying slot hint first; its cache line is most likely still
+ * this thread's. A negative hint starts at slot 0.
+ * Throws Overflow if all MAX_THREADS slots are taken.
+ */
+int EpochReclaimer::claimSlot( int hint )
+{
+  int first = hint < 0 ? 0 : hint;
+
+  for( int k = 0; k < MAX_THREADS; k++ )
+    {
+      int i = ( first + k ) % MAX_THREADS;
+      bool expected = false;
+      if( slots[ i ].claimed.compare_exchange_strong( expected, true ) )
+        return i;
+    }
+  throw Overflow( );
+}
+
+/**
+ * Internal method to return the oldest epoch pinned by any reader,
+ * or the current epoch if none is pinned.
+ */
+unsigned long EpochReclaimer::oldestPinned( ) const
+{
+  unsigned long oldest = global.load( );
+
+  for( int i = 0; i < MAX_THREADS; i++ )
+    {
+      unsigned long pinned = slots[ i ].epoch.load( );
+      if( pinned != IDLE && pinned < oldest )
+        oldest = pinned;
+    }
+  return oldest;
+}
@@ -0,0 +1,93 @@
+#ifndef EPOCH_RECLAIMER_H_
+#define EPOCH_RECLAIMER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+// EpochReclaimer class
+//
+// CONSTRUCTION: none; use the process-wide instance( )
+//
+// Epoch-based memory reclamation for structures whose readers take
+// no locks. A reader pins the current epoch for as long as it may
+// hold pointers into the structure (see Guard). A writer that
+// unlinks memory retires it instead of freeing it; the memory is
+// freed once every reader pinned at the time of the retire has left.
+//
+// A thread holds one of MAX_THREADS cache-line sized slots only
+// while it is pinned: the outermost enter( ) claims one, trying the
+// slot it had last time first, and the matching leave( ) gives it
+// back. Any number of threads may therefore use the reclaimer, as
+// long as no more than MAX_THREADS of them are pinned at once.
+// Pinning is reentrant and costs a compare-and-swap and two atomic
+// stores; readers never wait.
+//
+// ******************PUBLIC OPERATIONS*********************
+// void enter( )          --> Pin the current epoch for this thread
+// void leave( )          --> Undo one enter( )
+// void retire( p, f )    --> Call f( p ) once no reader can see p
+// void collect( )        --> Free what no reader can see any more
+// Guard                  --> enter( ) for the lifetime of a scope
+// ******************ERRORS********************************
+// Overflow is thrown by enter( ) when MAX_THREADS other threads are
+// pinned at that moment
+
+class EpochReclaimer
+{
+ public:
+  class Guard
+  {
+   public:
+    Guard( ) { instance( ).enter( ); }
+    ~Guard( ) { instance( ).leave( ); }
+
+   private:
+    Guard( const Guard & );
+    const Guard & operator=( const Guard & );
+  };
+
+  static EpochReclaimer & instance( );
+
+  void enter( );
+  void leave( );
+  void retire( void *p, void ( *destroy )( void * ) );
+  void collect( );
+
+  enum { MAX_THREADS = 256 };
+
+ private:
+  EpochReclaimer( );
+  ~EpochReclaimer( );
+
+  enum { IDLE = 0 };                 // Slot epoch of a thread not pinned
+  enum { COLLECT_INTERVAL = 64 };    // Retires between collections
+
+  struct alignas( 64 ) Slot
+  {
+    atomic<unsigned long> epoch;     // Pinned epoch or IDLE
+    atomic<bool> claimed;
+  };
+
+  struct Retired
+  {
+    void *p;
+    void ( *destroy )( void * );
+    unsigned long epoch;             // Global epoch when retired
+  };
+
+  Slot slots[ MAX_THREADS ];
+  atomic<unsigned long> global;      // Starts at 1; never IDLE
+  mutex retireLock;
+  vector<Retired> retired;
+
+  int claimSlot( int hint );
+  unsigned long oldestPinned( ) const;
+
+  friend struct EpochThreadState;
+};
+
+#endif
@@ -0,0 +1,446 @@
+#include "FrozenTree.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define FROZEN_TREE_MMAP 1
+#endif
+
+using namespace std;
+
+/**
+ * Construct an empty snapshot.
+ */
+template <class Comparable>
+FrozenTree<Comparable>::FrozenTree( const Comparable & notFound ) :
+  FrozenTree( notFound, vector<Comparable>( ) )
+{
+}
+
+/**
+ * Construct the snapshot from sorted, duplicate-free items.
+ */
+template <class Comparable>
+FrozenTree<Comparable>::FrozenTree( const Comparable & notFound,
+                                    const vector<Comparable> & sorted ) :
+  count( sorted.size( ) ), header( NULL ), ITEM_NOT_FOUND( notFound )
+{
+  shared_ptr<vector<Comparable> > array =
+    make_shared<vector<Comparable> >( sorted.size( ) + 1, notFound );
+
+  fill( sorted, *array, 0, 1 );
+  storage = array;
+  slots = array->data( );
+}
+
+/**
+ * Find item x in the snapshot.
+ * Return the matching item or ITEM_NOT_FOUND if not found.
+ */
+template <class Comparable>
+const Comparable & FrozenTree<Comparable>::find( const Comparable & x ) const
+{
+  size_t k = lowerBound( x );
+
+  if( k == 0 || x < slots[ k ] )
+    return ITEM_NOT_FOUND;
+  return slots[ k ];
+}
+
+/**
+ * Find the smallest item.
+ * Return smallest item or ITEM_NOT_FOUND if empty.
+ */
+template <class Comparable>
+const Comparable & FrozenTree<Comparable>::findMin( ) const
+{
+  return isEmpty( ) ? ITEM_NOT_FOUND : slots[ first( 1 ) ];
+}
+
+/**
+ * Find the largest item.
+ * Return the largest item or ITEM_NOT_FOUND if empty.
+ */
+template <class Comparable>
+const Comparable & FrozenTree<Comparable>::findMax( ) const
+{
+  return isEmpty( ) ? ITEM_NOT_FOUND : slots[ last( 1 ) ];
+}
+
+/**
+ * Test if the snapshot is empty.
+ */
+template <class Comparable>
+bool FrozenTree<Comparable>::isEmpty( ) const
+{
+  return count == 0;
+}
+
+/**
+ * Return the number of items.
+ */
+template <class Comparable>
+int FrozenTree<Comparable>::size( ) const
+{
+  return (int) count;
+}
+
+/**
+ * Return an iterator to the smallest item.
+ */
+template <class Comparable>
+typename FrozenTree<Comparable>::const_iterator
+FrozenTree<Comparable>::begin( ) const
+{
+  return const_iterator( this, isEmpty( ) ? 0 : first( 1 ) );
+}
+
+/**
+ * Return the past-the-end iterator.
+ */
+template <class Comparable>
+typename FrozenTree<Comparable>::const_iterator
+FrozenTree<Comparable>::end( ) const
+{
+  return const_iterator( this, 0 );
+}
+
+/**
+ * Return an iterator to the smallest item not less than x,
+ * or end( ) if there is none.
+ */
+template <class Comparable>
+typename FrozenTree<Comparable>::const_iterator
+FrozenTree<Comparable>::lower_bound( const Comparable & x ) const
+{
+  return const_iterator( this, lowerBound( x ) );
+}
+
+/**
+ * Return an iterator to the smallest item greater than x,
+ * or end( ) if there is none.
+ */
+template <class Comparable>
+typename FrozenTree<Comparable>::const_iterator
+FrozenTree<Comparable>::upper_bound( const Comparable & x ) const
+{
+  size_t k = lowerBound( x );
+
+  if( k != 0 && !( x < slots[ k ] ) )
+    k = successor( k );
+  return const_iterator( this, k );
+}
+
+/**
+ * Call visit( item ) for each item in [lo, hi), in sorted order.
+ */
+template <class Comparable>
+template <class Visitor>
+void FrozenTree<Comparable>::range( const Comparable & lo, const Comparable & hi,
+                                    Visitor visit ) const
+{
+  for( size_t k = lowerBound( lo ); k != 0 && slots[ k ] < hi; k = successor( k ) )
+    visit( slots[ k ] );
+}
+
+/**
+ * Write the snapshot to file path; see FrozenTree.h for the format.
+ * The file is written under a temporary name and renamed into
+ * place, so trees that have the old file loaded keep reading it.
+ * Return true on success.
+ */
+template <class Comparable>
+bool FrozenTree<Comparable>::save( const string & path ) const
+{
+  static_assert( is_trivially_copyable<Comparable>::value,
+                 "only trivially copyable items can be saved" );
+
+  FileHeader h;
+  string temporary = path + ".tmp";
+
+  memset( &h, 0, sizeof( h ) );
+  memcpy( h.magic, "FROZTREE", sizeof( h.magic ) );
+  h.version = FILE_VERSION;
+  h.byteOrder = ORDER_MARK;
+  h.itemSize = sizeof( Comparable );
+  h.count = count;
+  h.checksum = checksum( slots, count + 1 );
+
+  ofstream out( temporary.c_str( ), ios::binary | ios::trunc );
+  out.write( (const char *) &h, sizeof( h ) );
+  out.write( (const char *) slots, ( count + 1 ) * sizeof( Comparable ) );
+  out.close( );
+  if( !out || rename( temporary.c_str( ), path.c_str( ) ) != 0 )
+    {
+      remove( temporary.c_str( ) );
+      return false;
+    }
+  return true;
+}
+
+/**
+ * Replace the snapshot with the one saved in file path. The file is
+ * mapped read-only and searched in place where the system allows;
+ * otherwise it is read into memory.
+ * Return true on success; on failure the snapshot is unchanged.
+ */
+template <class Comparable>
+bool FrozenTree<Comparable>::load( const string & path )
+{
+  static_assert( is_trivially_copyable<Comparable>::value,
+                 "only trivially copyable items can be loaded" );
+
+  shared_ptr<const char> file;
+  size_t bytes = 0;
+
+#ifdef FROZEN_TREE_MMAP
+  int fd = open( path.c_str( ), O_RDONLY );
+  struct stat info;
+  void *mapping = MAP_FAILED;
+
+  if( fd < 0 )
+    return false;
+  if( fstat( fd, &info ) == 0 && (size_t) info.st_size >= sizeof( FileHeader ) )
+    {
+      bytes = info.st_size;
+      mapping = mmap( NULL, bytes, PROT_READ, MAP_SHARED, fd, 0 );
+    }
+  close( fd );      // The mapping outlives the descriptor
+  if( mapping == MAP_FAILED )
+    return false;
+  file = shared_ptr<const char>( (const char *) mapping,
+                                 [ bytes ]( const char *p )
+                                 { munmap( (void *) p, bytes ); } );
+#else
+  ifstream in( path.c_str( ), ios::binary | ios::ate );
+  if( !in )
+    return false;
+  bytes = in.tellg( );
+  if( bytes < sizeof( FileHeader ) )
+    return false;
+
+  // Whole 64-bit words keep the slots aligned
+  shared_ptr<vector<uint64_t> > words =
+    make_shared<vector<uint64_t> >( ( bytes + 7 ) / 8 );
+  in.seekg( 0 );
+  if( !in.read( (char *) words->data( ), bytes ) )
+    return false;
+  file = shared_ptr<const char>( words, (const char *) words->data( ) );
+#endif
+
+  const FileHeader *h = (const FileHeader *) file.get( );
+  if( memcmp( h->magic, "FROZTREE", sizeof( h->magic ) ) != 0 ||
+      h->version != FILE_VERSION || h->byteOrder != ORDER_MARK ||
+      h->itemSize != sizeof( Comparable ) ||
+      h->count > ( bytes - sizeof( FileHeader ) ) / sizeof( Comparable ) ||
+      bytes != sizeof( FileHeader ) + ( h->count + 1 ) * sizeof( Comparable ) )
+    return false;
+
+  storage = file;
+  slots = (const Comparable *) ( file.get( ) + sizeof( FileHeader ) );
+  count = h->count;
+  header = h;
+  return true;
+}
+
+/**
+ * Check the items of a loaded snapshot against the checksum saved
+ * with them; this reads the whole file.
+ * Return false if they differ; snapshots not loaded from a file
+ * always pass.
+ */
+template <class Comparable>
+bool FrozenTree<Comparable>::verify( ) const
+{
+  return header == NULL || checksum( slots, count + 1 ) == header->checksum;
+}
+
+/**
+ * Internal method to place sorted[ next.. ] into the subtree at
+ * slot k of out by an in-order walk of the implicit tree.
+ * Return the index of the first item not placed.
+ */
+template <class Comparable>
+size_t FrozenTree<Comparable>::fill( const vector<Comparable> & sorted,
+                                     vector<Comparable> & out,
+                                     size_t next, size_t k ) const
+{
+  if( k <= count )
+    {
+      next = fill( sorted, out, next, 2 * k );
+      out[ k ] = sorted[ next++ ];
+      next = fill( sorted, out, next, 2 * k + 1 );
+    }
+  return next;
+}
+
+/**
+ * Internal method to compute the 64-bit FNV-1a hash of n items,
+ * taken eight bytes at a time so hashing keeps up with the disk.
+ */
+template <class Comparable>
+uint64_t FrozenTree<Comparable>::checksum( const Comparable *items, size_t n )
+{
+  const unsigned char *bytes = (const unsigned char *) items;
+  size_t length = n * sizeof( Comparable );
+  uint64_t hash = 14695981039346656037ULL;
+  uint64_t word;
+  size_t i = 0;
+
+  for( ; i + 8 <= length; i += 8 )
+    {
+      memcpy( &word, bytes + i, 8 );
+      hash = ( hash ^ word ) * 1099511628211ULL;
+    }
+  for( ; i < length; i++ )
+    hash = ( hash ^ bytes[ i ] ) * 1099511628211ULL;
+  return hash;
+}
+
+/**
+ * Internal method to find the slot of the smallest item not less
+ * than x, or 0 if there is none.
+ * The loop has no data-dependent branch: each level appends the
+ * comparison result as the next bit of k. The right turns taken
+ * after the last left turn are then shifted back out.
+ */
+template <class Comparable>
+size_t FrozenTree<Comparable>::lowerBound( const Comparable & x ) const
+{
+  const Comparable *base = &slots[ 0 ];
+  size_t k = 1;
+
+  while( k <= count )
+    {
+#if defined( __GNUC__ )
+      __builtin_prefetch( base + min( k * PREFETCH_STRIDE, count ) );
+#endif
+      k = 2 * k + ( base[ k ] < x );
+    }
+#if defined( __GNUC__ )
+  k >>= __builtin_ctzll( ~(unsigned long long) k ) + 1;
+#else
+  while( k & 1 )
+    k >>= 1;
+  k >>= 1;
+#endif
+  return k;
+}
+
+/**
+ * Internal method to find the leftmost slot of the subtree at k.
+ */
+template <class Comparable>
+size_t FrozenTree<Comparable>::first( size_t k ) const
+{
+  while( 2 * k <= count )
+    k = 2 * k;
+  return k;
+}
+
+/**
+ * Internal method to find the rightmost slot of the subtree at k.
+ */
+template <class Comparable>
+size_t FrozenTree<Comparable>::last( size_t k ) const
+{
+  while( 2 * k + 1 <= count )
+    k = 2 * k + 1;
+  return k;
+}
+
+/**
+ * Internal method to find the slot after k in sorted order, or 0.
+ */
+template <class Comparable>
+size_t FrozenTree<Comparable>::successor( size_t k ) const
+{
+  if( 2 * k + 1 <= count )
+    return first( 2 * k + 1 );
+  while( k & 1 )        // Climb while k is a right child
+    k >>= 1;
+  return k >> 1;
+}
+
+/**
+ * Internal method to find the slot before k in sorted order, or 0.
+ * The slot before end( ) is the largest item.
+ */
+template <class Comparable>
+size_t FrozenTree<Comparable>::predecessor( size_t k ) const
+{
+  if( k == 0 )
+    return isEmpty( ) ? 0 : last( 1 );
+  if( 2 * k <= count )
+    return last( 2 * k );
+  while( k > 1 && !( k & 1 ) )  // Climb while k is a left child
+    k >>= 1;
+  return k >> 1;
+}
+
+template <class Comparable>
+const Comparable & FrozenTree<Comparable>::const_iterator::operator*( ) const
+{
+  return tree->slots[ current ];
+}
+
+template <class Comparable>
+const Comparable * FrozenTree<Comparable>::const_iterator::operator->( ) const
+{
+  return &tree->slots[ current ];
+}
+
+template <class Comparable>
+typename FrozenTree<Comparable>::const_iterator &
+FrozenTree<Comparable>::const_iterator::operator++( )
+{
+  current = tree->successor( current );
+  return *this;
+}
+
+template <class Comparable>
+typename FrozenTree<Comparable>::const_iterator
+FrozenTree<Comparable>::const_iterator::operator++( int )
+{
+  const_iterator old = *this;
+  ++*this;
+  return old;
+}
+
+template <class Comparable>
+typename FrozenTree<Comparable>::const_iterator &
+FrozenTree<Comparable>::const_iterator::operator--( )
+{
+  current = tree->predecessor( current );
+  return *this;
+}
+
+template <class Comparable>
+typename FrozenTree<Comparable>::const_iterator
+FrozenTree<Comparable>::const_iterator::operator--( int )
+{
+  const_iterator old = *this;
+  --*this;
+  return old;
+}
+
+template <class Comparable>
+bool FrozenTree<Comparable>::const_iterator::
+operator==( const const_iterator & rhs ) const
+{
+  return tree == rhs.tree && current == rhs.current;
+}
+
+template <class Comparable>
+bool FrozenTree<Comparable>::const_iterator::
+operator!=( const const_iterator & rhs ) const
+{
+  return !( *this == rhs );
+}
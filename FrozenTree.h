@@ -0,0 +1,144 @@
+#ifndef FROZEN_TREE_H_
+#define FROZEN_TREE_H_
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// FrozenTree class
+//
+// CONSTRUCTION: with ITEM_NOT_FOUND object used to signal failed finds
+//               and a sorted, duplicate-free vector of items;
+//               usually obtained from BinarySearchTree::freeze( ).
+//               With ITEM_NOT_FOUND alone, an empty snapshot to load into
+//
+// An immutable copy of a search tree stored in one array in
+// Eytzinger (breadth-first) order: the children of slot k are
+// slots 2k and 2k + 1. Searching needs no pointers, the top levels
+// share a few cache lines, and the descent is branch-free with the
+// slots four levels down prefetched ahead of time.
+//
+// save( path ) writes the array to a file behind a 64-byte header
+// holding a magic string, the format version, the byte order, the
+// item size, the item count and a checksum of the array. load( path )
+// maps such a file read-only and searches it where it lies: nothing
+// is read or converted up front, so loading takes constant time and
+// pages are brought in as lookups touch them. load checks the header
+// and file length; verify( ) also checks the array against the
+// checksum, which reads the whole file. Files are only readable on
+// machines with the same byte order and item layout, and only
+// trivially copyable items can be saved.
+//
+// The array is never changed once built, so copies share it; a
+// mapped file stays mapped until the last copy is destroyed.
+//
+// ******************PUBLIC OPERATIONS*********************
+// Comparable find( x )   --> Return item that matches x
+// Comparable findMin( )  --> Return smallest item
+// Comparable findMax( )  --> Return largest item
+// boolean isEmpty( )     --> Return true if empty; else false
+// int size( )            --> Return number of items
+// begin( ), end( )       --> Iterate over the items in sorted order
+// lower_bound( x )       --> Iterator to first item not less than x
+// upper_bound( x )       --> Iterator to first item greater than x
+// void range( lo, hi, f )   --> Call f( item ) for each item in [lo, hi)
+// bool save( path )      --> Write the snapshot to file path
+// bool load( path )      --> Replace the snapshot with file path, mapped
+// bool verify( )         --> Check a loaded snapshot against its checksum
+
+template <class Comparable>
+class FrozenTree
+{
+ public:
+  class const_iterator
+  {
+   public:
+    typedef bidirectional_iterator_tag iterator_category;
+    typedef Comparable value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const Comparable * pointer;
+    typedef const Comparable & reference;
+
+    const_iterator( ) : tree( NULL ), current( 0 ) { }
+
+    const Comparable & operator*( ) const;
+    const Comparable * operator->( ) const;
+    const_iterator & operator++( );
+    const_iterator operator++( int );
+    const_iterator & operator--( );
+    const_iterator operator--( int );
+    bool operator==( const const_iterator & rhs ) const;
+    bool operator!=( const const_iterator & rhs ) const;
+
+   private:
+    const FrozenTree *tree;
+    size_t current;     // Slot of the current item; 0 is end( )
+
+    const_iterator( const FrozenTree *t, size_t k ) : tree( t ), current( k ) { }
+    friend class FrozenTree<Comparable>;
+  };
+
+  explicit FrozenTree( const Comparable & notFound );
+  FrozenTree( const Comparable & notFound, const vector<Comparable> & sorted );
+
+  const Comparable & find( const Comparable & x ) const;
+  const Comparable & findMin( ) const;
+  const Comparable & findMax( ) const;
+  bool isEmpty( ) const;
+  int size( ) const;
+
+  const_iterator begin( ) const;
+  const_iterator end( ) const;
+  const_iterator lower_bound( const Comparable & x ) const;
+  const_iterator upper_bound( const Comparable & x ) const;
+  template <class Visitor>
+  void range( const Comparable & lo, const Comparable & hi, Visitor visit ) const;
+
+  bool save( const string & path ) const;
+  bool load( const string & path );
+  bool verify( ) const;
+
+ private:
+  // Layout of the start of a saved file; slots[ 0.. count ] follow
+  struct FileHeader
+  {
+    char magic[ 8 ];          // "FROZTREE"
+    uint32_t version;
+    uint32_t byteOrder;       // ORDER_MARK as written by the saving machine
+    uint32_t itemSize;        // sizeof( Comparable )
+    uint32_t reserved;
+    uint64_t count;
+    uint64_t checksum;        // Of the slots
+    uint64_t padding[ 3 ];    // Keeps the slots 64-byte aligned
+  };
+
+  enum { FILE_VERSION = 1 };
+  enum { ORDER_MARK = 0x01020304 };
+
+  shared_ptr<const void> storage;     // Owns the slots: a vector or a mapping
+  const Comparable *slots;            // slots[ 0 ] is unused
+  size_t count;
+  const FileHeader *header;           // Header of the mapped file, or NULL
+  Comparable ITEM_NOT_FOUND;
+
+  // Prefetch this many slots per level ahead, i.e. four levels down
+  enum { PREFETCH_STRIDE = 16 };
+
+  size_t fill( const vector<Comparable> & sorted, vector<Comparable> & out,
+               size_t next, size_t k ) const;
+  static uint64_t checksum( const Comparable *items, size_t n );
+  size_t lowerBound( const Comparable & x ) const;
+  size_t first( size_t k ) const;
+  size_t last( size_t k ) const;
+  size_t successor( size_t k ) const;
+  size_t predecessor( size_t k ) const;
+};
+
+#include "FrozenTree.cpp"
+#endif
@@ -0,0 +1,922 @@
+#include "IntBTree.h"
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define INT_BTREE_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/*
+ * Node search kernels: each returns how many of the 16 keys are
+ * less than x. Unused slots hold INT_MAX, which is never less than
+ * x, so they do not need to be masked off.
+ */
+static int countLessScalar( const int *keys, int x )
+{
+  int count = 0;
+
+  for( int i = 0; i < 16; i++ )
+    count += keys[ i ] < x;
+  return count;
+}
+
+#ifdef INT_BTREE_X86
+__attribute__(( target( "sse2" ) ))
+static int countLessSse2( const int *keys, int x )
+{
+  __m128i key = _mm_set1_epi32( x );
+  int mask = 0;
+
+  for( int i = 0; i < 4; i++ )
+    {
+      __m128i slots = _mm_loadu_si128( (const __m128i *) ( keys + 4 * i ) );
+      __m128i less = _mm_cmpgt_epi32( key, slots );
+      mask |= _mm_movemask_ps( _mm_castsi128_ps( less ) ) << ( 4 * i );
+    }
+  return __builtin_popcount( mask );
+}
+
+__attribute__(( target( "avx2" ) ))
+static int countLessAvx2( const int *keys, int x )
+{
+  __m256i key = _mm256_set1_epi32( x );
+  __m256i low = _mm256_loadu_si256( (const __m256i *) keys );
+  __m256i high = _mm256_loadu_si256( (const __m256i *) ( keys + 8 ) );
+  int mask = _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpgt_epi32( key, low ) ) ) |
+             _mm256_movemask_ps( _mm256_castsi256_ps( _mm256_cmpgt_epi32( key, high ) ) ) << 8;
+  return __builtin_popcount( mask );
+}
+#endif
+
+/*
+ * Pick the widest kernel the CPU supports.
+ */
+static int ( *selectCountLess( ) )( const int *, int )
+{
+#ifdef INT_BTREE_X86
+  __builtin_cpu_init( );
+  if( __builtin_cpu_supports( "avx2" ) )
+    return countLessAvx2;
+  if( __builtin_cpu_supports( "sse2" ) )
+    return countLessSse2;
+#endif
+  return countLessScalar;
+}
+
+/**
+ * Construct an empty node.
+ */
+IntBTree::Node::Node( bool leaf ) : count( 0 ), isLeaf( leaf )
+{
+  for( int i = 0; i < NODE_KEYS; i++ )
+    keys[ i ] = INT_MAX;
+}
+
+/**
+ * Construct the tree.
+ */
+IntBTree::IntBTree( int notFound ) :
+  root( NULL ), head( NULL ), tail( NULL ), items( 0 ),
+  ITEM_NOT_FOUND( notFound )
+{
+}
+
+/**
+ * Copy constructor.
+ */
+IntBTree::IntBTree( const IntBTree & rhs ) :
+  root( NULL ), head( NULL ), tail( NULL ), items( 0 ),
+  ITEM_NOT_FOUND( rhs.ITEM_NOT_FOUND )
+{
+  *this = rhs;
+}
+
+/**
+ * Move constructor; takes over the nodes of rhs and leaves it empty.
+ */
+IntBTree::IntBTree( IntBTree && rhs ) :
+  root( rhs.root ), head( rhs.head ), tail( rhs.tail ), items( rhs.items ),
+  ITEM_NOT_FOUND( rhs.ITEM_NOT_FOUND )
+{
+  rhs.root = NULL;
+  rhs.head = rhs.tail = NULL;
+  rhs.items = 0;
+}
+
+/**
+ * Destructor for the tree.
+ */
+IntBTree::~IntBTree( )
+{
+  makeEmpty( );
+}
+
+/**
+ * Deep copy; the copy is bulk loaded from the sorted keys.
+ */
+const IntBTree & IntBTree::operator=( const IntBTree & rhs )
+{
+  if( this != &rhs )
+    {
+      vector<int> keys;
+      rhs.flatten( keys );
+      build( keys );
+    }
+  return *this;
+}
+
+/**
+ * Move assignment; takes over the nodes of rhs and leaves it empty.
+ */
+const IntBTree & IntBTree::operator=( IntBTree && rhs )
+{
+  if( this != &rhs )
+    {
+      makeEmpty( );
+      swap( rhs );
+    }
+  return *this;
+}
+
+/**
+ * Exchange the items of this tree and rhs; no node is copied.
+ */
+void IntBTree::swap( IntBTree & rhs )
+{
+  std::swap( root, rhs.root );
+  std::swap( head, rhs.head );
+  std::swap( tail, rhs.tail );
+  std::swap( items, rhs.items );
+}
+
+/**
+ * Find item x in the tree.
+ * Return x or ITEM_NOT_FOUND if not found.
+ */
+int IntBTree::find( int x ) const
+{
+  const Node *t = root;
+
+  if( t == NULL )
+    return ITEM_NOT_FOUND;
+  while( !t->isLeaf )
+    t = static_cast<const Inner *>( t )->children[ countLess( t->keys, x ) ];
+
+  int i = countLess( t->keys, x );
+  return ( i < t->count && t->keys[ i ] == x ) ? x : ITEM_NOT_FOUND;
+}
+
+/**
+ * Look up keys[ 0.. n - 1 ]: set results[ i ] to keys[ i ] if it is
+ * in the tree, else to ITEM_NOT_FOUND.
+ * FIND_GROUP lookups descend in lock step, one level at a time, and
+ * each child is prefetched when it is chosen, so the cache misses
+ * of a group overlap instead of following one another.
+ */
+void IntBTree::findBatch( const int *keys, size_t n, int *results ) const
+{
+  const Node *at[ FIND_GROUP ];
+
+  for( size_t first = 0; first < n; first += FIND_GROUP )
+    {
+      size_t m = min( n - first, (size_t) FIND_GROUP );
+      bool descending = root != NULL;
+
+      for( size_t i = 0; i < m; i++ )
+        at[ i ] = root;
+      while( descending )
+        {
+          descending = false;
+          for( size_t i = 0; i < m; i++ )
+            if( !at[ i ]->isLeaf )
+              {
+                at[ i ] = static_cast<const Inner *>( at[ i ] )->
+                            children[ countLess( at[ i ]->keys, keys[ first + i ] ) ];
+#if defined( __GNUC__ )
+                __builtin_prefetch( at[ i ] );
+#endif
+                descending = true;
+              }
+        }
+      for( size_t i = 0; i < m; i++ )
+        {
+          int x = keys[ first + i ];
+          int slot = root == NULL ? 0 : countLess( at[ i ]->keys, x );
+          results[ first + i ] = ( root != NULL && slot < at[ i ]->count &&
+                                   at[ i ]->keys[ slot ] == x ) ? x : ITEM_NOT_FOUND;
+        }
+    }
+}
+
+/**
+ * Find the smallest item in the tree.
+ * Return smallest item or ITEM_NOT_FOUND if empty.
+ */
+int IntBTree::findMin( ) const
+{
+  return isEmpty( ) ? ITEM_NOT_FOUND : head->keys[ 0 ];
+}
+
+/**
+ * Find the largest item in the tree.
+ * Return the largest item or ITEM_NOT_FOUND if empty.
+ */
+int IntBTree::findMax( ) const
+{
+  return isEmpty( ) ? ITEM_NOT_FOUND : tail->keys[ tail->count - 1 ];
+}
+
+/**
+ * Test if the tree is logically empty.
+ */
+bool IntBTree::isEmpty( ) const
+{
+  return items == 0;
+}
+
+/**
+ * Return the value find gives for a missing item.
+ */
+int IntBTree::notFound( ) const
+{
+  return ITEM_NOT_FOUND;
+}
+
+/**
+ * Print the tree contents in sorted order.
+ */
+void IntBTree::printTree( ) const
+{
+  if( isEmpty( ) )
+    cout << "Empty tree" << endl;
+  else
+    for( const Leaf *leaf = head; leaf != NULL; leaf = leaf->next )
+      for( int i = 0; i < leaf->count; i++ )
+        cout << leaf->keys[ i ] << " ";
+}
+
+/**
+ * Make the tree logically empty.
+ */
+void IntBTree::makeEmpty( )
+{
+  vector<Node *> stack;
+
+  if( root != NULL )
+    stack.push_back( root );
+  while( !stack.empty( ) )
+    {
+      Node *t = stack.back( );
+      stack.pop_back( );
+      if( !t->isLeaf )
+        {
+          Inner *inner = static_cast<Inner *>( t );
+          for( int i = 0; i <= inner->count; i++ )
+            stack.push_back( inner->children[ i ] );
+        }
+      freeNode( t );
+    }
+  root = NULL;
+  head = tail = NULL;
+  items = 0;
+}
+
+/**
+ * Insert x into the tree; duplicates are ignored.
+ * A full leaf is split in half and the split propagates upward
+ * through full inner nodes.
+ */
+void IntBTree::insert( int x )
+{
+  if( root == NULL )
+    {
+      head = tail = new Leaf( );
+      head->keys[ 0 ] = x;
+      head->count = 1;
+      root = head;
+      items = 1;
+      return;
+    }
+
+  Leaf *leaf = descend( x );
+  int pos = countLess( leaf->keys, x );
+
+  if( pos < leaf->count && leaf->keys[ pos ] == x )
+    return;  // Duplicate; do nothing
+  items++;
+  for( size_t i = 0; i < path.size( ); i++ )
+    path[ i ].first->sizes[ path[ i ].second ]++;
+
+  Leaf *right = NULL;
+  Leaf *target = leaf;
+  if( leaf->count == NODE_KEYS )
+    {
+      // Move the upper half to a new right sibling
+      int half = NODE_KEYS / 2;
+
+      right = new Leaf( );
+      for( int i = half; i < NODE_KEYS; i++ )
+        {
+          right->keys[ i - half ] = leaf->keys[ i ];
+          leaf->keys[ i ] = INT_MAX;
+        }
+      right->count = NODE_KEYS - half;
+      leaf->count = half;
+
+      right->prev = leaf;
+      right->next = leaf->next;
+      if( leaf->next != NULL )
+        leaf->next->prev = right;
+      else
+        tail = right;
+      leaf->next = right;
+
+      if( pos > half )
+        {
+          target = right;
+          pos -= half;
+        }
+    }
+
+  for( int i = target->count; i > pos; i-- )
+    target->keys[ i ] = target->keys[ i - 1 ];
+  target->keys[ pos ] = x;
+  target->count++;
+
+  if( right != NULL )
+    insertAbove( leaf->keys[ leaf->count - 1 ], right );
+}
+
+/**
+ * Remove x from the tree. Nothing is done if x is not found.
+ */
+void IntBTree::remove( int x )
+{
+  if( root == NULL )
+    return;
+
+  Leaf *leaf = descend( x );
+  int pos = countLess( leaf->keys, x );
+
+  if( pos == leaf->count || leaf->keys[ pos ] != x )
+    return;   // Item not found; do nothing
+  items--;
+  for( size_t i = 0; i < path.size( ); i++ )
+    path[ i ].first->sizes[ path[ i ].second ]--;
+
+  for( int i = pos; i < leaf->count - 1; i++ )
+    leaf->keys[ i ] = leaf->keys[ i + 1 ];
+  leaf->keys[ --leaf->count ] = INT_MAX;
+  if( leaf->count > 0 )
+    return;
+
+  if( leaf->prev != NULL )
+    leaf->prev->next = leaf->next;
+  else
+    head = leaf->next;
+  if( leaf->next != NULL )
+    leaf->next->prev = leaf->prev;
+  else
+    tail = leaf->prev;
+  if( leaf == root )
+    root = NULL;
+  else
+    removeAbove( );
+  freeNode( leaf );
+}
+
+/**
+ * Replace the contents of the tree with keys, in any order.
+ */
+void IntBTree::assign( const vector<int> & keys )
+{
+  vector<int> sorted( keys );
+
+  sort( sorted.begin( ), sorted.end( ) );
+  sorted.erase( unique( sorted.begin( ), sorted.end( ) ), sorted.end( ) );
+  build( sorted );
+}
+
+/*
+ *  Union : adds the elements of rhs
+ */
+void IntBTree::Union( const IntBTree & rhs )
+{
+  vector<int> theirs;
+
+  rhs.flatten( theirs );
+  absorb( theirs );
+}
+
+/*
+ * Intersection: adds the elements found in both trees
+ */
+void IntBTree::Intersection( const IntBTree & tree1, const IntBTree & tree2 )
+{
+  vector<int> items1;
+  vector<int> items2;
+  vector<int> result;
+
+  tree1.flatten( items1 );
+  tree2.flatten( items2 );
+  set_intersection( items1.begin( ), items1.end( ), items2.begin( ), items2.end( ),
+                    back_inserter( result ) );
+  absorb( result );
+}
+
+/*
+ * Difference: adds the elements of tree1 that are not in tree2
+ */
+void IntBTree::Difference( const IntBTree & tree1, const IntBTree & tree2 )
+{
+  vector<int> items1;
+  vector<int> items2;
+  vector<int> result;
+
+  tree1.flatten( items1 );
+  tree2.flatten( items2 );
+  set_difference( items1.begin( ), items1.end( ), items2.begin( ), items2.end( ),
+                  back_inserter( result ) );
+  absorb( result );
+}
+
+/*
+ * SymmetricDifference: adds the elements found in exactly one tree
+ */
+void IntBTree::SymmetricDifference( const IntBTree & tree1,
+                                    const IntBTree & tree2 )
+{
+  vector<int> items1;
+  vector<int> items2;
+  vector<int> result;
+
+  tree1.flatten( items1 );
+  tree2.flatten( items2 );
+  set_symmetric_difference( items1.begin( ), items1.end( ),
+                            items2.begin( ), items2.end( ),
+                            back_inserter( result ) );
+  absorb( result );
+}
+
+/**
+ * Append the items to keys in sorted order.
+ */
+void IntBTree::flatten( vector<int> & keys ) const
+{
+  keys.reserve( keys.size( ) + items );
+  for( const Leaf *leaf = head; leaf != NULL; leaf = leaf->next )
+    keys.insert( keys.end( ), leaf->keys, leaf->keys + leaf->count );
+}
+
+/**
+ * Return the number of items.
+ */
+int IntBTree::size( ) const
+{
+  return items;
+}
+
+/**
+ * Return the number of items less than x, in time
+ * proportional to the height of the tree.
+ */
+int IntBTree::rank( int x ) const
+{
+  const Node *t = root;
+  int less = 0;
+
+  if( t == NULL )
+    return 0;
+  while( !t->isLeaf )
+    {
+      const Inner *inner = static_cast<const Inner *>( t );
+      int i = countLess( inner->keys, x );
+      for( int j = 0; j < i; j++ )
+        less += inner->sizes[ j ];
+      t = inner->children[ i ];
+    }
+  return less + countLess( t->keys, x );
+}
+
+/**
+ * Find the item with exactly k smaller items, so select( 0 ) is
+ * the smallest, in time proportional to the height of the tree.
+ * Return that item or ITEM_NOT_FOUND if k is out of range.
+ */
+int IntBTree::select( int k ) const
+{
+  const Node *t = root;
+
+  if( k < 0 || k >= items )
+    return ITEM_NOT_FOUND;
+  while( !t->isLeaf )
+    {
+      const Inner *inner = static_cast<const Inner *>( t );
+      int i = 0;
+      while( k >= inner->sizes[ i ] )
+        k -= inner->sizes[ i++ ];
+      t = inner->children[ i ];
+    }
+  return t->keys[ k ];
+}
+
+/**
+ * Return an iterator to the smallest item.
+ */
+IntBTree::const_iterator IntBTree::begin( ) const
+{
+  return const_iterator( this, head, 0 );
+}
+
+/**
+ * Return the iterator past the largest item.
+ */
+IntBTree::const_iterator IntBTree::end( ) const
+{
+  return const_iterator( this, NULL, 0 );
+}
+
+/**
+ * Return an iterator to the first item not less than x,
+ * or end( ) if there is none.
+ */
+IntBTree::const_iterator IntBTree::lower_bound( int x ) const
+{
+  const Node *t = root;
+
+  if( t == NULL )
+    return end( );
+  while( !t->isLeaf )
+    t = static_cast<const Inner *>( t )->children[ countLess( t->keys, x ) ];
+
+  // Past the last key the answer is the first key of the next leaf
+  const Leaf *leaf = static_cast<const Leaf *>( t );
+  int i = countLess( leaf->keys, x );
+  if( i == leaf->count )
+    return const_iterator( this, leaf->next, 0 );
+  return const_iterator( this, leaf, i );
+}
+
+/**
+ * Return an iterator to the first item greater than x,
+ * or end( ) if there is none.
+ */
+IntBTree::const_iterator IntBTree::upper_bound( int x ) const
+{
+  const_iterator itr = lower_bound( x );
+
+  if( itr != end( ) && *itr == x )
+    ++itr;
+  return itr;
+}
+
+/**
+ * Return the items equal to x as a range of iterators;
+ * it holds at most one item.
+ */
+pair<IntBTree::const_iterator, IntBTree::const_iterator>
+IntBTree::equal_range( int x ) const
+{
+  return make_pair( lower_bound( x ), upper_bound( x ) );
+}
+
+/**
+ * Internal method to count the keys in a node less than x.
+ * The kernel is chosen on first use, so trees built by static
+ * constructors in other files work too.
+ */
+int IntBTree::countLess( const int *keys, int x )
+{
+  static int ( * const kernel )( const int *, int ) = selectCountLess( );
+
+  return kernel( keys, x );
+}
+
+/**
+ * Internal method to find the leaf that holds or would hold x.
+ * The inner nodes passed on the way are left in path.
+ * The tree must not be empty.
+ */
+IntBTree::Leaf * IntBTree::descend( int x )
+{
+  Node *t = root;
+
+  path.clear( );
+  while( !t->isLeaf )
+    {
+      Inner *inner = static_cast<Inner *>( t );
+      int i = countLess( inner->keys, x );
+      path.push_back( make_pair( inner, i ) );
+      t = inner->children[ i ];
+    }
+  return static_cast<Leaf *>( t );
+}
+
+/**
+ * Internal method to return the number of keys under node t.
+ */
+int IntBTree::subtreeSize( const Node *t )
+{
+  if( t->isLeaf )
+    return t->count;
+
+  const Inner *inner = static_cast<const Inner *>( t );
+  int total = 0;
+  for( int i = 0; i <= inner->count; i++ )
+    total += inner->sizes[ i ];
+  return total;
+}
+
+/**
+ * Internal method to link node right, just split off the node
+ * reached through path, into the parent with the given separator.
+ * Full parents split in turn; a split root grows the tree a level.
+ */
+void IntBTree::insertAbove( int separator, Node *right )
+{
+  while( !path.empty( ) )
+    {
+      Inner *parent = path.back( ).first;
+      int i = path.back( ).second;
+      path.pop_back( );
+
+      // Lay out the parent's keys and children with the new pair added
+      int keys[ NODE_KEYS + 1 ];
+      Node *children[ NODE_KEYS + 2 ];
+      int sizes[ NODE_KEYS + 2 ];
+      int count = parent->count + 1;
+
+      for( int j = 0, k = 0; j < count; j++ )
+        keys[ j ] = ( j == i ) ? separator : parent->keys[ k++ ];
+      for( int j = 0, k = 0; j <= count; j++ )
+        {
+          if( j == i + 1 )
+            {
+              children[ j ] = right;
+              sizes[ j ] = subtreeSize( right );
+            }
+          else
+            {
+              children[ j ] = parent->children[ k ];
+              sizes[ j ] = parent->sizes[ k++ ];
+            }
+        }
+      // The child that split gave its upper half to right
+      sizes[ i ] = subtreeSize( parent->children[ i ] );
+
+      if( count <= NODE_KEYS )
+        {
+          for( int j = 0; j < count; j++ )
+            parent->keys[ j ] = keys[ j ];
+          for( int j = 0; j <= count; j++ )
+            {
+              parent->children[ j ] = children[ j ];
+              parent->sizes[ j ] = sizes[ j ];
+            }
+          parent->count = count;
+          return;
+        }
+
+      // Split: the middle key moves up, the upper half moves right
+      Inner *sibling = new Inner( );
+      int mid = count / 2;
+
+      for( int j = 0; j < NODE_KEYS; j++ )
+        parent->keys[ j ] = ( j < mid ) ? keys[ j ] : INT_MAX;
+      for( int j = 0; j <= mid; j++ )
+        {
+          parent->children[ j ] = children[ j ];
+          parent->sizes[ j ] = sizes[ j ];
+        }
+      parent->count = mid;
+
+      for( int j = mid + 1; j < count; j++ )
+        sibling->keys[ j - mid - 1 ] = keys[ j ];
+      for( int j = mid + 1; j <= count; j++ )
+        {
+          sibling->children[ j - mid - 1 ] = children[ j ];
+          sibling->sizes[ j - mid - 1 ] = sizes[ j ];
+        }
+      sibling->count = count - mid - 1;
+
+      separator = keys[ mid ];
+      right = sibling;
+    }
+
+  Inner *newRoot = new Inner( );
+  newRoot->keys[ 0 ] = separator;
+  newRoot->children[ 0 ] = root;
+  newRoot->children[ 1 ] = right;
+  newRoot->sizes[ 0 ] = subtreeSize( root );
+  newRoot->sizes[ 1 ] = subtreeSize( right );
+  newRoot->count = 1;
+  root = newRoot;
+}
+
+/**
+ * Internal method to unlink the child reached through path, which
+ * has just been freed. Inner nodes left without children are freed
+ * as well, and a root with a single child is replaced by it.
+ */
+void IntBTree::removeAbove( )
+{
+  while( !path.empty( ) )
+    {
+      Inner *parent = path.back( ).first;
+      int i = path.back( ).second;
+      path.pop_back( );
+
+      if( parent->count == 0 )
+        {
+          // That was its only child
+          freeNode( parent );
+          continue;
+        }
+
+      // Drop the separator on whichever side of the child is present
+      for( int j = ( i < parent->count ) ? i : i - 1; j < parent->count - 1; j++ )
+        parent->keys[ j ] = parent->keys[ j + 1 ];
+      for( int j = i; j < parent->count; j++ )
+        {
+          parent->children[ j ] = parent->children[ j + 1 ];
+          parent->sizes[ j ] = parent->sizes[ j + 1 ];
+        }
+      parent->keys[ --parent->count ] = INT_MAX;
+      break;
+    }
+
+  while( !root->isLeaf && root->count == 0 )
+    {
+      Node *oldRoot = root;
+      root = static_cast<Inner *>( root )->children[ 0 ];
+      freeNode( oldRoot );
+    }
+}
+
+/**
+ * Internal method to replace the contents of the tree with the
+ * sorted, duplicate-free keys. Nodes are filled to BULK_KEYS so
+ * that the next few inserts do not split them.
+ */
+void IntBTree::build( const vector<int> & sorted )
+{
+  makeEmpty( );
+  if( sorted.empty( ) )
+    return;
+
+  // Leaves, spreading the keys evenly
+  vector<Node *> level;
+  vector<int> largest;     // Largest key under each node of level
+  vector<int> sizes;       // Keys under each node of level
+  size_t leaves = ( sorted.size( ) + BULK_KEYS - 1 ) / BULK_KEYS;
+
+  for( size_t n = 0; n < leaves; n++ )
+    {
+      size_t first = sorted.size( ) * n / leaves;
+      size_t last = sorted.size( ) * ( n + 1 ) / leaves;
+      Leaf *leaf = new Leaf( );
+
+      for( size_t i = first; i < last; i++ )
+        leaf->keys[ i - first ] = sorted[ i ];
+      leaf->count = (int) ( last - first );
+      leaf->prev = tail;
+      if( tail != NULL )
+        tail->next = leaf;
+      else
+        head = leaf;
+      tail = leaf;
+      level.push_back( leaf );
+      largest.push_back( sorted[ last - 1 ] );
+      sizes.push_back( leaf->count );
+    }
+
+  // Inner levels, BULK_KEYS + 1 children each, until one node is left
+  while( level.size( ) > 1 )
+    {
+      vector<Node *> above;
+      vector<int> aboveLargest;
+      vector<int> aboveSizes;
+      size_t parents = ( level.size( ) + BULK_KEYS ) / ( BULK_KEYS + 1 );
+
+      for( size_t n = 0; n < parents; n++ )
+        {
+          size_t first = level.size( ) * n / parents;
+          size_t last = level.size( ) * ( n + 1 ) / parents;
+          Inner *inner = new Inner( );
+          int total = 0;
+
+          for( size_t i = first; i < last; i++ )
+            {
+              inner->children[ i - first ] = level[ i ];
+              inner->sizes[ i - first ] = sizes[ i ];
+              total += sizes[ i ];
+              if( i + 1 < last )
+                inner->keys[ i - first ] = largest[ i ];
+            }
+          inner->count = (int) ( last - first - 1 );
+          above.push_back( inner );
+          aboveLargest.push_back( largest[ last - 1 ] );
+          aboveSizes.push_back( total );
+        }
+      level.swap( above );
+      largest.swap( aboveLargest );
+      sizes.swap( aboveSizes );
+    }
+
+  root = level[ 0 ];
+  items = (int) sorted.size( );
+}
+
+/**
+ * Internal method to add the sorted, duplicate-free keys to the
+ * tree; the result is bulk loaded.
+ */
+void IntBTree::absorb( const vector<int> & sorted )
+{
+  vector<int> mine;
+  vector<int> result;
+
+  if( sorted.empty( ) )
+    return;
+  flatten( mine );
+  result.reserve( mine.size( ) + sorted.size( ) );
+  set_union( mine.begin( ), mine.end( ), sorted.begin( ), sorted.end( ),
+             back_inserter( result ) );
+  build( result );
+}
+
+/**
+ * Internal method to free a leaf or inner node.
+ */
+void IntBTree::freeNode( Node *t )
+{
+  if( t->isLeaf )
+    delete static_cast<Leaf *>( t );
+  else
+    delete static_cast<Inner *>( t );
+}
+
+const int & IntBTree::const_iterator::operator*( ) const
+{
+  return leaf->keys[ slot ];
+}
+
+const int * IntBTree::const_iterator::operator->( ) const
+{
+  return &leaf->keys[ slot ];
+}
+
+IntBTree::const_iterator & IntBTree::const_iterator::operator++( )
+{
+  if( ++slot == leaf->count )
+    {
+      leaf = leaf->next;
+      slot = 0;
+    }
+  return *this;
+}
+
+IntBTree::const_iterator IntBTree::const_iterator::operator++( int )
+{
+  const_iterator old = *this;
+  ++*this;
+  return old;
+}
+
+IntBTree::const_iterator & IntBTree::const_iterator::operator--( )
+{
+  if( leaf == NULL )
+    {
+      leaf = tree->tail;
+      slot = leaf->count - 1;
+    }
+  else if( slot-- == 0 )
+    {
+      leaf = leaf->prev;
+      slot = leaf->count - 1;
+    }
+  return *this;
+}
+
+IntBTree::const_iterator IntBTree::const_iterator::operator--( int )
+{
+  const_iterator old = *this;
+  --*this;
+  return old;
+}
+
+bool IntBTree::const_iterator::operator==( const const_iterator & rhs ) const
+{
+  return tree == rhs.tree && leaf == rhs.leaf && slot == rhs.slot;
+}
+
+bool IntBTree::const_iterator::operator!=( const const_iterator & rhs ) const
+{
+  return !( *this == rhs );
+}
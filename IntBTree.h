@@ -0,0 +1,208 @@
+#ifndef INT_BTREE_H_
+#define INT_BTREE_H_
+
+#include <cstddef>
+#include <iostream>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// IntBTree class
+//
+// CONSTRUCTION: with ITEM_NOT_FOUND value used to signal failed finds
+//
+// A B+ tree of ints: an alternative engine to BinarySearchTree<int>
+// for lookup-heavy integer workloads. Every node holds up to 16 keys
+// in one 64-byte cache line, so a lookup touches about log16 n lines
+// instead of log2 n nodes. Within a node the position of a key is
+// found by comparing it with all 16 slots at once, using AVX2 or
+// SSE2 when the CPU has them and a plain loop otherwise; the choice
+// is made once at startup.
+//
+// Keys live in the leaves, which are linked in sorted order; inner
+// nodes hold, for each child but the last, the largest key below it,
+// and for every child the number of keys below it (for rank/select).
+// Removing keys never merges nodes: a leaf is freed when it empties,
+// and an inner node when its last child is freed.
+//
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x )       --> Insert x
+// void remove( x )       --> Remove x
+// void findBatch( a, n, r ) --> Set r[ i ] to find( a[ i ] ) for i < n
+// int find( x )          --> Return x if present, else ITEM_NOT_FOUND
+// int findMin( )         --> Return smallest item
+// int findMax( )         --> Return largest item
+// boolean isEmpty( )     --> Return true if empty; else false
+// int notFound( )        --> Return ITEM_NOT_FOUND
+// void makeEmpty( )      --> Remove all items
+// void swap( rhs )       --> Exchange contents with rhs, in O(1)
+// void printTree( )      --> Print tree in sorted order
+// void assign( keys )    --> Replace contents with keys, in any order
+// void Union( rhs )                     --> Add the elements of rhs
+// void Intersection( t1, t2 )           --> Add elements in both t1 and t2
+// void Difference( t1, t2 )             --> Add elements in t1 but not t2
+// void SymmetricDifference( t1, t2 )    --> Add elements in exactly one
+// void flatten( keys )   --> Append the items to keys in sorted order
+// int size( )            --> Return number of items
+// int rank( x )          --> Return number of items less than x
+// int select( k )        --> Return item of rank k (0 is smallest)
+// begin( ), end( )       --> Iterate over the items in sorted order
+// lower_bound( x )       --> Iterator to first item not less than x
+// upper_bound( x )       --> Iterator to first item greater than x
+// equal_range( x )       --> Pair of lower_bound( x ) and upper_bound( x )
+// void range( lo, hi, f )   --> Call f( item ) for each item in [lo, hi)
+//
+// Iterators walk the linked leaves. Any insert or remove may move
+// keys between slots, so it invalidates all iterators.
+// Moving or swapping trees hands over the nodes without copying;
+// ITEM_NOT_FOUND is not transferred.
+
+class IntBTree
+{
+ private:
+  struct Leaf;
+
+ public:
+  class const_iterator
+  {
+   public:
+    typedef bidirectional_iterator_tag iterator_category;
+    typedef int value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const int * pointer;
+    typedef const int & reference;
+
+    const_iterator( ) : tree( NULL ), leaf( NULL ), slot( 0 ) { }
+
+    const int & operator*( ) const;
+    const int * operator->( ) const;
+    const_iterator & operator++( );
+    const_iterator operator++( int );
+    const_iterator & operator--( );
+    const_iterator operator--( int );
+    bool operator==( const const_iterator & rhs ) const;
+    bool operator!=( const const_iterator & rhs ) const;
+
+   private:
+    const IntBTree *tree;
+    const Leaf *leaf;     // NULL is end( )
+    int slot;
+
+    const_iterator( const IntBTree *t, const Leaf *l, int s )
+      : tree( t ), leaf( l ), slot( s ) { }
+    friend class IntBTree;
+  };
+
+  explicit IntBTree( int notFound );
+  IntBTree( const IntBTree & rhs );
+  IntBTree( IntBTree && rhs );
+  ~IntBTree( );
+
+  int find( int x ) const;
+  void findBatch( const int *keys, size_t n, int *results ) const;
+  int findMin( ) const;
+  int findMax( ) const;
+  bool isEmpty( ) const;
+  int notFound( ) const;
+  void printTree( ) const;
+
+  void makeEmpty( );
+  void insert( int x );
+  void remove( int x );
+  void assign( const vector<int> & keys );
+
+  void Union( const IntBTree & rhs );
+  void Intersection( const IntBTree & tree1, const IntBTree & tree2 );
+  void Difference( const IntBTree & tree1, const IntBTree & tree2 );
+  void SymmetricDifference( const IntBTree & tree1, const IntBTree & tree2 );
+
+  void flatten( vector<int> & keys ) const;
+  int size( ) const;
+  int rank( int x ) const;
+  int select( int k ) const;
+
+  const_iterator begin( ) const;
+  const_iterator end( ) const;
+  const_iterator lower_bound( int x ) const;
+  const_iterator upper_bound( int x ) const;
+  pair<const_iterator, const_iterator> equal_range( int x ) const;
+  template <class Visitor>
+  void range( int lo, int hi, Visitor visit ) const;
+
+  const IntBTree & operator=( const IntBTree & rhs );
+  const IntBTree & operator=( IntBTree && rhs );
+  void swap( IntBTree & rhs );
+
+ private:
+  enum { NODE_KEYS = 16 };              // Keys per node; one cache line
+  enum { BULK_KEYS = NODE_KEYS - 2 };   // Keys per node when bulk loading
+  enum { FIND_GROUP = 16 };             // Lookups interleaved by findBatch
+
+  struct Node
+  {
+    alignas( 64 ) int keys[ NODE_KEYS ];  // Unused slots hold INT_MAX
+    int count;                            // Keys in use
+    bool isLeaf;
+
+    explicit Node( bool leaf );
+  };
+
+  struct Leaf : Node
+  {
+    Leaf *prev;
+    Leaf *next;
+
+    Leaf( ) : Node( true ), prev( NULL ), next( NULL ) { }
+  };
+
+  struct Inner : Node
+  {
+    Node *children[ NODE_KEYS + 1 ];      // count + 1 in use
+    int sizes[ NODE_KEYS + 1 ];           // Keys under each child
+
+    Inner( ) : Node( false ) { }
+  };
+
+  Node *root;
+  Leaf *head;        // Leaf with the smallest keys
+  Leaf *tail;        // Leaf with the largest keys
+  int items;
+  int ITEM_NOT_FOUND;
+
+  // Inner nodes and child indexes from the root down to the leaf
+  // touched by the last insert or remove
+  vector<pair<Inner *, int> > path;
+
+  static int countLess( const int *keys, int x );
+  static int subtreeSize( const Node *t );
+  Leaf * descend( int x );
+  void insertAbove( int separator, Node *right );
+  void removeAbove( );
+  void build( const vector<int> & sorted );
+  void absorb( const vector<int> & sorted );
+  static void freeNode( Node *t );
+};
+
+/**
+ * Call visit( item ) for each item in [lo, hi), in sorted order.
+ * Costs one descent plus a scan of the leaves holding the items.
+ */
+template <class Visitor>
+void IntBTree::range( int lo, int hi, Visitor visit ) const
+{
+  const_iterator itr = lower_bound( lo );
+
+  for( const Leaf *leaf = itr.leaf; leaf != NULL; leaf = leaf->next )
+    {
+      for( int i = ( leaf == itr.leaf ) ? itr.slot : 0; i < leaf->count; i++ )
+        {
+          if( !( leaf->keys[ i ] < hi ) )
+            return;
+          visit( leaf->keys[ i ] );
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,167 @@
+#include "NodePool.h"
+#include <algorithm>
+#include <new>
+
+using namespace std;
+
+/**
+ * Construct an empty pool; no slab is allocated until first use.
+ */
+template <class Node>
+NodePool<Node>::NodePool( ) :
+  freeList( NULL ), used( 0 ), capacity( 0 )
+{
+}
+
+/**
+ * Destructor; frees every slab.
+ */
+template <class Node>
+NodePool<Node>::~NodePool( )
+{
+  release( );
+}
+
+/**
+ * Return storage for one node, reusing freed nodes first.
+ */
+template <class Node>
+Node * NodePool<Node>::allocate( )
+{
+  Slot *slot;
+
+  if( freeList != NULL )
+    {
+      slot = freeList;
+      freeList = slot->next;
+    }
+  else
+    {
+      if( used == capacity )
+        {
+          capacity = capacity == 0 ? (size_t) MIN_SLAB
+                                   : min( capacity * 2, (size_t) MAX_SLAB );
+          slabs.push_back( static_cast<Slot *>(
+                             ::operator new( capacity * sizeof( Slot ) ) ) );
+          used = 0;
+        }
+      slot = &slabs.back( )[ used++ ];
+    }
+  return reinterpret_cast<Node *>( slot );
+}
+
+/**
+ * Put the storage of node p on the free list.
+ */
+template <class Node>
+void NodePool<Node>::deallocate( Node *p )
+{
+  Slot *slot = reinterpret_cast<Slot *>( p );
+  slot->next = freeList;
+  freeList = slot;
+}
+
+/**
+ * Free every slab. Nodes still living in them must already be
+ * destroyed or be trivially destructible.
+ */
+template <class Node>
+void NodePool<Node>::release( )
+{
+  for( size_t i = 0; i < slabs.size( ); i++ )
+    ::operator delete( slabs[ i ] );
+  slabs.clear( );
+  freeList = NULL;
+  used = capacity = 0;
+}
+
+/**
+ * Take over the slabs and free nodes of rhs, which is left empty.
+ * Nodes allocated from rhs may then be deallocated here.
+ */
+template <class Node>
+void NodePool<Node>::splice( NodePool & rhs )
+{
+  if( rhs.slabs.empty( ) )
+    return;
+
+  // The unused end of rhs's newest slab becomes free nodes
+  for( size_t i = rhs.used; i < rhs.capacity; i++ )
+    {
+      Slot *slot = &rhs.slabs.back( )[ i ];
+      slot->next = rhs.freeList;
+      rhs.freeList = slot;
+    }
+  if( rhs.freeList != NULL )
+    {
+      Slot *tail = rhs.freeList;
+      while( tail->next != NULL )
+        tail = tail->next;
+      tail->next = freeList;
+      freeList = rhs.freeList;
+    }
+
+  // Keep our newest slab last so that allocate( ) still bumps into it;
+  // with none of our own, rhs's newest is last and has no room left
+  if( slabs.empty( ) )
+    used = capacity = rhs.capacity;
+  slabs.insert( slabs.empty( ) ? slabs.end( ) : slabs.end( ) - 1,
+                rhs.slabs.begin( ), rhs.slabs.end( ) );
+  rhs.slabs.clear( );
+  rhs.freeList = NULL;
+  rhs.used = rhs.capacity = 0;
+}
+
+/**
+ * Exchange every slab and free node with rhs; nothing is copied.
+ */
+template <class Node>
+void NodePool<Node>::swap( NodePool & rhs )
+{
+  slabs.swap( rhs.slabs );
+  std::swap( freeList, rhs.freeList );
+  std::swap( used, rhs.used );
+  std::swap( capacity, rhs.capacity );
+}
+
+/**
+ * Return storage for one node from the heap.
+ */
+template <class Node>
+Node * NewDeleteAllocator<Node>::allocate( )
+{
+  return static_cast<Node *>( ::operator new( sizeof( Node ) ) );
+}
+
+/**
+ * Return the storage of node p to the heap.
+ */
+template <class Node>
+void NewDeleteAllocator<Node>::deallocate( Node *p )
+{
+  ::operator delete( p );
+}
+
+/**
+ * Nothing to do; every node was already deallocated.
+ */
+template <class Node>
+void NewDeleteAllocator<Node>::release( )
+{
+}
+
+/**
+ * Nothing to do; every node is its own heap block.
+ */
+template <class Node>
+void NewDeleteAllocator<Node>::splice( NewDeleteAllocator & )
+{
+}
+
+/**
+ * Nodes are not tied to an allocator, so there is nothing to swap.
+ */
+template <class Node>
+void NewDeleteAllocator<Node>::swap( NewDeleteAllocator & )
+{
+}
@@ -0,0 +1,89 @@
+#ifndef NODE_POOL_H_
+#define NODE_POOL_H_
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+// Node allocation policies for BinarySearchTree, selected by its
+// third template parameter.
+//
+// NodePool           : slab allocator with a free list (default)
+// NewDeleteAllocator : one operator new / delete per node
+//
+// Both hand out raw storage; the tree constructs and destroys the
+// nodes in it.
+//
+// ******************PUBLIC OPERATIONS*********************
+// Node * allocate( )     --> Return storage for one node
+// void deallocate( p )   --> Give back the storage of node p
+// void release( )        --> Give back the storage of every node at once
+// void splice( rhs )     --> Take over every node allocated from rhs
+// void swap( rhs )       --> Exchange all nodes with rhs, in O(1)
+// releasesInBulk         --> true if release( ) frees the storage itself,
+//                            so nodes need not be deallocated one by one
+
+// NodePool class
+//
+// CONSTRUCTION: with no parameters
+//
+// Storage is carved from slabs that double in size up to MAX_SLAB
+// nodes. Freed nodes go on a free list and are reused before the
+// current slab is touched. release( ) frees the slabs in O(slabs).
+
+template <class Node>
+class NodePool
+{
+ public:
+  NodePool( );
+  ~NodePool( );
+
+  Node * allocate( );
+  void deallocate( Node *p );
+  void release( );
+  void splice( NodePool & rhs );
+  void swap( NodePool & rhs );
+
+  enum { releasesInBulk = true };
+
+ private:
+  union Slot
+  {
+    Slot *next;
+    typename aligned_storage<sizeof( Node ), alignment_of<Node>::value>::type storage;
+  };
+
+  enum { MIN_SLAB = 32, MAX_SLAB = 65536 };
+
+  vector<Slot *> slabs;
+  Slot *freeList;
+  size_t used;        // Slots handed out from slabs.back( )
+  size_t capacity;    // Slots in slabs.back( )
+
+  NodePool( const NodePool & rhs );                // Disabled
+  NodePool & operator=( const NodePool & rhs );    // Disabled
+};
+
+// NewDeleteAllocator class
+//
+// CONSTRUCTION: with no parameters
+//
+// Every node is a separate heap block, as in the original tree.
+
+template <class Node>
+class NewDeleteAllocator
+{
+ public:
+  Node * allocate( );
+  void deallocate( Node *p );
+  void release( );
+  void splice( NewDeleteAllocator & rhs );
+  void swap( NewDeleteAllocator & rhs );
+
+  enum { releasesInBulk = false };
+};
+
+#include "NodePool.cpp"
+#endif
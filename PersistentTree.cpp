@@ -0,0 +1,884 @@
+#include "PersistentTree.h"
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Construct a node holding one reference for its creator and
+ * one on each child.
+ */
+template <class Comparable>
+PersistentTree<Comparable>::Node::Node( const Comparable & theElement,
+                                        const Node *lt, const Node *rt ) :
+  element( theElement ), left( acquire( lt ) ), right( acquire( rt ) ),
+  height( max( PersistentTree::height( lt ), PersistentTree::height( rt ) ) + 1 ),
+  count( PersistentTree::size( lt ) + PersistentTree::size( rt ) + 1 ),
+  refs( 1 )
+{
+}
+
+/**
+ * Construct the tree.
+ */
+template <class Comparable>
+PersistentTree<Comparable>::PersistentTree( const Comparable & notFound ) :
+  root( NULL ), ITEM_NOT_FOUND( notFound )
+{
+}
+
+/**
+ * Copy constructor; shares every node with rhs.
+ */
+template <class Comparable>
+PersistentTree<Comparable>::PersistentTree( const PersistentTree<Comparable> & rhs ) :
+  root( acquire( rhs.root ) ), ITEM_NOT_FOUND( rhs.ITEM_NOT_FOUND )
+{
+}
+
+/**
+ * Move constructor; takes over the reference of rhs without
+ * touching any reference count, and leaves rhs empty.
+ */
+template <class Comparable>
+PersistentTree<Comparable>::PersistentTree( PersistentTree<Comparable> && rhs ) :
+  root( rhs.root ), ITEM_NOT_FOUND( rhs.ITEM_NOT_FOUND )
+{
+  rhs.root = NULL;
+}
+
+/**
+ * Destructor for the tree.
+ */
+template <class Comparable>
+PersistentTree<Comparable>::~PersistentTree( )
+{
+  release( root );
+}
+
+/**
+ * Copy in O(1) by sharing the nodes of rhs.
+ */
+template <class Comparable>
+const PersistentTree<Comparable> &
+PersistentTree<Comparable>::operator=( const PersistentTree<Comparable> & rhs )
+{
+  const Node *oldRoot = root;
+
+  root = acquire( rhs.root );     // Before the release, for self-assignment
+  release( oldRoot );
+  ITEM_NOT_FOUND = rhs.ITEM_NOT_FOUND;
+  return *this;
+}
+
+/**
+ * Move assignment; takes over the reference of rhs and leaves it empty.
+ */
+template <class Comparable>
+const PersistentTree<Comparable> &
+PersistentTree<Comparable>::operator=( PersistentTree<Comparable> && rhs )
+{
+  if( this != &rhs )
+    {
+      release( root );
+      root = rhs.root;
+      rhs.root = NULL;
+      ITEM_NOT_FOUND = rhs.ITEM_NOT_FOUND;
+    }
+  return *this;
+}
+
+/**
+ * Exchange the contents of this tree and rhs.
+ */
+template <class Comparable>
+void PersistentTree<Comparable>::swap( PersistentTree<Comparable> & rhs )
+{
+  std::swap( root, rhs.root );
+  std::swap( ITEM_NOT_FOUND, rhs.ITEM_NOT_FOUND );
+}
+
+/**
+ * Find item x in the tree.
+ * Return the matching item or ITEM_NOT_FOUND if not found.
+ */
+template <class Comparable>
+const Comparable & PersistentTree<Comparable>::find( const Comparable & x ) const
+{
+  const Node *t = root;
+
+  while( t != NULL )
+    {
+      if( x < t->element )
+        t = t->left;
+      else if( t->element < x )
+        t = t->right;
+      else
+        return t->element;    // Match
+    }
+  return ITEM_NOT_FOUND;   // No match
+}
+
+/**
+ * Find the smallest item in the tree.
+ * Return smallest item or ITEM_NOT_FOUND if empty.
+ */
+template <class Comparable>
+const Comparable & PersistentTree<Comparable>::findMin( ) const
+{
+  return isEmpty( ) ? ITEM_NOT_FOUND : findMin( root )->element;
+}
+
+/**
+ * Find the largest item in the tree.
+ * Return the largest item or ITEM_NOT_FOUND if empty.
+ */
+template <class Comparable>
+const Comparable & PersistentTree<Comparable>::findMax( ) const
+{
+  return isEmpty( ) ? ITEM_NOT_FOUND : findMax( root )->element;
+}
+
+/**
+ * Test if the tree is logically empty.
+ * Return true if empty, false otherwise.
+ */
+template <class Comparable>
+bool PersistentTree<Comparable>::isEmpty( ) const
+{
+  return root == NULL;
+}
+
+/**
+ * Return the number of items, in constant time.
+ */
+template <class Comparable>
+int PersistentTree<Comparable>::size( ) const
+{
+  return size( root );
+}
+
+/**
+ * Return the number of items less than x, in time
+ * proportional to the height of the tree.
+ */
+template <class Comparable>
+int PersistentTree<Comparable>::rank( const Comparable & x ) const
+{
+  const Node *t = root;
+  int less = 0;
+
+  while( t != NULL )
+    {
+      if( t->element < x )
+        {
+          less += size( t->left ) + 1;
+          t = t->right;
+        }
+      else
+        t = t->left;
+    }
+  return less;
+}
+
+/**
+ * Find the item with exactly k smaller items, so select( 0 ) is
+ * the smallest, in time proportional to the height of the tree.
+ * Return that item or ITEM_NOT_FOUND if k is out of range.
+ */
+template <class Comparable>
+const Comparable & PersistentTree<Comparable>::select( int k ) const
+{
+  const Node *t = root;
+
+  if( k < 0 || k >= size( root ) )
+    return ITEM_NOT_FOUND;
+  for( ; ; )
+    {
+      int leftSize = size( t->left );
+      if( k < leftSize )
+        t = t->left;
+      else if( k > leftSize )
+        {
+          k -= leftSize + 1;
+          t = t->right;
+        }
+      else
+        return t->element;
+    }
+}
+
+/**
+ * Print the tree contents in sorted order.
+ */
+template <class Comparable>
+void PersistentTree<Comparable>::printTree( ) const
+{
+  if( isEmpty( ) )
+    cout << "Empty tree" << endl;
+  else
+    forEach( []( const Comparable & x ) { cout << x << " "; } );
+}
+
+/**
+ * Append the items to items in sorted order.
+ */
+template <class Comparable>
+void PersistentTree<Comparable>::flatten( vector<Comparable> & items ) const
+{
+  items.reserve( items.size( ) + size( ) );
+  forEach( [&items]( const Comparable & x ) { items.push_back( x ); } );
+}
+
+/**
+ * Call visit( item ) for each item in sorted order.
+ */
+template <class Comparable>
+template <class Visitor>
+void PersistentTree<Comparable>::forEach( Visitor visit ) const
+{
+  vector<const Node *> stack;
+  const Node *t = root;
+
+  while( t != NULL || !stack.empty( ) )
+    {
+      if( t != NULL )
+        {
+          stack.push_back( t );
+          t = t->left;
+        }
+      else
+        {
+          t = stack.back( );
+          stack.pop_back( );
+          visit( t->element );
+          t = t->right;
+        }
+    }
+}
+
+/**
+ * Call visit( item ) for each item in [lo, hi), in sorted order.
+ * Subtrees entirely below lo are skipped.
+ */
+template <class Comparable>
+template <class Visitor>
+void PersistentTree<Comparable>::range( const Comparable & lo, const Comparable & hi,
+                                        Visitor visit ) const
+{
+  vector<const Node *> stack;
+  const Node *t = root;
+
+  // The stack holds the ancestors of the next item not less than lo
+  while( t != NULL )
+    {
+      if( t->element < lo )
+        t = t->right;
+      else
+        {
+          stack.push_back( t );
+          t = t->left;
+        }
+    }
+  while( !stack.empty( ) )
+    {
+      t = stack.back( );
+      stack.pop_back( );
+      if( !( t->element < hi ) )
+        return;
+      visit( t->element );
+      for( t = t->right; t != NULL; t = t->left )
+        stack.push_back( t );
+    }
+}
+
+/**
+ * Make the tree logically empty. Nodes still used by other
+ * versions are kept.
+ */
+template <class Comparable>
+void PersistentTree<Comparable>::makeEmpty( )
+{
+  release( root );
+  root = NULL;
+}
+
+/**
+ * Insert x into the tree; duplicates are ignored.
+ */
+template <class Comparable>
+void PersistentTree<Comparable>::insert( const Comparable & x )
+{
+  bool changed;
+  const Node *newRoot = insert( x, root, changed );
+
+  if( changed )
+    {
+      release( root );
+      root = newRoot;
+    }
+}
+
+/**
+ * Remove x from the tree. Nothing is done if x is not found.
+ */
+template <class Comparable>
+void PersistentTree<Comparable>::remove( const Comparable & x )
+{
+  bool changed;
+  const Node *newRoot = remove( x, root, changed );
+
+  if( changed )
+    {
+      release( root );
+      root = newRoot;
+    }
+}
+
+/**
+ * Replace the contents of the tree with the sorted, duplicate-free
+ * items, as a tree of minimum height.
+ */
+template <class Comparable>
+void PersistentTree<Comparable>::assign( const vector<Comparable> & sorted )
+{
+  const Node *newRoot = build( sorted, 0, (int) sorted.size( ) - 1 );
+
+  release( root );
+  root = newRoot;
+}
+
+/*
+ *  Union : adds the elements of rhs
+ */
+template <class Comparable>
+void PersistentTree<Comparable>::Union( const PersistentTree<Comparable> & rhs )
+{
+  vector<Comparable> theirs;
+
+  rhs.flatten( theirs );
+  absorb( theirs );
+}
+
+/*
+ * Intersection: adds the elements found in both trees
+ */
+template <class Comparable>
+void PersistentTree<Comparable>::Intersection( const PersistentTree<Comparable> & tree1,
+                                               const PersistentTree<Comparable> & tree2 )
+{
+  vector<Comparable> items1;
+  vector<Comparable> items2;
+  vector<Comparable> result;
+
+  tree1.flatten( items1 );
+  tree2.flatten( items2 );
+  set_intersection( items1.begin( ), items1.end( ), items2.begin( ), items2.end( ),
+                    back_inserter( result ) );
+  absorb( result );
+}
+
+/*
+ * Difference: adds the elements of tree1 that are not in tree2
+ */
+template <class Comparable>
+void PersistentTree<Comparable>::Difference( const PersistentTree<Comparable> & tree1,
+                                             const PersistentTree<Comparable> & tree2 )
+{
+  vector<Comparable> items1;
+  vector<Comparable> items2;
+  vector<Comparable> result;
+
+  tree1.flatten( items1 );
+  tree2.flatten( items2 );
+  set_difference( items1.begin( ), items1.end( ), items2.begin( ), items2.end( ),
+                  back_inserter( result ) );
+  absorb( result );
+}
+
+/*
+ * SymmetricDifference: adds the elements found in exactly one tree
+ */
+template <class Comparable>
+void PersistentTree<Comparable>::SymmetricDifference( const PersistentTree<Comparable> & tree1,
+                                                      const PersistentTree<Comparable> & tree2 )
+{
+  vector<Comparable> items1;
+  vector<Comparable> items2;
+  vector<Comparable> result;
+
+  tree1.flatten( items1 );
+  tree2.flatten( items2 );
+  set_symmetric_difference( items1.begin( ), items1.end( ),
+                            items2.begin( ), items2.end( ),
+                            back_inserter( result ) );
+  absorb( result );
+}
+
+/**
+ * Return an iterator to the smallest item.
+ */
+template <class Comparable>
+typename PersistentTree<Comparable>::const_iterator
+PersistentTree<Comparable>::begin( ) const
+{
+  const_iterator itr( this );
+
+  for( const Node *t = root; t != NULL; t = t->left )
+    itr.path.push_back( t );
+  return itr;
+}
+
+/**
+ * Return the iterator past the largest item.
+ */
+template <class Comparable>
+typename PersistentTree<Comparable>::const_iterator
+PersistentTree<Comparable>::end( ) const
+{
+  return const_iterator( this );
+}
+
+/**
+ * Return an iterator to the first item not less than x,
+ * or end( ) if there is none.
+ */
+template <class Comparable>
+typename PersistentTree<Comparable>::const_iterator
+PersistentTree<Comparable>::lower_bound( const Comparable & x ) const
+{
+  const_iterator itr( this );
+  size_t bound = 0;     // Path length up to the best candidate so far
+
+  for( const Node *t = root; t != NULL; )
+    {
+      itr.path.push_back( t );
+      if( t->element < x )
+        t = t->right;
+      else
+        {
+          bound = itr.path.size( );
+          t = t->left;
+        }
+    }
+  itr.path.resize( bound );
+  return itr;
+}
+
+/**
+ * Return an iterator to the first item greater than x,
+ * or end( ) if there is none.
+ */
+template <class Comparable>
+typename PersistentTree<Comparable>::const_iterator
+PersistentTree<Comparable>::upper_bound( const Comparable & x ) const
+{
+  const_iterator itr( this );
+  size_t bound = 0;     // Path length up to the best candidate so far
+
+  for( const Node *t = root; t != NULL; )
+    {
+      itr.path.push_back( t );
+      if( x < t->element )
+        {
+          bound = itr.path.size( );
+          t = t->left;
+        }
+      else
+        t = t->right;
+    }
+  itr.path.resize( bound );
+  return itr;
+}
+
+/**
+ * Return the items equal to x as a range of iterators;
+ * it holds at most one item.
+ */
+template <class Comparable>
+pair<typename PersistentTree<Comparable>::const_iterator,
+     typename PersistentTree<Comparable>::const_iterator>
+PersistentTree<Comparable>::equal_range( const Comparable & x ) const
+{
+  return make_pair( lower_bound( x ), upper_bound( x ) );
+}
+
+/**
+ * Internal method to insert into a subtree.
+ * x is the item to insert.
+ * t is the node that roots the subtree.
+ * Return the root of the new version of the subtree, or NULL with
+ * changed false if x was already present.
+ */
+template <class Comparable>
+const typename PersistentTree<Comparable>::Node *
+PersistentTree<Comparable>::insert( const Comparable & x, const Node *t, bool & changed )
+{
+  const Node *child;
+  const Node *result;
+
+  changed = true;
+  if( t == NULL )
+    return new Node( x, NULL, NULL );
+  if( x < t->element )
+    {
+      child = insert( x, t->left, changed );
+      if( !changed )
+        return NULL;
+      result = balance( t->element, child, t->right );
+    }
+  else if( t->element < x )
+    {
+      child = insert( x, t->right, changed );
+      if( !changed )
+        return NULL;
+      result = balance( t->element, t->left, child );
+    }
+  else
+    {
+      changed = false;   // Duplicate; do nothing
+      return NULL;
+    }
+  release( child );
+  return result;
+}
+
+/**
+ * Internal method to remove from a subtree.
+ * x is the item to remove.
+ * t is the node that roots the subtree.
+ * Return the root of the new version of the subtree, with changed
+ * false if x was not found.
+ */
+template <class Comparable>
+const typename PersistentTree<Comparable>::Node *
+PersistentTree<Comparable>::remove( const Comparable & x, const Node *t, bool & changed )
+{
+  const Node *child;
+  const Node *result;
+
+  changed = false;
+  if( t == NULL )
+    return NULL;   // Item not found; do nothing
+  if( x < t->element )
+    {
+      child = remove( x, t->left, changed );
+      if( !changed )
+        return NULL;
+      result = balance( t->element, child, t->right );
+    }
+  else if( t->element < x )
+    {
+      child = remove( x, t->right, changed );
+      if( !changed )
+        return NULL;
+      result = balance( t->element, t->left, child );
+    }
+  else
+    {
+      changed = true;
+      if( t->left == NULL )
+        return acquire( t->right );
+      if( t->right == NULL )
+        return acquire( t->left );
+
+      // Two children: the successor takes t's place
+      const Node *min;
+      child = removeMin( t->right, min );
+      result = balance( min->element, t->left, child );
+    }
+  release( child );
+  return result;
+}
+
+/**
+ * Internal method to remove the smallest node of subtree t, which
+ * must not be empty, and return it in min. min stays valid as long
+ * as t does.
+ * Return the root of the new version of the subtree.
+ */
+template <class Comparable>
+const typename PersistentTree<Comparable>::Node *
+PersistentTree<Comparable>::removeMin( const Node *t, const Node * & min )
+{
+  if( t->left == NULL )
+    {
+      min = t;
+      return acquire( t->right );
+    }
+
+  const Node *child = removeMin( t->left, min );
+  const Node *result = balance( t->element, child, t->right );
+  release( child );
+  return result;
+}
+
+/**
+ * Internal method to build a node holding x over subtrees lt and
+ * rt, whose heights differ by at most two, restoring the AVL
+ * condition. The rotations build new nodes rather than relink
+ * lt or rt, which other versions may share.
+ */
+template <class Comparable>
+const typename PersistentTree<Comparable>::Node *
+PersistentTree<Comparable>::balance( const Comparable & x, const Node *lt, const Node *rt )
+{
+  const Node *a;
+  const Node *b = NULL;
+  const Node *result;
+
+  if( height( lt ) - height( rt ) > 1 )
+    {
+      if( height( lt->left ) >= height( lt->right ) )
+        {
+          a = new Node( x, lt->right, rt );
+          result = new Node( lt->element, lt->left, a );
+        }
+      else
+        {
+          const Node *mid = lt->right;
+          a = new Node( lt->element, lt->left, mid->left );
+          b = new Node( x, mid->right, rt );
+          result = new Node( mid->element, a, b );
+        }
+    }
+  else if( height( rt ) - height( lt ) > 1 )
+    {
+      if( height( rt->right ) >= height( rt->left ) )
+        {
+          a = new Node( x, lt, rt->left );
+          result = new Node( rt->element, a, rt->right );
+        }
+      else
+        {
+          const Node *mid = rt->left;
+          a = new Node( x, lt, mid->left );
+          b = new Node( rt->element, mid->right, rt->right );
+          result = new Node( mid->element, a, b );
+        }
+    }
+  else
+    return new Node( x, lt, rt );
+
+  release( a );
+  release( b );
+  return result;
+}
+
+/**
+ * Internal method to build a subtree from sorted[ low..high ].
+ */
+template <class Comparable>
+const typename PersistentTree<Comparable>::Node *
+PersistentTree<Comparable>::build( const vector<Comparable> & sorted, int low, int high )
+{
+  if( low > high )
+    return NULL;
+
+  int mid = low + ( high - low ) / 2;
+  const Node *lt = build( sorted, low, mid - 1 );
+  const Node *rt = build( sorted, mid + 1, high );
+  const Node *t = new Node( sorted[ mid ], lt, rt );
+
+  release( lt );
+  release( rt );
+  return t;
+}
+
+/**
+ * Internal method to add the sorted, duplicate-free items to the
+ * tree; the result is rebuilt with minimum height.
+ */
+template <class Comparable>
+void PersistentTree<Comparable>::absorb( const vector<Comparable> & sorted )
+{
+  vector<Comparable> mine;
+  vector<Comparable> result;
+
+  if( sorted.empty( ) )
+    return;
+  flatten( mine );
+  result.reserve( mine.size( ) + sorted.size( ) );
+  set_union( mine.begin( ), mine.end( ), sorted.begin( ), sorted.end( ),
+             back_inserter( result ) );
+  assign( result );
+}
+
+/**
+ * Internal method to find the smallest node in a subtree t.
+ */
+template <class Comparable>
+const typename PersistentTree<Comparable>::Node *
+PersistentTree<Comparable>::findMin( const Node *t ) const
+{
+  if( t != NULL )
+    while( t->left != NULL )
+      t = t->left;
+  return t;
+}
+
+/**
+ * Internal method to find the largest node in a subtree t.
+ */
+template <class Comparable>
+const typename PersistentTree<Comparable>::Node *
+PersistentTree<Comparable>::findMax( const Node *t ) const
+{
+  if( t != NULL )
+    while( t->right != NULL )
+      t = t->right;
+  return t;
+}
+
+/**
+ * Return the height of node t or -1 if NULL.
+ */
+template <class Comparable>
+int PersistentTree<Comparable>::height( const Node *t )
+{
+  return t == NULL ? -1 : t->height;
+}
+
+/**
+ * Return the number of nodes in subtree t or 0 if NULL.
+ */
+template <class Comparable>
+int PersistentTree<Comparable>::size( const Node *t )
+{
+  return t == NULL ? 0 : t->count;
+}
+
+/**
+ * Internal method to take a reference to t, which may be NULL.
+ * Return t.
+ */
+template <class Comparable>
+const typename PersistentTree<Comparable>::Node *
+PersistentTree<Comparable>::acquire( const Node *t )
+{
+  if( t != NULL )
+    t->refs.fetch_add( 1, memory_order_relaxed );
+  return t;
+}
+
+/**
+ * Internal method to drop a reference to t, which may be NULL.
+ * Nodes left without references are freed, and their children
+ * released in turn.
+ */
+template <class Comparable>
+void PersistentTree<Comparable>::release( const Node *t )
+{
+  vector<const Node *> stack;
+
+  while( t != NULL )
+    {
+      if( t->refs.fetch_sub( 1, memory_order_acq_rel ) == 1 )
+        {
+          if( t->left != NULL )
+            stack.push_back( t->left );
+          if( t->right != NULL )
+            stack.push_back( t->right );
+          delete t;
+        }
+      if( stack.empty( ) )
+        break;
+      t = stack.back( );
+      stack.pop_back( );
+    }
+}
+
+template <class Comparable>
+const Comparable & PersistentTree<Comparable>::const_iterator::operator*( ) const
+{
+  return path.back( )->element;
+}
+
+template <class Comparable>
+const Comparable * PersistentTree<Comparable>::const_iterator::operator->( ) const
+{
+  return &path.back( )->element;
+}
+
+template <class Comparable>
+typename PersistentTree<Comparable>::const_iterator &
+PersistentTree<Comparable>::const_iterator::operator++( )
+{
+  const Node *t = path.back( );
+
+  if( t->right != NULL )
+    for( t = t->right; t != NULL; t = t->left )
+      path.push_back( t );
+  else
+    {
+      // Climb until we come up from a left child
+      do
+        {
+          t = path.back( );
+          path.pop_back( );
+        }
+      while( !path.empty( ) && path.back( )->right == t );
+    }
+  return *this;
+}
+
+template <class Comparable>
+typename PersistentTree<Comparable>::const_iterator
+PersistentTree<Comparable>::const_iterator::operator++( int )
+{
+  const_iterator old = *this;
+  ++*this;
+  return old;
+}
+
+template <class Comparable>
+typename PersistentTree<Comparable>::const_iterator &
+PersistentTree<Comparable>::const_iterator::operator--( )
+{
+  const Node *t;
+
+  if( path.empty( ) )
+    for( t = tree->root; t != NULL; t = t->right )
+      path.push_back( t );
+  else if( ( t = path.back( ) )->left != NULL )
+    for( t = t->left; t != NULL; t = t->right )
+      path.push_back( t );
+  else
+    {
+      // Climb until we come up from a right child
+      do
+        {
+          t = path.back( );
+          path.pop_back( );
+        }
+      while( !path.empty( ) && path.back( )->left == t );
+    }
+  return *this;
+}
+
+template <class Comparable>
+typename PersistentTree<Comparable>::const_iterator
+PersistentTree<Comparable>::const_iterator::operator--( int )
+{
+  const_iterator old = *this;
+  --*this;
+  return old;
+}
+
+template <class Comparable>
+bool PersistentTree<Comparable>::const_iterator::
+operator==( const const_iterator & rhs ) const
+{
+  if( tree != rhs.tree || path.empty( ) != rhs.path.empty( ) )
+    return false;
+  return path.empty( ) || path.back( ) == rhs.path.back( );
+}
+
+template <class Comparable>
+bool PersistentTree<Comparable>::const_iterator::
+operator!=( const const_iterator & rhs ) const
+{
+  return !( *this == rhs );
+}
@@ -0,0 +1,166 @@
+#ifndef PERSISTENT_TREE_H_
+#define PERSISTENT_TREE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <iostream>       // For NULL
+#include <iterator>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// PersistentTree class
+//
+// CONSTRUCTION: with ITEM_NOT_FOUND object used to signal failed finds
+//
+// An AVL tree whose copies share structure. Nodes are never changed
+// once built: an update copies the O(log n) nodes on the path to
+// the change and shares every other subtree with the old version.
+// Copying a tree is O(1), and a copy taken before an update still
+// reads the old contents, so copies serve as cheap checkpoints.
+//
+// Nodes are reference counted and freed with the last version that
+// uses them. Counts are atomic, so trees sharing nodes may be used
+// from different threads; a single tree is not thread-safe.
+//
+// ******************PUBLIC OPERATIONS*********************
+// void insert( x )       --> Insert x
+// void remove( x )       --> Remove x
+// void assign( sorted )  --> Replace contents with sorted, distinct items
+// Comparable find( x )   --> Return item that matches x
+// Comparable findMin( )  --> Return smallest item
+// Comparable findMax( )  --> Return largest item
+// boolean isEmpty( )     --> Return true if empty; else false
+// int size( )            --> Return number of items
+// int rank( x )          --> Return number of items less than x
+// Comparable select( k ) --> Return item of rank k (0 is smallest)
+// void makeEmpty( )      --> Remove all items
+// void swap( rhs )       --> Exchange contents with rhs, in O(1)
+// void printTree( )      --> Print tree in sorted order
+// void flatten( items )  --> Append the items to items in sorted order
+// void forEach( f )      --> Call f( item ) for each item in sorted order
+// void range( lo, hi, f )   --> Call f( item ) for each item in [lo, hi)
+// begin( ), end( )       --> Iterate over the items in sorted order
+// lower_bound( x )       --> Iterator to first item not less than x
+// upper_bound( x )       --> Iterator to first item greater than x
+// equal_range( x )       --> Pair of lower_bound( x ) and upper_bound( x )
+// void Union( rhs )                     --> Add the elements of rhs
+// void Intersection( t1, t2 )           --> Add elements in both t1 and t2
+// void Difference( t1, t2 )             --> Add elements in t1 but not t2
+// void SymmetricDifference( t1, t2 )    --> Add elements in exactly one
+//
+// Nodes have no parent links, since a shared node has one parent
+// per version; iterators keep the path from the root instead.
+// Any update of a tree invalidates its iterators, while iterators
+// into other versions stay valid.
+
+template <class Comparable>
+class PersistentTree
+{
+ private:
+  struct Node;
+
+ public:
+  class const_iterator
+  {
+   public:
+    typedef bidirectional_iterator_tag iterator_category;
+    typedef Comparable value_type;
+    typedef ptrdiff_t difference_type;
+    typedef const Comparable * pointer;
+    typedef const Comparable & reference;
+
+    const_iterator( ) : tree( NULL ) { }
+
+    const Comparable & operator*( ) const;
+    const Comparable * operator->( ) const;
+    const_iterator & operator++( );
+    const_iterator operator++( int );
+    const_iterator & operator--( );
+    const_iterator operator--( int );
+    bool operator==( const const_iterator & rhs ) const;
+    bool operator!=( const const_iterator & rhs ) const;
+
+   private:
+    const PersistentTree *tree;
+    vector<const Node *> path;    // Root down to the current node; empty is end( )
+
+    explicit const_iterator( const PersistentTree *t ) : tree( t ) { }
+    friend class PersistentTree<Comparable>;
+  };
+
+  explicit PersistentTree( const Comparable & notFound );
+  PersistentTree( const PersistentTree & rhs );
+  PersistentTree( PersistentTree && rhs );
+  ~PersistentTree( );
+
+  const Comparable & find( const Comparable & x ) const;
+  const Comparable & findMin( ) const;
+  const Comparable & findMax( ) const;
+  bool isEmpty( ) const;
+  int size( ) const;
+  int rank( const Comparable & x ) const;
+  const Comparable & select( int k ) const;
+  void printTree( ) const;
+  void flatten( vector<Comparable> & items ) const;
+  template <class Visitor>
+  void forEach( Visitor visit ) const;
+  template <class Visitor>
+  void range( const Comparable & lo, const Comparable & hi, Visitor visit ) const;
+
+  void makeEmpty( );
+  void insert( const Comparable & x );
+  void remove( const Comparable & x );
+  void assign( const vector<Comparable> & sorted );
+
+  void Union( const PersistentTree & rhs );
+  void Intersection( const PersistentTree & tree1, const PersistentTree & tree2 );
+  void Difference( const PersistentTree & tree1, const PersistentTree & tree2 );
+  void SymmetricDifference( const PersistentTree & tree1, const PersistentTree & tree2 );
+
+  const_iterator begin( ) const;
+  const_iterator end( ) const;
+  const_iterator lower_bound( const Comparable & x ) const;
+  const_iterator upper_bound( const Comparable & x ) const;
+  pair<const_iterator, const_iterator> equal_range( const Comparable & x ) const;
+
+  const PersistentTree & operator=( const PersistentTree & rhs );
+  const PersistentTree & operator=( PersistentTree && rhs );
+  void swap( PersistentTree & rhs );
+
+ private:
+  struct Node
+  {
+    const Comparable element;
+    const Node * const left;
+    const Node * const right;
+    const int height;
+    const int count;              // Nodes in the subtree rooted here
+    mutable atomic<int> refs;     // Trees and nodes pointing here
+
+    Node( const Comparable & theElement, const Node *lt, const Node *rt );
+  };
+
+  const Node *root;
+  Comparable ITEM_NOT_FOUND;
+
+  // The internal methods return nodes with one reference owned by
+  // the caller; the nodes passed to them are borrowed.
+  const Node * insert( const Comparable & x, const Node *t, bool & changed );
+  const Node * remove( const Comparable & x, const Node *t, bool & changed );
+  const Node * removeMin( const Node *t, const Node * & min );
+  const Node * balance( const Comparable & x, const Node *lt, const Node *rt );
+  const Node * build( const vector<Comparable> & sorted, int low, int high );
+  const Node * findMin( const Node *t ) const;
+  const Node * findMax( const Node *t ) const;
+  void absorb( const vector<Comparable> & sorted );
+
+  static int height( const Node *t );
+  static int size( const Node *t );
+  static const Node * acquire( const Node *t );
+  static void release( const Node *t );
+};
+
+#include "PersistentTree.cpp"
+#endif
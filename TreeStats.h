@@ -0,0 +1,193 @@
+#ifndef TREE_STATS_H_
+#define TREE_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <stdint.h>
+
+using namespace std;
+
+// Statistics kept by BinarySearchTree.
+//
+// The counters are compiled in only when BINARY_SEARCH_TREE_STATS is
+// defined (the CMake option BSTREE_STATS does this for the library
+// and everything linked to it). Otherwise TREE_STAT( code ) expands
+// to nothing, the trees hold no counters, and stats( ) reports only
+// the size (and the height, with BINARY_SEARCH_TREE_SHAPE), with
+// enabled == false. The macro must be set the same
+// way in every file that includes the trees.
+//
+// Operation counters are relaxed atomics, so finds running on
+// several threads may share a tree while it counts. The depth sum
+// is changed only by updates and follows the nodes on swap and move.
+
+#if defined( BINARY_SEARCH_TREE_STATS )
+#define TREE_STAT( ... ) __VA_ARGS__
+#else
+#define TREE_STAT( ... )
+#endif
+
+// Operation latencies, in power of two buckets of nanoseconds:
+// bucket k counts operations that took less than 2^k ns and at
+// least 2^( k - 1 ); the last bucket also takes everything slower.
+struct LatencyHistogram
+{
+  enum { BUCKETS = 32 };
+
+  uint64_t count;
+  uint64_t totalNanos;
+  uint64_t buckets[ BUCKETS ];
+};
+
+// A snapshot of the statistics of one tree
+struct TreeStats
+{
+  bool enabled;                 // false if the counters were compiled out
+  uint64_t size;                // Items in the tree
+  uint64_t depthSum;            // Sum of the depths of all nodes; root is 0
+  int maxDepth;                 // Deepest node reached by an operation
+  bool shaped;                  // true if the nodes keep their height
+  int height;                   // Height of the tree, -1 if empty; if shaped
+
+  uint64_t finds;               // Calls of find( x )
+  uint64_t findComparisons;     // Key comparisons made by those finds; a
+                                // three-way comparison counts once
+  uint64_t inserts;             // Items added one at a time
+  uint64_t removes;             // Items removed one at a time
+  uint64_t allocations;         // Nodes constructed, bulk builds included
+  uint64_t rotations;           // Single rotations; a double counts two
+
+  LatencyHistogram findLatency;
+  LatencyHistogram insertLatency;
+  LatencyHistogram removeLatency;
+
+  double averageDepth( ) const
+    { return size == 0 ? 0.0 : (double) depthSum / size; }
+  double comparisonsPerFind( ) const
+    { return finds == 0 ? 0.0 : (double) findComparisons / finds; }
+};
+
+// The live counters behind one LatencyHistogram
+class LatencyCounters
+{
+ public:
+  LatencyCounters( ) { reset( ); }
+
+  void record( uint64_t nanos )
+  {
+    int k = 0;
+    while( k < LatencyHistogram::BUCKETS - 1 && ( nanos >> k ) != 0 )
+      k++;
+    count.fetch_add( 1, memory_order_relaxed );
+    totalNanos.fetch_add( nanos, memory_order_relaxed );
+    buckets[ k ].fetch_add( 1, memory_order_relaxed );
+  }
+
+  void reset( )
+  {
+    count.store( 0, memory_order_relaxed );
+    totalNanos.store( 0, memory_order_relaxed );
+    for( int k = 0; k < LatencyHistogram::BUCKETS; k++ )
+      buckets[ k ].store( 0, memory_order_relaxed );
+  }
+
+  void snapshot( LatencyHistogram & h ) const
+  {
+    h.count = count.load( memory_order_relaxed );
+    h.totalNanos = totalNanos.load( memory_order_relaxed );
+    for( int k = 0; k < LatencyHistogram::BUCKETS; k++ )
+      h.buckets[ k ] = buckets[ k ].load( memory_order_relaxed );
+  }
+
+ private:
+  atomic<uint64_t> count;
+  atomic<uint64_t> totalNanos;
+  atomic<uint64_t> buckets[ LatencyHistogram::BUCKETS ];
+};
+
+// Records the time from its construction to its destruction
+class LatencyTimer
+{
+ public:
+  explicit LatencyTimer( LatencyCounters & c )
+    : counters( c ), start( chrono::steady_clock::now( ) ) { }
+  ~LatencyTimer( )
+  {
+    counters.record( chrono::duration_cast<chrono::nanoseconds>(
+                       chrono::steady_clock::now( ) - start ).count( ) );
+  }
+
+ private:
+  LatencyCounters & counters;
+  chrono::steady_clock::time_point start;
+
+  LatencyTimer( const LatencyTimer & );
+  const LatencyTimer & operator=( const LatencyTimer & );
+};
+
+// The live counters of one tree
+class TreeCounters
+{
+ public:
+  atomic<uint64_t> finds;
+  atomic<uint64_t> findComparisons;
+  atomic<uint64_t> inserts;
+  atomic<uint64_t> removes;
+  atomic<uint64_t> allocations;
+  atomic<uint64_t> rotations;
+  atomic<int> maxDepth;
+  long long depthSum;       // Kept by the tree; not cleared by reset( )
+  LatencyCounters findLatency;
+  LatencyCounters insertLatency;
+  LatencyCounters removeLatency;
+
+  TreeCounters( ) : depthSum( 0 ) { reset( ); }
+
+  void count( atomic<uint64_t> & counter, uint64_t n = 1 )
+    { counter.fetch_add( n, memory_order_relaxed ); }
+
+  void reachDepth( int depth )
+  {
+    int deepest = maxDepth.load( memory_order_relaxed );
+    while( depth > deepest &&
+           !maxDepth.compare_exchange_weak( deepest, depth, memory_order_relaxed ) )
+      ;
+  }
+
+  void reset( )
+  {
+    finds.store( 0, memory_order_relaxed );
+    findComparisons.store( 0, memory_order_relaxed );
+    inserts.store( 0, memory_order_relaxed );
+    removes.store( 0, memory_order_relaxed );
+    allocations.store( 0, memory_order_relaxed );
+    rotations.store( 0, memory_order_relaxed );
+    maxDepth.store( 0, memory_order_relaxed );
+    findLatency.reset( );
+    insertLatency.reset( );
+    removeLatency.reset( );
+  }
+
+  void snapshot( TreeStats & s ) const
+  {
+    s.enabled = true;
+    s.depthSum = depthSum;
+    s.maxDepth = maxDepth.load( memory_order_relaxed );
+    s.finds = finds.load( memory_order_relaxed );
+    s.findComparisons = findComparisons.load( memory_order_relaxed );
+    s.inserts = inserts.load( memory_order_relaxed );
+    s.removes = removes.load( memory_order_relaxed );
+    s.allocations = allocations.load( memory_order_relaxed );
+    s.rotations = rotations.load( memory_order_relaxed );
+    findLatency.snapshot( s.findLatency );
+    insertLatency.snapshot( s.insertLatency );
+    removeLatency.snapshot( s.removeLatency );
+  }
+
+ private:
+  TreeCounters( const TreeCounters & );
+  const TreeCounters & operator=( const TreeCounters & );
+};
+
+#endif
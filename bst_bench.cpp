@@ -0,0 +1,1325 @@
+// bst_bench: benchmarks for the trees in this directory
+//
+// Usage: bst_bench [--suites LIST] [--sizes LIST] [--dists LIST]
+//                  [--threads LIST] [--batches LIST] [--widths LIST]
+//                  [--seed N] [--out FILE]
+//
+// LISTs are comma separated. Sizes and batches take K, M and G
+// suffixes (powers of 1000), e.g. --sizes 1K,1M,100M.
+//
+// Suites (default: all)
+//   core        insert, find, remove, copy, Union, Intersection,
+//               IsComplete, IPL and EPL on every tree and engine,
+//               with the height the inserts left BinarySearchTree at
+//   lookup      finds on the original recursive tree against the
+//               iterative BinarySearchTree, grown by the same inserts
+//   setops      Union, Intersection and bulk assign as set operation
+//               threads go from 1 to --threads
+//   frozen      FrozenTree lookups next to the AVL tree it froze, and
+//               save / load of its file
+//   concurrent  ConcurrentTree against a locked AVL tree under 95/5
+//               and 50/50 read/write mixes
+//   persistent  O(1) copies and updates under a live snapshot
+//   batch       insertBatch / findBatch against single-key calls
+//   interleave  findMany at each --widths interleave width against
+//               single finds, on a red-black tree; batch is the width
+//   splay       Zipfian finds (theta 0.99), replayed ZIPF_PASSES times,
+//               on splay, semi-splay and frequency-aware splay trees
+//               next to the plain and red-black trees
+//   memory      heap bytes per key of the red-black tree, CompactTree
+//               (grown by inserts and built by assign), the B+ tree
+//               and a frozen snapshot
+//   churn       a red-black tree kept at a steady size by removes
+//               and inserts, CHURN_PASSES times over its keys, with
+//               NodePool and with operator new per node
+//
+// Distributions (default: random,sorted,zipf) give the key order:
+//   random      keys inserted and looked up in random order
+//   sorted      keys inserted and looked up in ascending order
+//   zipf        keys inserted in random order, looked up and removed
+//               with Zipfian skew (theta 0.99) over random hot keys
+//
+// Every measurement is one JSON object in "results"; ns_per_op is
+// seconds / ops; the memory suite adds bytes, the growth of the heap
+// while the structure was built, and bytes_per_key. It needs glibc
+// 2.33 or later to read the heap and is skipped elsewhere; so is the
+// churn suite, which adds the same and rss, the growth of the
+// resident set, after the build and again after the churn. The core
+// inserts into BinarySearchTree add height, taken after the timing.
+// Results go to FILE, or stdout; progress to stderr.
+// The plain search tree is quadratic on sorted keys, so the lookup
+// suite runs it only up to SORTED_UNBALANCED_LIMIT keys there.
+
+#include "BSTree.h"
+#include "BinarySearchTree.h"
+#include "CompactTree.h"
+#include "ConcurrentTree.h"
+#include "FrozenTree.h"
+#include "IntBTree.h"
+#include "NodePool.h"
+#include "PersistentTree.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <sstream>
+#include <stdint.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined( __GLIBC__ ) && ( __GLIBC__ > 2 || __GLIBC_MINOR__ >= 33 )
+#include <malloc.h>
+#include <unistd.h>
+#define BENCH_HEAP_STATS 1
+#endif
+
+using namespace std;
+
+enum { SORTED_UNBALANCED_LIMIT = 20000 };
+enum { CONCURRENT_OPS = 200000 };   // Operations per thread
+enum { UPDATE_OPS = 100000 };       // Inserts timed by the persistent suite
+enum { SPLAY_DEPTH = 4 };           // Depth the semi-splaying tree stops at
+enum { SPLAY_HITS = 2 };            // Hits adapt( ) splays at
+enum { ZIPF_PASSES = 4 };           // Replays of the splay suite's trace
+enum { CHURN_PASSES = 4 };          // Removes per key in the churn suite
+enum { CHURN_OUT = 8 };             // One key in CHURN_OUT is out at a time
+
+// Keeps results alive so the optimizer cannot drop the work
+static volatile long long sink;
+
+struct Options
+{
+  vector<string> suites;
+  vector<long long> sizes;
+  vector<string> dists;
+  vector<long long> threads;
+  vector<long long> batches;
+  vector<long long> widths;
+  unsigned seed;
+  string out;
+};
+
+struct Result
+{
+  string suite;
+  string op;
+  string tree;
+  string dist;
+  long long size;
+  long long threads;
+  long long batch;
+  long long ops;
+  double seconds;
+  long long bytes;        // Heap growth, for the memory suite; else 0
+  int height;             // Height after the core inserts; else -1
+  long long rss;          // Resident set growth, for the churn suite; else 0
+};
+
+// Keys for one size and distribution
+struct Workload
+{
+  string dist;
+  vector<int> keys;       // Distinct keys, in insertion order
+  vector<int> probes;     // Keys to look up and remove, in access order
+  vector<int> others;     // Keys of a second tree; half are in keys
+};
+
+static vector<Result> results;
+
+/**
+ * Record one measurement and report it on stderr.
+ */
+static void record( const string & suite, const string & op, const string & tree,
+                    const string & dist, long long size, long long threads,
+                    long long batch, long long ops, double seconds,
+                    long long bytes = 0, int height = -1, long long rss = 0 )
+{
+  Result r = { suite, op, tree, dist, size, threads, batch, ops, seconds, bytes,
+               height, rss };
+
+  results.push_back( r );
+  cerr << suite << " " << op << " " << tree << " " << dist << " n=" << size
+       << " threads=" << threads;
+  if( batch > 0 )
+    cerr << " batch=" << batch;
+  cerr << ": " << seconds * 1e9 / max( 1LL, ops ) << " ns/op";
+  if( bytes > 0 )
+    cerr << ", " << (double) bytes / max( 1LL, size ) << " bytes/key";
+  if( height >= 0 )
+    cerr << ", height " << height;
+  if( rss > 0 )
+    cerr << ", " << (double) rss / max( 1LL, size ) << " rss bytes/key";
+  cerr << endl;
+}
+
+/**
+ * Return the seconds taken by f( ).
+ */
+template <class Function>
+static double timeIt( Function f )
+{
+  chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+
+  f( );
+  return chrono::duration<double>( chrono::steady_clock::now( ) - start ).count( );
+}
+
+/**
+ * Map 0, 1, 2, ... to distinct ints in scrambled order; multiplying
+ * by an odd constant is a bijection on 32 bits.
+ */
+static int scramble( uint32_t i )
+{
+  return (int) ( i * 2654435761u );
+}
+
+/**
+ * Draws ranks 0.. n - 1 with Zipfian skew, by the method of Gray et
+ * al., "Quickly generating billion-record synthetic databases".
+ */
+class Zipf
+{
+ public:
+  Zipf( long long n, double theta ) : n( n ), theta( theta ), uniform( 0.0, 1.0 )
+  {
+    zetaN = zeta( n );
+    alpha = 1.0 / ( 1.0 - theta );
+    eta = ( 1.0 - pow( 2.0 / n, 1.0 - theta ) ) / ( 1.0 - zeta( 2 ) / zetaN );
+  }
+
+  long long next( mt19937 & rng )
+  {
+    double u = uniform( rng );
+    double uz = u * zetaN;
+
+    if( uz < 1.0 )
+      return 0;
+    if( uz < 1.0 + pow( 0.5, theta ) )
+      return min( 1LL, n - 1 );
+    return min( (long long) ( n * pow( eta * u - eta + 1.0, alpha ) ), n - 1 );
+  }
+
+ private:
+  long long n;
+  double theta;
+  double zetaN;
+  double alpha;
+  double eta;
+  uniform_real_distribution<double> uniform;
+
+  double zeta( long long count ) const
+  {
+    double sum = 0;
+
+    for( long long i = 1; i <= count; i++ )
+      sum += 1.0 / pow( (double) i, theta );
+    return sum;
+  }
+};
+
+/**
+ * Build the keys for n items in distribution dist.
+ */
+static Workload makeWorkload( const string & dist, long long n, unsigned seed )
+{
+  Workload w;
+  mt19937 rng( seed );
+
+  w.dist = dist;
+  w.keys.resize( n );
+  w.probes.resize( n );
+  w.others.resize( n );
+  for( long long i = 0; i < n; i++ )
+    {
+      w.keys[ i ] = ( dist == "sorted" ) ? (int) ( 2 * i - n ) : scramble( i );
+      w.others[ i ] = ( i % 2 == 0 ) ? w.keys[ i ]
+                      : ( dist == "sorted" ) ? (int) ( 2 * i - n + 1 )
+                      : scramble( i + n );
+    }
+
+  if( dist == "sorted" )
+    w.probes = w.keys;
+  else if( dist == "zipf" )
+    {
+      Zipf zipf( n, 0.99 );
+      for( long long i = 0; i < n; i++ )
+        w.probes[ i ] = w.keys[ zipf.next( rng ) ];
+    }
+  else
+    {
+      uniform_int_distribution<long long> pick( 0, n - 1 );
+      for( long long i = 0; i < n; i++ )
+        w.probes[ i ] = w.keys[ pick( rng ) ];
+    }
+  return w;
+}
+
+/**
+ * The search tree as it was before its internals became loops: one
+ * recursive call per level in insert, find and makeEmpty, and one
+ * operator new per node. The lookup suite times its finds as the
+ * baseline for those of BinarySearchTree.
+ */
+class RecursiveTree
+{
+ public:
+  explicit RecursiveTree( int notFound ) : root( NULL ), ITEM_NOT_FOUND( notFound ) { }
+  ~RecursiveTree( )
+    { makeEmpty( root ); }
+
+  int find( int x ) const
+    { Node *t = find( x, root ); return t == NULL ? ITEM_NOT_FOUND : t->element; }
+  void insert( int x )
+    { insert( x, root ); }
+
+ private:
+  struct Node
+  {
+    int element;
+    Node *left;
+    Node *right;
+  };
+
+  Node *root;
+  const int ITEM_NOT_FOUND;
+
+  static Node * find( int x, Node *t );
+  static void insert( int x, Node * & t );
+  static void makeEmpty( Node * & t );
+
+  RecursiveTree( const RecursiveTree & rhs );                // Disabled
+  RecursiveTree & operator=( const RecursiveTree & rhs );    // Disabled
+};
+
+RecursiveTree::Node * RecursiveTree::find( int x, Node *t )
+{
+  if( t == NULL )
+    return NULL;
+  else if( x < t->element )
+    return find( x, t->left );
+  else if( t->element < x )
+    return find( x, t->right );
+  else
+    return t;    // Match
+}
+
+void RecursiveTree::insert( int x, Node * & t )
+{
+  if( t == NULL )
+    {
+      t = new Node;
+      t->element = x;
+      t->left = t->right = NULL;
+    }
+  else if( x < t->element )
+    insert( x, t->left );
+  else if( t->element < x )
+    insert( x, t->right );
+}
+
+void RecursiveTree::makeEmpty( Node * & t )
+{
+  if( t != NULL )
+    {
+      makeEmpty( t->left );
+      makeEmpty( t->right );
+      delete t;
+    }
+  t = NULL;
+}
+
+/**
+ * Return the height of tree, or -1 for trees that do not report it.
+ * Without BINARY_SEARCH_TREE_SHAPE this walks the tree.
+ */
+template <class Tree>
+static int treeHeight( const Tree & tree )
+{
+  return tree.shapeMetrics( ).height;
+}
+
+static int treeHeight( const BSTree & tree )
+{
+  if( tree.GetEngine( ) != BSTree::BINARY_TREE )
+    return -1;
+  return tree.GetTree( ).shapeMetrics( ).height;
+}
+
+/**
+ * Run the core operations on one kind of tree. make( ) returns an
+ * empty tree; shapes says whether the tree answers the shape queries.
+ */
+template <class Tree, class Make>
+static void coreSuite( const string & name, Make make, bool shapes,
+                       const Workload & w )
+{
+  long long n = w.keys.size( );
+  long long found = 0;
+  Tree tree = make( );
+  Tree other = make( );
+
+  {
+    double seconds = timeIt( [&]( )
+      {
+        for( long long i = 0; i < n; i++ )
+          tree.insert( w.keys[ i ] );
+      } );
+    record( "core", "insert", name, w.dist, n, 1, 0, n, seconds, 0, treeHeight( tree ) );
+  }
+
+  record( "core", "find", name, w.dist, n, 1, 0, n, timeIt( [&]( )
+    {
+      for( long long i = 0; i < n; i++ )
+        found += tree.find( w.probes[ i ] );
+    } ) );
+
+  {
+    double seconds = timeIt( [&]( ) { Tree copy( tree ); found += copy.size( ); } );
+    record( "core", "copy", name, w.dist, n, 1, 0, n, seconds );
+  }
+
+  for( long long i = 0; i < n; i++ )
+    other.insert( w.others[ i ] );
+  {
+    Tree target( tree );
+    record( "core", "Union", name, w.dist, n, 1, 0, 2 * n, timeIt( [&]( )
+      {
+        target.Union( other );
+      } ) );
+  }
+  {
+    Tree target = make( );
+    record( "core", "Intersection", name, w.dist, n, 1, 0, 2 * n, timeIt( [&]( )
+      {
+        target.Intersection( tree, other );
+      } ) );
+  }
+
+  if( shapes )
+    {
+      record( "core", "IsComplete", name, w.dist, n, 1, 0, n, timeIt( [&]( )
+        {
+          found += tree.IsComplete( );
+        } ) );
+      record( "core", "IPL", name, w.dist, n, 1, 0, n, timeIt( [&]( )
+        {
+          found += tree.IPL( );
+        } ) );
+      record( "core", "EPL", name, w.dist, n, 1, 0, n, timeIt( [&]( )
+        {
+          found += tree.EPL( );
+        } ) );
+    }
+
+  record( "core", "remove", name, w.dist, n, 1, 0, n, timeIt( [&]( )
+    {
+      for( long long i = 0; i < n; i++ )
+        tree.remove( w.probes[ i ] );
+    } ) );
+  sink = found;
+}
+
+static void runCore( const Options & options )
+{
+  for( size_t s = 0; s < options.sizes.size( ); s++ )
+    for( size_t d = 0; d < options.dists.size( ); d++ )
+      {
+        Workload w = makeWorkload( options.dists[ d ], options.sizes[ s ], options.seed );
+
+        coreSuite<BSTree>( "bst", [ ]( ) { return BSTree( -1, "bench" ); }, true, w );
+
+        coreSuite<BinarySearchTree<int, AvlPolicy> >( "avl",
+          [ ]( ) { return BinarySearchTree<int, AvlPolicy>( -1 ); }, true, w );
+        coreSuite<BinarySearchTree<int, RedBlackPolicy> >( "redblack",
+          [ ]( ) { return BinarySearchTree<int, RedBlackPolicy>( -1 ); }, true, w );
+        coreSuite<BinarySearchTree<int, AvlPolicy, NewDeleteAllocator> >( "avl_newdelete",
+          [ ]( ) { return BinarySearchTree<int, AvlPolicy, NewDeleteAllocator>( -1 ); },
+          true, w );
+        coreSuite<BinarySearchTree<int, RedBlackPolicy, NewDeleteAllocator> >( "redblack_newdelete",
+          [ ]( ) { return BinarySearchTree<int, RedBlackPolicy, NewDeleteAllocator>( -1 ); },
+          true, w );
+        coreSuite<BSTree>( "btree",
+          [ ]( ) { return BSTree( -1, "bench", BSTree::B_TREE ); }, false, w );
+        coreSuite<BSTree>( "persistent",
+          [ ]( ) { return BSTree( -1, "bench", BSTree::PERSISTENT ); }, false, w );
+      }
+}
+
+/**
+ * Lookups before and after the internals of BinarySearchTree became
+ * iterative: the original recursive tree against BinarySearchTree<int>
+ * with its default pool and with operator new per node, all grown by
+ * the same inserts. Sorted keys are only run up to
+ * SORTED_UNBALANCED_LIMIT.
+ */
+static void runLookup( const Options & options )
+{
+  typedef BinarySearchTree<int, UnbalancedPolicy, NewDeleteAllocator> NewDeleteTree;
+
+  for( size_t s = 0; s < options.sizes.size( ); s++ )
+    for( size_t d = 0; d < options.dists.size( ); d++ )
+      {
+        Workload w = makeWorkload( options.dists[ d ], options.sizes[ s ], options.seed );
+        long long n = options.sizes[ s ];
+        long long found = 0;
+
+        if( w.dist == "sorted" && n > SORTED_UNBALANCED_LIMIT )
+          {
+            cerr << "lookup sorted n=" << n << ": skipped (quadratic)" << endl;
+            continue;
+          }
+
+        RecursiveTree before( -1 );
+        BinarySearchTree<int> after( -1 );
+        NewDeleteTree afterNewDelete( -1 );
+        for( long long i = 0; i < n; i++ )
+          {
+            before.insert( w.keys[ i ] );
+            after.insert( w.keys[ i ] );
+            afterNewDelete.insert( w.keys[ i ] );
+          }
+
+        record( "lookup", "find", "recursive", w.dist, n, 1, 0, n, timeIt( [&]( )
+          {
+            for( long long i = 0; i < n; i++ )
+              found += before.find( w.probes[ i ] );
+          } ) );
+        record( "lookup", "find", "bst", w.dist, n, 1, 0, n, timeIt( [&]( )
+          {
+            for( long long i = 0; i < n; i++ )
+              found += after.find( w.probes[ i ] );
+          } ) );
+        record( "lookup", "find", "bst_newdelete", w.dist, n, 1, 0, n, timeIt( [&]( )
+          {
+            for( long long i = 0; i < n; i++ )
+              found += afterNewDelete.find( w.probes[ i ] );
+          } ) );
+        sink = found;
+      }
+}
+
+/**
+ * Set operations and bulk building as their thread count grows,
+ * on random keys of the largest size.
+ */
+static void runSetOps( const Options & options )
+{
+  long long n = options.sizes.back( );
+  Workload w = makeWorkload( "random", n, options.seed );
+  BinarySearchTree<int, AvlPolicy> a( -1 );
+  BinarySearchTree<int, AvlPolicy> b( -1 );
+
+  a.assign( w.keys.begin( ), w.keys.end( ) );
+  b.assign( w.others.begin( ), w.others.end( ) );
+  for( size_t t = 0; t < options.threads.size( ); t++ )
+    {
+      long long threads = options.threads[ t ];
+      {
+        BinarySearchTree<int, AvlPolicy> target( a );
+        target.setThreads( threads );
+        record( "setops", "Union", "avl", "random", n, threads, 0, 2 * n,
+                timeIt( [&]( ) { target.Union( b ); } ) );
+      }
+      {
+        BinarySearchTree<int, AvlPolicy> target( -1 );
+        target.setThreads( threads );
+        record( "setops", "Intersection", "avl", "random", n, threads, 0, 2 * n,
+                timeIt( [&]( ) { target.Intersection( a, b ); } ) );
+      }
+      {
+        BinarySearchTree<int, AvlPolicy> target( -1 );
+        target.setThreads( threads );
+        record( "setops", "assign", "avl", "random", n, threads, 0, n,
+                timeIt( [&]( ) { target.assign( w.keys.begin( ), w.keys.end( ) ); } ) );
+      }
+    }
+}
+
+/**
+ * Lookups in a FrozenTree against the AVL tree it was frozen from,
+ * and the cost of saving and loading its file.
+ */
+static void runFrozen( const Options & options )
+{
+  string path = "bst_bench.frozen";
+
+  for( size_t s = 0; s < options.sizes.size( ); s++ )
+    for( size_t d = 0; d < options.dists.size( ); d++ )
+      {
+        Workload w = makeWorkload( options.dists[ d ], options.sizes[ s ], options.seed );
+        long long n = options.sizes[ s ];
+        long long found = 0;
+        BinarySearchTree<int, AvlPolicy> tree( -1, w.keys.begin( ), w.keys.end( ) );
+        FrozenTree<int> frozen = tree.freeze( );
+
+        record( "frozen", "find", "avl", w.dist, n, 1, 0, n, timeIt( [&]( )
+          {
+            for( long long i = 0; i < n; i++ )
+              found += tree.find( w.probes[ i ] );
+          } ) );
+        record( "frozen", "find", "frozen", w.dist, n, 1, 0, n, timeIt( [&]( )
+          {
+            for( long long i = 0; i < n; i++ )
+              found += frozen.find( w.probes[ i ] );
+          } ) );
+        record( "frozen", "freeze", "frozen", w.dist, n, 1, 0, n, timeIt( [&]( )
+          {
+            found += tree.freeze( ).size( );
+          } ) );
+        record( "frozen", "save", "frozen", w.dist, n, 1, 0, n, timeIt( [&]( )
+          {
+            found += frozen.save( path );
+          } ) );
+        {
+          FrozenTree<int> loaded( -1 );
+          record( "frozen", "load", "frozen", w.dist, n, 1, 0, 1, timeIt( [&]( )
+            {
+              found += loaded.load( path );
+            } ) );
+          record( "frozen", "find_mapped", "frozen", w.dist, n, 1, 0, n, timeIt( [&]( )
+            {
+              for( long long i = 0; i < n; i++ )
+                found += loaded.find( w.probes[ i ] );
+            } ) );
+        }
+        sink = found;
+      }
+  remove( path.c_str( ) );
+}
+
+/**
+ * Run threads threads that each make CONCURRENT_OPS calls: a find
+ * of a random key, or with probability writePercent / 100 an insert
+ * or remove of one. Return the seconds taken.
+ */
+template <class Find, class Update>
+static double mixedLoad( long long threads, int writePercent, long long keyRange,
+                         unsigned seed, Find find, Update update )
+{
+  vector<thread> workers;
+  atomic<long long> found( 0 );
+  atomic<int> ready( 0 );
+  atomic<bool> go( false );
+  chrono::steady_clock::time_point start;
+
+  for( long long t = 0; t < threads; t++ )
+    workers.push_back( thread( [&, t]( )
+      {
+        mt19937 rng( seed + (unsigned) t );
+        uniform_int_distribution<long long> key( 0, keyRange - 1 );
+        uniform_int_distribution<int> percent( 0, 99 );
+        long long mine = 0;
+
+        ready++;
+        while( !go.load( ) )
+          this_thread::yield( );
+        for( long long i = 0; i < CONCURRENT_OPS; i++ )
+          {
+            int x = scramble( (uint32_t) key( rng ) );
+            if( percent( rng ) < writePercent )
+              update( x, ( i & 1 ) == 0 );
+            else
+              mine += find( x );
+          }
+        found += mine;
+      } ) );
+
+  while( ready.load( ) < threads )
+    this_thread::yield( );
+  start = chrono::steady_clock::now( );
+  go = true;
+  for( size_t t = 0; t < workers.size( ); t++ )
+    workers[ t ].join( );
+  sink = found.load( );
+  return chrono::duration<double>( chrono::steady_clock::now( ) - start ).count( );
+}
+
+/**
+ * ConcurrentTree against an AVL tree behind a reader-writer lock,
+ * under 95/5 and 50/50 read/write mixes. Writes insert or remove
+ * keys from twice the preloaded range, so the size holds steady.
+ */
+static void runConcurrent( const Options & options )
+{
+  const int writes[ ] = { 5, 50 };
+
+  for( size_t s = 0; s < options.sizes.size( ); s++ )
+    for( int m = 0; m < 2; m++ )
+      {
+        long long n = options.sizes[ s ];
+        string op = writes[ m ] == 5 ? "mix95_5" : "mix50_50";
+
+        for( size_t t = 0; t < options.threads.size( ); t++ )
+          {
+            long long threads = options.threads[ t ];
+            long long ops = threads * CONCURRENT_OPS;
+
+            {
+              ConcurrentTree<int> tree( -1 );
+              for( long long i = 0; i < n; i++ )
+                tree.insert( scramble( (uint32_t) ( 2 * i ) ) );
+              record( "concurrent", op, "concurrent", "random", n, threads, 0, ops,
+                      mixedLoad( threads, writes[ m ], 2 * n, options.seed,
+                                 [&]( int x ) { return tree.find( x ); },
+                                 [&]( int x, bool add )
+                                 {
+                                   if( add )
+                                     tree.insert( x );
+                                   else
+                                     tree.remove( x );
+                                 } ) );
+            }
+            {
+              BinarySearchTree<int, AvlPolicy> tree( -1 );
+              shared_mutex lock;
+              for( long long i = 0; i < n; i++ )
+                tree.insert( scramble( (uint32_t) ( 2 * i ) ) );
+              record( "concurrent", op, "avl_locked", "random", n, threads, 0, ops,
+                      mixedLoad( threads, writes[ m ], 2 * n, options.seed,
+                                 [&]( int x )
+                                 {
+                                   shared_lock<shared_mutex> reading( lock );
+                                   return tree.find( x );
+                                 },
+                                 [&]( int x, bool add )
+                                 {
+                                   unique_lock<shared_mutex> writing( lock );
+                                   if( add )
+                                     tree.insert( x );
+                                   else
+                                     tree.remove( x );
+                                 } ) );
+            }
+          }
+      }
+}
+
+/**
+ * Copies on the PERSISTENT engine against the others, and the cost
+ * of updates while an old version is kept alive.
+ */
+static void runPersistent( const Options & options )
+{
+  const BSTree::Engine engines[ ] = { BSTree::BINARY_TREE, BSTree::B_TREE,
+                                      BSTree::PERSISTENT };
+  const char * const names[ ] = { "bst", "btree", "persistent" };
+
+  for( size_t s = 0; s < options.sizes.size( ); s++ )
+    {
+      long long n = options.sizes[ s ];
+      Workload w = makeWorkload( "random", n, options.seed );
+      long long updates = min( n, (long long) UPDATE_OPS );
+      long long found = 0;
+
+      for( int e = 0; e < 3; e++ )
+        {
+          BSTree tree( -1, "bench", engines[ e ] );
+          tree.assign( w.keys );
+          record( "persistent", "copy", names[ e ], "random", n, 1, 0, 1, timeIt( [&]( )
+            {
+              BSTree copy( tree );
+              found += copy.size( );
+            } ) );
+        }
+
+      BSTree live( -1, "bench", BSTree::PERSISTENT );
+      live.assign( w.keys );
+      record( "persistent", "insert", "persistent", "random", n, 1, 0, updates, timeIt( [&]( )
+        {
+          for( long long i = 0; i < updates; i++ )
+            live.insert( w.others[ i ] ^ 1 );
+        } ) );
+
+      BSTree versioned( -1, "bench", BSTree::PERSISTENT );
+      versioned.assign( w.keys );
+      PersistentTree<int> snapshot = versioned.GetVersion( );
+      record( "persistent", "insert_with_snapshot", "persistent", "random", n, 1, 0,
+              updates, timeIt( [&]( )
+        {
+          for( long long i = 0; i < updates; i++ )
+            versioned.insert( w.others[ i ] ^ 1 );
+        } ) );
+      found += snapshot.size( );
+      sink = found;
+    }
+}
+
+/**
+ * Batched lookups and inserts against one call per key, on each
+ * BSTree engine. Inserts add keys not yet in the tree.
+ */
+static void runBatch( const Options & options )
+{
+  const BSTree::Engine engines[ ] = { BSTree::BINARY_TREE, BSTree::B_TREE,
+                                      BSTree::PERSISTENT };
+  const char * const names[ ] = { "bst", "btree", "persistent" };
+
+  for( size_t s = 0; s < options.sizes.size( ); s++ )
+    {
+      long long n = options.sizes[ s ];
+      Workload w = makeWorkload( "random", n, options.seed );
+      vector<int> fresh( min( n, (long long) UPDATE_OPS ) );
+      vector<int> answers( n );
+      long long found = 0;
+
+      for( size_t i = 0; i < fresh.size( ); i++ )
+        fresh[ i ] = scramble( (uint32_t) ( n + i ) );
+
+      for( int e = 0; e < 3; e++ )
+        {
+          BSTree tree( -1, "bench", engines[ e ] );
+          tree.assign( w.keys );
+
+          record( "batch", "find", names[ e ], "random", n, 1, 1, n, timeIt( [&]( )
+            {
+              for( long long i = 0; i < n; i++ )
+                found += tree.find( w.probes[ i ] );
+            } ) );
+          {
+            BSTree target( tree );
+            record( "batch", "insert", names[ e ], "random", n, 1, 1, fresh.size( ),
+                    timeIt( [&]( )
+              {
+                for( size_t i = 0; i < fresh.size( ); i++ )
+                  target.insert( fresh[ i ] );
+              } ) );
+          }
+
+          for( size_t b = 0; b < options.batches.size( ); b++ )
+            {
+              size_t batch = options.batches[ b ];
+
+              record( "batch", "findBatch", names[ e ], "random", n, 1, batch, n,
+                      timeIt( [&]( )
+                {
+                  for( size_t i = 0; i < (size_t) n; i += batch )
+                    tree.findBatch( &w.probes[ i ], min( batch, (size_t) n - i ), &answers[ i ] );
+                } ) );
+              found += answers[ n - 1 ];
+
+              BSTree target( tree );
+              record( "batch", "insertBatch", names[ e ], "random", n, 1, batch,
+                      fresh.size( ), timeIt( [&]( )
+                {
+                  for( size_t i = 0; i < fresh.size( ); i += batch )
+                    target.insertBatch( &fresh[ i ], min( batch, fresh.size( ) - i ) );
+                } ) );
+            }
+        }
+      sink = found;
+    }
+}
+
+/**
+ * Random lookups on a red-black tree grown by random inserts, one
+ * find at a time and through findMany at each interleave width.
+ * The widths pay off once the tree is larger than the last level
+ * of cache, which takes --sizes of several million keys.
+ */
+static void runInterleave( const Options & options )
+{
+  for( size_t s = 0; s < options.sizes.size( ); s++ )
+    {
+      long long n = options.sizes[ s ];
+      Workload w = makeWorkload( "random", n, options.seed );
+      BinarySearchTree<int, RedBlackPolicy> tree( -1 );
+      vector<int> answers( n );
+      long long found = 0;
+
+      for( long long i = 0; i < n; i++ )
+        tree.insert( w.keys[ i ] );
+
+      record( "interleave", "find", "redblack", "random", n, 1, 1, n, timeIt( [&]( )
+        {
+          for( long long i = 0; i < n; i++ )
+            found += tree.find( w.probes[ i ] );
+        } ) );
+      for( size_t k = 0; k < options.widths.size( ); k++ )
+        {
+          int width = (int) options.widths[ k ];
+
+          record( "interleave", "findMany", "redblack", "random", n, 1, width, n,
+                  timeIt( [&]( )
+            {
+              tree.findMany( &w.probes[ 0 ], n, &answers[ 0 ], width );
+            } ) );
+          found += answers[ n - 1 ];
+        }
+      sink = found;
+    }
+}
+
+/**
+ * Time ZIPF_PASSES replays of the Zipfian finds of w on a tree grown
+ * by inserting order. The finds are made with access, which splays a
+ * splay tree. setup( tree ) configures the empty tree and pass( tree )
+ * runs after each replay.
+ */
+template <class Tree, class Setup, class Pass>
+static void zipfTrace( const string & name, Setup setup, Pass pass,
+                       const Workload & w, const vector<int> & order )
+{
+  long long n = w.keys.size( );
+  long long found = 0;
+  Tree tree( -1 );
+
+  setup( tree );
+  for( long long i = 0; i < n; i++ )
+    tree.insert( order[ i ] );
+  record( "splay", "find", name, w.dist, n, 1, 0, ZIPF_PASSES * n, timeIt( [&]( )
+    {
+      for( int p = 0; p < ZIPF_PASSES; p++ )
+        {
+          for( long long i = 0; i < n; i++ )
+            found += tree.access( w.probes[ i ] );
+          pass( tree );
+        }
+    } ) );
+  sink = found;
+}
+
+/**
+ * Self-adjusting trees on a skewed trace: splaying on every find,
+ * semi-splaying down to SPLAY_DEPTH, and counting hits with an
+ * adapt( ) after each replay, which is timed with the finds. The
+ * hot keys of a zipf workload come first in its insertion order, and
+ * so sit near the root of any tree grown by inserts; here the keys
+ * are inserted in a shuffled order instead.
+ */
+static void runSplay( const Options & options )
+{
+  typedef BinarySearchTree<int> PlainTree;
+  typedef BinarySearchTree<int, RedBlackPolicy> RedBlackTree;
+  typedef BinarySearchTree<int, SplayPolicy> SplayTree;
+
+  for( size_t s = 0; s < options.sizes.size( ); s++ )
+    {
+      long long n = options.sizes[ s ];
+      Workload w = makeWorkload( "zipf", n, options.seed );
+      vector<int> order( w.keys );
+
+      shuffle( order.begin( ), order.end( ), mt19937( options.seed + 1 ) );
+      zipfTrace<PlainTree>( "bst", [ ]( PlainTree & ) { }, [ ]( PlainTree & ) { },
+                            w, order );
+      zipfTrace<RedBlackTree>( "redblack", [ ]( RedBlackTree & ) { },
+                               [ ]( RedBlackTree & ) { }, w, order );
+      zipfTrace<SplayTree>( "splay", [ ]( SplayTree & ) { }, [ ]( SplayTree & ) { },
+                            w, order );
+      zipfTrace<SplayTree>( "semisplay",
+                            [ ]( SplayTree & tree ) { tree.setSplayDepth( SPLAY_DEPTH ); },
+                            [ ]( SplayTree & ) { }, w, order );
+      zipfTrace<SplayTree>( "splay_hits",
+                            [ ]( SplayTree & tree ) { tree.setSplayHits( SPLAY_HITS ); },
+                            [ ]( SplayTree & tree ) { tree.adapt( ); }, w, order );
+    }
+}
+
+/**
+ * Return the bytes of heap in use, or -1 if that cannot be read.
+ */
+static long long heapInUse( )
+{
+#ifdef BENCH_HEAP_STATS
+  struct mallinfo2 info = mallinfo2( );
+  return (long long) ( info.uordblks + info.hblkhd );
+#else
+  return -1;
+#endif
+}
+
+/**
+ * Heap taken by each kind of tree when built from the same keys.
+ * Each is measured alone, as the growth of the heap while it was
+ * built; the frozen snapshot is measured apart from its source.
+ */
+static void runMemory( const Options & options )
+{
+  if( heapInUse( ) < 0 )
+    {
+      cerr << "memory: skipped (heap statistics unavailable)" << endl;
+      return;
+    }
+
+  for( size_t s = 0; s < options.sizes.size( ); s++ )
+    for( size_t d = 0; d < options.dists.size( ); d++ )
+      {
+        Workload w = makeWorkload( options.dists[ d ], options.sizes[ s ], options.seed );
+        long long n = options.sizes[ s ];
+        long long found = 0;
+
+        {
+          long long before = heapInUse( );
+          BinarySearchTree<int, RedBlackPolicy> tree( -1 );
+          double seconds = timeIt( [&]( )
+            {
+              for( long long i = 0; i < n; i++ )
+                tree.insert( w.keys[ i ] );
+            } );
+          record( "memory", "insert", "redblack", w.dist, n, 1, 0, n, seconds,
+                  heapInUse( ) - before );
+
+          before = heapInUse( );
+          FrozenTree<int> frozen( -1 );
+          seconds = timeIt( [&]( ) { frozen = tree.freeze( ); } );
+          record( "memory", "freeze", "frozen", w.dist, n, 1, 0, n, seconds,
+                  heapInUse( ) - before );
+          found += frozen.size( );
+        }
+        {
+          long long before = heapInUse( );
+          IntBTree tree( -1 );
+          double seconds = timeIt( [&]( )
+            {
+              for( long long i = 0; i < n; i++ )
+                tree.insert( w.keys[ i ] );
+            } );
+          record( "memory", "insert", "btree", w.dist, n, 1, 0, n, seconds,
+                  heapInUse( ) - before );
+          found += tree.size( );
+        }
+        {
+          long long before = heapInUse( );
+          CompactTree<int> tree( -1 );
+          double seconds = timeIt( [&]( )
+            {
+              for( long long i = 0; i < n; i++ )
+                tree.insert( w.keys[ i ] );
+            } );
+          record( "memory", "insert", "compact", w.dist, n, 1, 0, n, seconds,
+                  heapInUse( ) - before );
+          found += tree.size( );
+        }
+        {
+          long long before = heapInUse( );
+          CompactTree<int> tree( -1 );
+          double seconds = timeIt( [&]( ) { tree.assign( w.keys ); } );
+          record( "memory", "assign", "compact", w.dist, n, 1, 0, n, seconds,
+                  heapInUse( ) - before );
+          found += tree.size( );
+        }
+        sink = found;
+      }
+}
+
+/**
+ * Return the bytes of the resident set, or -1 if that cannot be read.
+ * Free heap is first handed back to the system, so that what an
+ * earlier measurement left behind is not counted.
+ */
+static long long residentBytes( )
+{
+#ifdef BENCH_HEAP_STATS
+  ifstream statm( "/proc/self/statm" );
+  long long pages;
+  long long resident;
+
+  malloc_trim( 0 );
+  if( statm >> pages >> resident )
+    return resident * sysconf( _SC_PAGESIZE );
+#endif
+  return -1;
+}
+
+/**
+ * Keep a tree of w's keys at a steady size: each step removes the
+ * next key, in insertion order, and puts back the one removed
+ * n / CHURN_OUT steps before, CHURN_PASSES times over the keys. The
+ * heap and resident set are recorded after the build, and again
+ * after the churn, as growth since before the build.
+ */
+template <class Tree>
+static void churnSuite( const string & name, const Workload & w )
+{
+  long long n = w.keys.size( );
+  long long out = max( 1LL, n / CHURN_OUT );
+  long long steps = CHURN_PASSES * n;
+  long long heapBefore = heapInUse( );
+  long long rssBefore = residentBytes( );
+  Tree tree( -1 );
+
+  double seconds = timeIt( [&]( )
+    {
+      for( long long i = 0; i < n; i++ )
+        tree.insert( w.keys[ i ] );
+    } );
+  record( "churn", "build", name, w.dist, n, 1, 0, n, seconds,
+          heapInUse( ) - heapBefore, -1, residentBytes( ) - rssBefore );
+
+  for( long long i = 0; i < out; i++ )
+    tree.remove( w.keys[ i ] );
+  seconds = timeIt( [&]( )
+    {
+      for( long long i = out; i < steps; i++ )
+        {
+          tree.remove( w.keys[ i % n ] );
+          tree.insert( w.keys[ ( i - out ) % n ] );
+        }
+    } );
+  record( "churn", "churn", name, w.dist, n, 1, 0, 2 * ( steps - out ), seconds,
+          heapInUse( ) - heapBefore, -1, residentBytes( ) - rssBefore );
+  sink = tree.size( );
+}
+
+/**
+ * Steady insert and remove traffic on the slab pool against one heap
+ * block per node: throughput, and how far each lets the heap and the
+ * resident set grow.
+ */
+static void runChurn( const Options & options )
+{
+  if( heapInUse( ) < 0 )
+    {
+      cerr << "churn: skipped (heap statistics unavailable)" << endl;
+      return;
+    }
+
+  for( size_t s = 0; s < options.sizes.size( ); s++ )
+    for( size_t d = 0; d < options.dists.size( ); d++ )
+      {
+        Workload w = makeWorkload( options.dists[ d ], options.sizes[ s ], options.seed );
+
+        churnSuite<BinarySearchTree<int, RedBlackPolicy> >( "redblack", w );
+        churnSuite<BinarySearchTree<int, RedBlackPolicy, NewDeleteAllocator> >(
+          "redblack_newdelete", w );
+      }
+}
+
+/**
+ * Write s as a JSON string.
+ */
+static void writeString( ostream & out, const string & s )
+{
+  out << '"';
+  for( size_t i = 0; i < s.size( ); i++ )
+    {
+      if( s[ i ] == '"' || s[ i ] == '\\' )
+        out << '\\';
+      out << s[ i ];
+    }
+  out << '"';
+}
+
+template <class T>
+static void writeList( ostream & out, const vector<T> & items )
+{
+  out << "[";
+  for( size_t i = 0; i < items.size( ); i++ )
+    out << ( i > 0 ? ", " : "" ) << items[ i ];
+  out << "]";
+}
+
+static void writeStrings( ostream & out, const vector<string> & items )
+{
+  out << "[";
+  for( size_t i = 0; i < items.size( ); i++ )
+    {
+      out << ( i > 0 ? ", " : "" );
+      writeString( out, items[ i ] );
+    }
+  out << "]";
+}
+
+/**
+ * Write the configuration and every result as one JSON document.
+ */
+static void writeJson( ostream & out, const Options & options )
+{
+  out.precision( 9 );
+  out << "{\n  \"benchmark\": \"bst_bench\",\n  \"format\": 1,\n";
+  out << "  \"config\": {\n    \"suites\": ";
+  writeStrings( out, options.suites );
+  out << ",\n    \"sizes\": ";
+  writeList( out, options.sizes );
+  out << ",\n    \"dists\": ";
+  writeStrings( out, options.dists );
+  out << ",\n    \"threads\": ";
+  writeList( out, options.threads );
+  out << ",\n    \"batches\": ";
+  writeList( out, options.batches );
+  out << ",\n    \"widths\": ";
+  writeList( out, options.widths );
+  out << ",\n    \"seed\": " << options.seed
+      << ",\n    \"hardware_threads\": " << thread::hardware_concurrency( )
+      << ",\n    \"compiler\": ";
+#if defined( __VERSION__ )
+  writeString( out, __VERSION__ );
+#else
+  writeString( out, "unknown" );
+#endif
+  out << "\n  },\n  \"results\": [";
+  for( size_t i = 0; i < results.size( ); i++ )
+    {
+      const Result & r = results[ i ];
+      out << ( i > 0 ? "," : "" ) << "\n    { \"suite\": ";
+      writeString( out, r.suite );
+      out << ", \"op\": ";
+      writeString( out, r.op );
+      out << ", \"tree\": ";
+      writeString( out, r.tree );
+      out << ", \"dist\": ";
+      writeString( out, r.dist );
+      out << ", \"size\": " << r.size << ", \"threads\": " << r.threads
+          << ", \"batch\": " << r.batch << ", \"ops\": " << r.ops
+          << ", \"seconds\": " << r.seconds
+          << ", \"ns_per_op\": " << r.seconds * 1e9 / max( 1LL, r.ops );
+      if( r.bytes > 0 )
+        out << ", \"bytes\": " << r.bytes
+            << ", \"bytes_per_key\": " << (double) r.bytes / max( 1LL, r.size );
+      if( r.height >= 0 )
+        out << ", \"height\": " << r.height;
+      if( r.rss > 0 )
+        out << ", \"rss\": " << r.rss;
+      out << " }";
+    }
+  out << "\n  ]\n}\n";
+}
+
+/**
+ * Parse a count such as 100, 64K or 1M.
+ */
+static long long parseCount( const string & text )
+{
+  char *end;
+  long long value = strtoll( text.c_str( ), &end, 10 );
+
+  switch( *end )
+    {
+    case 'k': case 'K': value *= 1000LL; end++; break;
+    case 'm': case 'M': value *= 1000000LL; end++; break;
+    case 'g': case 'G': value *= 1000000000LL; end++; break;
+    }
+  if( end == text.c_str( ) || *end != '\0' || value <= 0 )
+    {
+      cerr << "bst_bench: bad count " << text << endl;
+      exit( 2 );
+    }
+  return value;
+}
+
+static vector<string> split( const string & text )
+{
+  vector<string> items;
+  stringstream in( text );
+  string item;
+
+  while( getline( in, item, ',' ) )
+    if( !item.empty( ) )
+      items.push_back( item );
+  return items;
+}
+
+static vector<long long> splitCounts( const string & text )
+{
+  vector<string> items = split( text );
+  vector<long long> counts;
+
+  for( size_t i = 0; i < items.size( ); i++ )
+    counts.push_back( parseCount( items[ i ] ) );
+  return counts;
+}
+
+static bool wants( const Options & options, const string & suite )
+{
+  return find( options.suites.begin( ), options.suites.end( ), suite ) !=
+         options.suites.end( );
+}
+
+int main( int argc, char *argv[ ] )
+{
+  Options options;
+
+  options.suites = split( "core,lookup,setops,frozen,concurrent,persistent,batch,interleave,splay,memory,churn" );
+  options.sizes = splitCounts( "1K,64K,1M" );
+  options.dists = split( "random,sorted,zipf" );
+  options.threads = splitCounts( "1,2,4,8,16,32,64" );
+  options.batches = splitCounts( "16,64,256,1024,4096,16384,65536" );
+  options.widths = splitCounts( "1,2,4,8,16,32,64" );
+  options.seed = 12345;
+
+  for( int i = 1; i < argc; i++ )
+    {
+      string flag = argv[ i ];
+      if( i + 1 >= argc )
+        {
+          cerr << "usage: bst_bench [--suites LIST] [--sizes LIST] [--dists LIST]\n"
+                  "                 [--threads LIST] [--batches LIST] [--widths LIST]\n"
+                  "                 [--seed N] [--out FILE]" << endl;
+          return 2;
+        }
+      string value = argv[ ++i ];
+      if( flag == "--suites" )
+        options.suites = split( value );
+      else if( flag == "--sizes" )
+        options.sizes = splitCounts( value );
+      else if( flag == "--dists" )
+        options.dists = split( value );
+      else if( flag == "--threads" )
+        options.threads = splitCounts( value );
+      else if( flag == "--batches" )
+        options.batches = splitCounts( value );
+      else if( flag == "--widths" )
+        options.widths = splitCounts( value );
+      else if( flag == "--seed" )
+        options.seed = (unsigned) parseCount( value );
+      else if( flag == "--out" )
+        options.out = value;
+      else
+        {
+          cerr << "bst_bench: unknown option " << flag << endl;
+          return 2;
+        }
+    }
+  if( options.sizes.empty( ) || options.threads.empty( ) || options.batches.empty( ) ||
+      options.widths.empty( ) )
+    {
+      cerr << "bst_bench: empty list" << endl;
+      return 2;
+    }
+  sort( options.sizes.begin( ), options.sizes.end( ) );
+
+  if( wants( options, "core" ) )
+    runCore( options );
+  if( wants( options, "lookup" ) )
+    runLookup( options );
+  if( wants( options, "setops" ) )
+    runSetOps( options );
+  if( wants( options, "frozen" ) )
+    runFrozen( options );
+  if( wants( options, "concurrent" ) )
+    runConcurrent( options );
+  if( wants( options, "persistent" ) )
+    runPersistent( options );
+  if( wants( options, "batch" ) )
+    runBatch( options );
+  if( wants( options, "interleave" ) )
+    runInterleave( options );
+  if( wants( options, "splay" ) )
+    runSplay( options );
+  if( wants( options, "memory" ) )
+    runMemory( options );
+  if( wants( options, "churn" ) )
+    runChurn( options );
+
+  if( options.out.empty( ) )
+    writeJson( cout, options );
+  else
+    {
+      ofstream out( options.out.c_str( ) );
+      writeJson( out, options );
+      if( !out )
+        {
+          cerr << "bst_bench: cannot write " << options.out << endl;
+          return 1;
+        }
+    }
+  return 0;
+}
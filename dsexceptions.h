@@ -0,0 +1,10 @@
+#ifndef DSEXCEPTIONS_H_
+#define DSEXCEPTIONS_H_
+
+class Underflow { };
+class Overflow  { };
+class OutOfMemory { };
+class BadIterator { };
+class WrongEngine { };
+
+#endif
@@ -0,0 +1,150 @@
+// spine_test: regression test for trees of any height
+//
+// Usage: spine_test [N]
+//
+// Builds an unbalanced BinarySearchTree<int> holding 0.. N - 1 as a
+// right spine, the shape that inserting them in ascending order
+// gives, N = SPINE_NODES by default, and runs the operations that
+// used to recurse once per level on it: find, findMin, findMax,
+// insert and remove at the bottom, shapeMetrics, EPL, IsPerfect,
+// IsComplete, the copy constructor, Same_Shape, makeEmpty and the
+// destructor.
+// A recursive walk overflows the native stack long before the
+// bottom of such a tree. Prints each failed check and exits with 1
+// if there was one.
+
+#include "BinarySearchTree.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+using namespace std;
+
+enum { SPINE_NODES = 50000000 };
+
+static int failures = 0;
+
+#define CHECK( condition )                                              \
+  do                                                                    \
+    {                                                                   \
+      if( !( condition ) )                                              \
+        {                                                               \
+          cerr << "spine_test:" << __LINE__ << ": failed: " #condition << endl; \
+          failures++;                                                   \
+        }                                                               \
+    }                                                                   \
+  while( false )
+
+/**
+ * Reaches into the tree to build degenerate shapes quickly.
+ */
+struct BinarySearchTreeTest
+{
+  /**
+   * Replace the contents of tree with 0.. n - 1 laid out as a right
+   * spine, the same nodes n inserts in ascending order would give.
+   * Those inserts would take O(n^2) time, since each one walks down
+   * the whole spine to reach the bottom; here the spine is built from
+   * the bottom up in O(n).
+   */
+  template <class Tree>
+  static void growSpine( Tree & tree, int n )
+  {
+    BinaryNode<int> *below = NULL;
+
+    tree.makeEmpty( );
+    for( int i = n - 1; i >= 0; i-- )
+      {
+        BinaryNode<int> *t = tree.emplaceNode( i );
+        t->right = below;
+        Tree::adopt( t );
+        tree.refresh( t );
+        below = t;
+      }
+    tree.root = below;
+    TREE_STAT( tree.counters.depthSum = (long long) n * ( n - 1 ) / 2; )
+  }
+};
+
+/**
+ * Time f( ) and print how long it took, under label.
+ */
+template <class Function>
+static void step( const char *label, Function f )
+{
+  chrono::steady_clock::time_point start = chrono::steady_clock::now( );
+  f( );
+  chrono::duration<double> seconds = chrono::steady_clock::now( ) - start;
+  cout << label << ": " << seconds.count( ) << " s" << endl;
+}
+
+int main( int argc, char *argv[ ] )
+{
+  int n = argc > 1 ? atoi( argv[ 1 ] ) : (int) SPINE_NODES;
+
+  if( n < 3 )
+    {
+      cerr << "usage: spine_test [N], N at least 3" << endl;
+      return 2;
+    }
+
+  unique_ptr<BinarySearchTree<int> > owner( new BinarySearchTree<int>( -1 ) );
+  BinarySearchTree<int> & tree = *owner;
+  long long last = n - 1;
+
+  step( "build", [&]( ) { BinarySearchTreeTest::growSpine( tree, n ); } );
+  CHECK( tree.size( ) == n );
+
+  step( "find", [&]( )
+    {
+      CHECK( tree.find( n - 1 ) == n - 1 );
+      CHECK( tree.find( n ) == -1 );
+      CHECK( tree.find( n / 2 ) == n / 2 );
+      CHECK( tree.findMin( ) == 0 );
+      CHECK( tree.findMax( ) == n - 1 );
+    } );
+
+  step( "shape", [&]( )
+    {
+      BinarySearchTree<int>::ShapeMetrics m = tree.shapeMetrics( );
+      CHECK( m.height == n - 1 );
+      CHECK( m.ipl == last * ( last - 1 ) / 2 );
+      CHECK( m.epl == last );
+      CHECK( tree.EPL( ) == n - 1 );
+      CHECK( !tree.IsPerfect( ) );
+      CHECK( !tree.IsComplete( ) );
+    } );
+
+  step( "copy", [&]( )
+    {
+      BinarySearchTree<int> copy( tree );
+      CHECK( copy.size( ) == n );
+      CHECK( copy.Same_Shape( tree ) );
+      CHECK( copy == tree );
+      copy.makeEmpty( );
+      CHECK( copy.isEmpty( ) );
+    } );
+
+  step( "insert and remove", [&]( )
+    {
+      tree.insert( n );
+      CHECK( tree.find( n ) == n );
+      CHECK( tree.size( ) == n + 1 );
+      tree.remove( n );
+      tree.remove( 0 );
+      CHECK( tree.find( n ) == -1 );
+      CHECK( tree.findMin( ) == 1 );
+      CHECK( tree.size( ) == n - 1 );
+    } );
+
+  step( "destroy", [&]( ) { owner.reset( ); } );
+
+  if( failures > 0 )
+    {
+      cerr << "spine_test: " << failures << " checks failed" << endl;
+      return 1;
+    }
+  cout << "spine_test: passed" << endl;
+  return 0;
+}
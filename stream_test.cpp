@@ -0,0 +1,119 @@
+// stream_test: regression test for exporting and importing trees
+//
+// Usage: stream_test
+//
+// Writes a BinarySearchTree<int> ordered by a comparator with state,
+// a descending one, with exportText and exportBinary, and reads it
+// back with importText and importBinary. The tree read must keep its
+// own comparator: the stream is checked against it, and the items
+// come back in the same order. An ascending stream must be turned
+// down and leave the tree unchanged. Prints each failed check and
+// exits with 1 if there was one.
+
+#include "BinarySearchTree.h"
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+enum { STREAM_ITEMS = 10000 };
+
+static int failures = 0;
+
+#define CHECK( condition )                                              \
+  do                                                                    \
+    {                                                                   \
+      if( !( condition ) )                                              \
+        {                                                               \
+          cerr << "stream_test:" << __LINE__ << ": failed: " #condition << endl; \
+          failures++;                                                   \
+        }                                                               \
+    }                                                                   \
+  while( false )
+
+/**
+ * Orders ints ascending, or descending if built with true.
+ */
+struct Direction
+{
+  bool descending;
+
+  explicit Direction( bool down = false ) : descending( down ) { }
+  bool operator()( int a, int b ) const
+    { return descending ? b < a : a < b; }
+};
+
+typedef BinarySearchTree<int, RedBlackPolicy, NodePool, Direction> DescendingTree;
+
+/**
+ * Check that tree holds 0.. n - 1 in descending order.
+ */
+static void checkDescending( DescendingTree & tree, int n )
+{
+  vector<int> items( tree.begin( ), tree.end( ) );
+
+  CHECK( tree.size( ) == n );
+  CHECK( tree.findMin( ) == n - 1 );
+  CHECK( tree.findMax( ) == 0 );
+  CHECK( tree.find( n / 2 ) == n / 2 );
+  CHECK( (int) items.size( ) == n && items.front( ) == n - 1 && items.back( ) == 0 );
+}
+
+int main( )
+{
+  int n = STREAM_ITEMS;
+  DescendingTree tree( -1, Direction( true ) );
+
+  for( int i = 0; i < n; i++ )
+    tree.insert( i );
+  checkDescending( tree, n );
+
+  // Text, into a fresh tree and back into the one that wrote it
+  ostringstream text;
+  CHECK( tree.exportText( text ) );
+  {
+    DescendingTree copy( -1, Direction( true ) );
+    istringstream in( text.str( ) );
+    CHECK( copy.importText( in ) );
+    checkDescending( copy, n );
+    copy.insert( n );
+    CHECK( copy.findMin( ) == n );
+  }
+  {
+    istringstream in( text.str( ) );
+    CHECK( tree.importText( in ) );
+    checkDescending( tree, n );
+  }
+
+  // Binary, through a temporary file
+  FILE *file = tmpfile( );
+  CHECK( file != NULL );
+  if( file != NULL )
+    {
+      CHECK( tree.exportBinary( fileno( file ) ) );
+      rewind( file );
+      DescendingTree copy( -1, Direction( true ) );
+      CHECK( copy.importBinary( fileno( file ) ) );
+      checkDescending( copy, n );
+      fclose( file );
+    }
+
+  // An ascending stream is out of order for this tree
+  ostringstream ascending;
+  ascending << 3 << endl << 1 << endl << 2 << endl << 3 << endl;
+  {
+    istringstream in( ascending.str( ) );
+    CHECK( !tree.importText( in ) );
+    checkDescending( tree, n );
+  }
+
+  if( failures > 0 )
+    {
+      cerr << "stream_test: " << failures << " checks failed" << endl;
+      return 1;
+    }
+  cout << "stream_test: passed" << endl;
+  return 0;
+}